@@ -0,0 +1,343 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdarg.h>
+#include <time.h>
+#include "main.h"
+
+/* 没有在main.h中公开 */
+void *parseArrayByIndex( const UBYTE *input, int index, Search *search );
+bool convertNumber( const UBYTE *input, size_t length, double *number );
+bool convertNumberByStrtod( const UBYTE *input, size_t length, double *number );
+
+/* 测试用的文档，key、path为NULL或index小于0时不测对应的接口 */
+typedef struct {
+    const char *name;
+    char       *json;
+    size_t     length;
+    const char *key;
+    const char *path;
+    int        index;
+    bool       numeric;            // 元素都是数字的数组，测试数字的转换
+} BenchDocument;
+
+/* 以0结尾的旧接口只能处理cLEGACY_LENGTH_MAX以内的文档，更大的文档只测WithLength接口 */
+typedef enum {
+    B_KEY,
+    B_PATH,
+    B_INDEX,
+    B_KEY_WITH_LENGTH,
+    B_PATH_WITH_LENGTH,
+    B_VALIDATE,
+    B_CONVERT_NUMBER,
+    B_CONVERT_BY_STRTOD
+} BenchEntry;
+
+const char *cENTRY_NAMES[] = { "macroKeyValueSearch", "marcoPathSearch", "parseArrayByIndex",
+                               "macroKeyValueSearchWithLength", "marcoPathSearchWithLength", "validateJson",
+                               "convertNumber", "convertNumberByStrtod" };
+
+#define cLEGACY_LENGTH_MAX (1024 * 100)
+
+#define cEVICT_SIZE (64u << 20)    // 冷启动前写一遍这么大的内存，把文档挤出cache
+
+/* 可以一直追加内容的字符串 */
+typedef struct {
+    char   *data;
+    size_t length;
+    size_t capacity;
+} Builder;
+
+void append( Builder *builder, const char *format, ... ){
+
+    va_list arguments;
+    for ( ;; ) {
+        size_t rest = builder->capacity - builder->length;
+        va_start( arguments, format );
+        int written = vsnprintf( builder->data + builder->length, rest, format, arguments );
+        va_end( arguments );
+
+        if ( written < 0 ) exit( 1 );
+        if ((size_t) written < rest ) {
+            builder->length += (size_t) written;
+            return;
+        }
+
+        builder->capacity = builder->capacity == 0 ? 4096 : builder->capacity * 2;
+        while ( builder->capacity - builder->length <= (size_t) written ) builder->capacity *= 2;
+        builder->data = realloc( builder->data, builder->capacity );
+        if ( builder->data == NULL) exit( 1 );
+    }
+}
+
+BenchDocument finish( const char *name, Builder *builder, const char *key, const char *path, int index ){
+    BenchDocument document = { name, builder->data, builder->length, key, path, index, false };
+    return document;
+}
+
+/* 典型的API返回，几百个字节 */
+BenchDocument smallResponse(){
+
+    Builder builder = { NULL, 0, 0 };
+    append( &builder, "{\"id\":918273,\"status\":\"ok\",\"user\":{\"name\":\"Tom\",\"age\":32,\"profile\":{\"city\":"
+                      "\"Shanghai\",\"email\":\"tom@example.com\",\"verified\":true}},\"items\":[" );
+    for ( int i = 0; i < 5; i++ ) {
+        append( &builder, "%s{\"sku\":\"A-%04d\",\"price\":%d.%02d,\"qty\":%d}", i == 0 ? "" : ",", i, 10 + i, i * 7,
+                i + 1 );
+    }
+    append( &builder, "],\"next\":null,\"took\":0.0123}" );
+    return finish( "small_response", &builder, "email", ".user.profile.email", -1 );
+}
+
+/* 一个object中有很多key，要找的key在最后 */
+BenchDocument wideObject(){
+
+    Builder builder = { NULL, 0, 0 };
+    append( &builder, "{" );
+    for ( int i = 0; i < 5000; i++ ) append( &builder, "%s\"key%04d\":%d", i == 0 ? "" : ",", i, i );
+    append( &builder, "}" );
+    return finish( "wide_object", &builder, "key4999", ".key4999", -1 );
+}
+
+/* 很深的嵌套 */
+BenchDocument deepNesting(){
+
+    static char path[2048];
+    Builder     builder = { NULL, 0, 0 };
+    size_t      length  = 0;
+    for ( int i = 0; i < 500; i++ ) {
+        append( &builder, "{\"pad\":[1,2,3],\"a\":" );
+        length += (size_t) sprintf( path + length, ".a" );
+    }
+    append( &builder, "{\"leaf\":42}" );
+    for ( int i = 0; i < 500; i++ ) append( &builder, "}" );
+    sprintf( path + length, ".leaf" );
+    return finish( "deep_nesting", &builder, "leaf", path, -1 );
+}
+
+/* 很长的字符串，其中有转义符 */
+BenchDocument longStrings(){
+
+    Builder builder = { NULL, 0, 0 };
+    append( &builder, "[" );
+    for ( int i = 0; i < 64; i++ ) {
+        append( &builder, "%s\"", i == 0 ? "" : "," );
+        for ( int j = 0; j < 1024; j++ ) {
+            append( &builder, "lorem ipsum dolor sit amet, \\\"quoted\\\" \\u00e9\\n ok " );
+        }
+        append( &builder, "\"" );
+    }
+    append( &builder, ",{\"last\":true}]" );
+    return finish( "long_strings", &builder, "last", "[64].last", 64 );
+}
+
+/* 数字很多的数组 */
+BenchDocument numericArray(){
+
+    Builder  builder = { NULL, 0, 0 };
+    unsigned seed    = 42;
+    append( &builder, "[" );
+    for ( int i = 0; i < 8000; i++ ) {
+        seed = seed * 1103515245 + 12345;
+        if ( i % 3 == 0 ) append( &builder, "%s%d", i == 0 ? "" : ",", (int) ( seed >> 8 ) - 8000000 );
+        else if ( i % 3 == 1 ) append( &builder, ",%u.%u", seed >> 20, seed & 0xffff );
+        else append( &builder, ",-%u.%ue-%u", seed >> 28, seed & 0xfff, ( seed >> 16 ) % 300 );
+    }
+    append( &builder, "]" );
+
+    BenchDocument document = finish( "numeric_array", &builder, "missing", "[7999]", 7999 );
+    document.numeric = true;
+    return document;
+}
+
+/* 10MB以上的导出文件 */
+BenchDocument largeExport(){
+
+    Builder builder = { NULL, 0, 0 };
+    append( &builder, "[" );
+    for ( int i = 0; i < 100000; i++ ) {
+        append( &builder, "%s{\"id\":%d,\"name\":\"user %d\",\"email\":\"user%d@example.com\",\"active\":%s,"
+                          "\"tags\":[\"a\",\"b\",\"c\"],\"score\":%d.%d,\"address\":{\"city\":\"City %d\","
+                          "\"zip\":\"%05d\"}}", i == 0 ? "" : ",", i, i, i, i % 2 ? "true" : "false", i % 100,
+                i % 10, i % 500, i );
+    }
+    append( &builder, "]" );
+    return finish( "large_export", &builder, "missing", "[99999].address.zip", 99999 );
+}
+
+/**
+ * 把数组中的每个数字转换成double，两种转换的切分方式相同，只有转换本身不同
+ * @return 所有数字都转换成功时为J_TRUE
+ */
+ValueType convertAll( const BenchDocument *document, bool (*convert)( const UBYTE *, size_t, double * )){
+
+    const UBYTE     *json = (const UBYTE *) document->json;
+    volatile double sum   = 0;
+    bool            ok    = true;
+
+    for ( size_t i = 1; i < document->length; ) {
+        size_t end = i;
+        while ( end < document->length && json[end] != ',' && json[end] != ']' ) end++;
+
+        double number = 0;
+        ok = convert( json + i, end - i, &number ) && ok;
+        sum += number;
+        i = end + 1;
+    }
+    return ok ? J_TRUE : J_FALSE;
+}
+
+uint64_t nowNanoseconds(){
+    struct timespec now;
+    clock_gettime( CLOCK_MONOTONIC, &now );
+    return (uint64_t) now.tv_sec * 1000000000u + (uint64_t) now.tv_nsec;
+}
+
+/* 执行一次查询，返回耗时 */
+uint64_t runOnce( const BenchDocument *document, BenchEntry entry, ValueType *valueType ){
+
+    Search   search = { .valueType = J_NOT_FOUND, .options = S_RECURSIVE };
+    void     *result;
+    uint64_t begin  = nowNanoseconds();
+
+    switch ( entry ) {
+        case B_KEY:
+            search.pattern = (UBYTE *) document->key;
+            result = macroKeyValueSearch((UBYTE *) document->json, &search );
+            break;
+        case B_PATH:
+            search.pattern = (UBYTE *) document->path;
+            search.options = S_NORMAL;
+            result = marcoPathSearch((UBYTE *) document->json, &search );
+            break;
+        case B_INDEX:
+            search.options = S_NORMAL;
+            result = parseArrayByIndex((UBYTE *) document->json, document->index, &search );
+            break;
+        case B_KEY_WITH_LENGTH:
+            search.pattern = (UBYTE *) document->key;
+            result = macroKeyValueSearchWithLength((UBYTE *) document->json, document->length, &search );
+            break;
+        case B_PATH_WITH_LENGTH:
+            search.pattern = (UBYTE *) document->path;
+            search.options = S_NORMAL;
+            result = marcoPathSearchWithLength((UBYTE *) document->json, document->length, &search );
+            break;
+        case B_VALIDATE:
+            // 没有查询结果，value_type输出true或者false
+            result = NULL;
+            search.valueType = validateJson((UBYTE *) document->json, document->length, NULL) ? J_TRUE : J_FALSE;
+            break;
+        case B_CONVERT_NUMBER:
+            result = NULL;
+            search.valueType = convertAll( document, convertNumber );
+            break;
+        default:
+            result = NULL;
+            search.valueType = convertAll( document, convertNumberByStrtod );
+            break;
+    }
+    free( result );
+
+    uint64_t end = nowNanoseconds();
+    *valueType = search.valueType;
+    return end - begin;
+}
+
+int compareTimes( const void *left, const void *right ){
+    uint64_t a = *(const uint64_t *) left, b = *(const uint64_t *) right;
+    return a < b ? -1 : a > b;
+}
+
+void evictCaches( UBYTE *evict ){
+    static UBYTE round = 0;
+    memset( evict, ++round, cEVICT_SIZE );
+}
+
+void runBenchmark( const BenchDocument *document, BenchEntry entry, UBYTE *evict, uint64_t budget, bool csv ){
+
+    ValueType valueType;
+
+    evictCaches( evict );
+    uint64_t cold = runOnce( document, entry, &valueType );
+
+    // 在预算时间内尽量多跑几次，至少5次
+    uint64_t times[10000];
+    size_t   count = 0, spent = 0;
+    while ( count < sizeof( times ) / sizeof( times[0] ) && ( count < 5 || spent < budget )) {
+        times[count] = runOnce( document, entry, &valueType );
+        spent += times[count++];
+    }
+    qsort( times, count, sizeof( uint64_t ), compareTimes );
+
+    uint64_t median    = times[count / 2];
+    double   megabytes = (double) document->length / ( 1024.0 * 1024.0 );
+    double   rate      = median == 0 ? 0 : megabytes / ( (double) median / 1e9 );
+
+    if ( csv ) {
+        printf( "%s,%s,%zu,%d,%zu,%llu,%llu,%llu,%.1f\n", document->name, cENTRY_NAMES[entry], document->length,
+                valueType, count, (unsigned long long) cold, (unsigned long long) times[0],
+                (unsigned long long) median, rate );
+    } else {
+        printf( "{\"document\":\"%s\",\"function\":\"%s\",\"bytes\":%zu,\"value_type\":%d,\"runs\":%zu,"
+                "\"cold_ns\":%llu,\"warm_min_ns\":%llu,\"warm_median_ns\":%llu,\"mb_per_s\":%.1f}\n", document->name,
+                cENTRY_NAMES[entry], document->length, valueType, count, (unsigned long long) cold,
+                (unsigned long long) times[0], (unsigned long long) median, rate );
+    }
+    fflush( stdout );
+}
+
+void usage( const char *program ){
+    fprintf( stderr, "usage: %s [--csv] [--filter name] [--budget-ms n]\n"
+                     "  --csv        输出CSV，默认每行一个JSON\n"
+                     "  --filter     只测试名字中包含name的文档或接口\n"
+                     "  --budget-ms  每个测试的warm时间预算，默认200\n", program );
+}
+
+int main( int argc, char **argv ){
+
+    bool       csv      = false;
+    const char *filter  = NULL;
+    uint64_t   budget   = 200;
+
+    for ( int i = 1; i < argc; i++ ) {
+        if ( strcmp( argv[i], "--csv" ) == 0 ) {
+            csv = true;
+        } else if ( strcmp( argv[i], "--filter" ) == 0 && i + 1 < argc ) {
+            filter = argv[++i];
+        } else if ( strcmp( argv[i], "--budget-ms" ) == 0 && i + 1 < argc ) {
+            budget = strtoull( argv[++i], NULL, 10 );
+        } else {
+            usage( argv[0] );
+            return 1;
+        }
+    }
+
+    BenchDocument documents[] = { smallResponse(), wideObject(), deepNesting(), longStrings(), numericArray(),
+                                  largeExport() };
+    size_t        count       = sizeof( documents ) / sizeof( documents[0] );
+    UBYTE         *evict      = malloc( cEVICT_SIZE );
+    if ( evict == NULL) return 1;
+
+    if ( csv ) printf( "document,function,bytes,value_type,runs,cold_ns,warm_min_ns,warm_median_ns,mb_per_s\n" );
+
+    for ( size_t i = 0; i < count; i++ ) {
+        const BenchDocument *document = &documents[i];
+        for ( BenchEntry entry = B_KEY; entry <= B_CONVERT_BY_STRTOD; entry++ ) {
+            if (( entry == B_KEY || entry == B_KEY_WITH_LENGTH ) && document->key == NULL) continue;
+            if (( entry == B_PATH || entry == B_PATH_WITH_LENGTH ) && document->path == NULL) continue;
+            if ( entry == B_INDEX && document->index < 0 ) continue;
+            if ( entry <= B_INDEX && document->length >= cLEGACY_LENGTH_MAX ) continue;
+            if ( entry >= B_CONVERT_NUMBER && !document->numeric ) continue;
+            if ( filter != NULL && strstr( document->name, filter ) == NULL
+                 && strstr( cENTRY_NAMES[entry], filter ) == NULL) continue;
+
+            runBenchmark( document, entry, evict, budget * 1000000u, csv );
+        }
+    }
+
+    for ( size_t i = 0; i < count; i++ ) free( documents[i].json );
+    free( evict );
+    return 0;
+}
@@ -5,7 +5,20 @@
 #include <stdlib.h>
 #include <string.h>
 #include <math.h>
+#include <limits.h>
+#include <stdint.h>
+#include <float.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include "main.h"
+#include "pow5_table.h"
+
+#if defined( __x86_64__ ) || defined( __i386__ )
+#include <immintrin.h>
+#endif
 
 #define PARSE_ERROR NULL
 #define NOT_FOUND NULL
@@ -14,10 +27,47 @@
 
 #define CHECK_NULL( x ) if((x) == NULL) return PARSE_ERROR;
 
-const int  cSOURCE_LENGTH_MAX = 1024 * 100;      // 100K bytes max length for json string
+/* 内核指针第一次调用时按CPU选择，多个线程可能同时选择且结果相同，relaxed读写即可避免数据竞争 */
+#define LOAD_KERNEL( kernel ) __atomic_load_n( &( kernel ), __ATOMIC_RELAXED )
+#define STORE_KERNEL( kernel, value ) __atomic_store_n( &( kernel ), ( value ), __ATOMIC_RELAXED )
+
+const int  cSOURCE_LENGTH_MAX = 1024 * 100;      // 100K bytes max length for json string, only for the '\0' ending interface
 const char cENDING            = '\0';            // ending char for string or the input json string
 const char cPATH_SEPARATE     = '.';             // separate char for path pattern
 
+/* 内部使用的查找状态，与Search一致，但是pattern带有长度，不要求以0结尾 */
+typedef struct {
+    const UBYTE   *pattern;
+    size_t        patternLength;
+    ValueType     valueType;
+    bool          keyFoundInObject;
+    SearchOptions options;
+    bool          unescapeKey;
+    size_t        maxDepth;        // 最多嵌套的层数，0: cSEARCH_DEPTH_DEFAULT
+    bool          startOnly;       // 找到的object和array只需要起始位置，长度返回到input结束为止
+} SearchState;
+
+/* 路径中的一段: .key 或者 [n] */
+typedef enum {
+    P_KEY,
+    P_INDEX
+} PathSegmentType;
+
+typedef struct {
+    PathSegmentType type;
+    const UBYTE     *key;          // P_KEY: key的起始位置，不以0结尾
+    size_t          keyLength;
+    size_t          index;         // P_INDEX: 以0为开始的下标
+    uint64_t        hash;          // P_KEY: key的hash，只有compilePath会计算
+} PathSegment;
+
+/* 编译后的路径，整个结构体只分配一次，编译后不再修改，可以在多个线程中同时使用 */
+struct CompiledPath {
+    size_t      segmentCount;
+    PathSegment *segments;         // 紧跟在结构体后面
+    UBYTE       *pattern;          // pattern的拷贝，segments中的key指向这里
+};
+
 bool isWhiteSpace( UBYTE oneByte ){
     return oneByte == ' ' || oneByte == '\n' || oneByte == '\r' || oneByte == '\t';
 };
@@ -27,58 +77,258 @@ bool isDigit( UBYTE oneByte ){
 }
 
 /**
+ * 以0结尾的旧接口的input长度，最长不超过cSOURCE_LENGTH_MAX
  * @param input
- * @param type   return 1: J_INT, 2: J_FLOAT
+ * @return length in UBYTEs
+ */
+size_t terminatedLength( const UBYTE *input ){
+    if ( input == NULL) return 0;
+
+    return strnlen((const char *) input, (size_t) cSOURCE_LENGTH_MAX );
+}
+
+/* FNV-1a，key按原始字节计算，不做反转义，与parseKey的比较一致 */
+uint64_t hashKey( const UBYTE *key, size_t keyLength ){
+
+    uint64_t hash = 14695981039346656037ull;
+    for ( size_t i = 0; i < keyLength; i++ ) {
+        hash ^= key[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+/* 解析后的十进制数字: (-1)^negative * mantissa * 10^exponent */
+typedef struct {
+    bool      negative;
+    uint64_t  mantissa;            // 最多19位有效数字
+    int64_t   exponent;
+    bool      truncated;           // 超过19位的有效数字中有非0的数字被丢弃
+    ValueType type;                // J_INT或者J_FLOAT
+} DecimalNumber;
+
+const int     cMAX_MANTISSA_DIGITS   = 19;        // uint64_t最多可以放下19位十进制数
+const int64_t cMAX_EXPONENT          = 100000;    // 超过这个范围的指数已经没有意义
+const int64_t cSMALLEST_POWER_OF_TEN = -342;      // 小于这个指数的数字都是0
+const int64_t cLARGEST_POWER_OF_TEN  = 308;       // 大于这个指数的数字都是无穷大
+
+/* 精确的10的整数次幂，用于Clinger的快速路径 */
+const double cEXACT_POWER_OF_TEN[] = {
+        1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+        1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+void addDigit( DecimalNumber *number, int *digits, UBYTE c, bool isFraction ){
+
+    unsigned digit = (unsigned) ( c - '0' );
+
+    // 前导的0不算有效数字
+    if ( number->mantissa == 0 && digit == 0 ) {
+        if ( isFraction ) number->exponent--;
+        return;
+    }
+
+    if ( *digits < cMAX_MANTISSA_DIGITS ) {
+        number->mantissa = number->mantissa * 10 + digit;
+        ( *digits )++;
+        if ( isFraction ) number->exponent--;
+        return;
+    }
+
+    // 放不下的数字直接丢弃，整数部分需要调整指数
+    if ( digit != 0 ) number->truncated = true;
+    if ( !isFraction ) number->exponent++;
+}
+
+/**
+ * 一次扫描同时完成数字的校验和转换: -?(0|[1-9][0-9]*)(\.[0-9]*)?([eE][+-]?[0-9]+)?
+ * 为了兼容以前的行为，小数点后面可以没有数字
+ * @param input
+ * @param inputLength input中可用的长度
+ * @param number      用于返回解析的结果
  * @return 0: PARSE_ERROR, other: length in UBYTEs
  */
-unsigned int parseNumber( const UBYTE *input, int *type ){
+size_t scanNumber( const UBYTE *input, size_t inputLength, DecimalNumber *number ){
 
-    if ( input == NULL) return (int) PARSE_ERROR;
+    if ( input == NULL || inputLength == 0 ) return (size_t) PARSE_ERROR;
 
-    int i   = 0;
-    UBYTE c = input[i];
-    if ( c != '-' && ( c < '0' || c > '9' )) return (int) PARSE_ERROR;
+    size_t i      = 0;
+    int    digits = 0;
 
-    if ( c == '-' )i++;
+    number->negative  = input[0] == '-';
+    number->mantissa  = 0;
+    number->exponent  = 0;
+    number->truncated = false;
+    number->type      = J_INT;
 
-    c = input[i];
-    bool hasDotAlready = false;
+    if ( number->negative ) i++;
+    if ( i >= inputLength || !isDigit( input[i] )) return (size_t) PARSE_ERROR;
 
-    if ( c == '0' ) {
-        if ( input[i + 1] != '.' ) {
-            *type = J_INT;
-            return i + 1;
-        } else {
-            i++;
+    if ( input[i] == '0' ) {
+        // 0后面不能再跟数字
+        i++;
+    } else {
+        // 整数部分没有前导的0，前19位可以直接累加
+        while ( i < inputLength && isDigit( input[i] ) && digits < cMAX_MANTISSA_DIGITS ) {
+            number->mantissa = number->mantissa * 10 + (unsigned) ( input[i++] - '0' );
+            digits++;
         }
+        while ( i < inputLength && isDigit( input[i] )) addDigit( number, &digits, input[i++], false );
+    }
+
+    if ( i < inputLength && input[i] == '.' ) {
+        number->type = J_FLOAT;
+        i++;
+        while ( i < inputLength && isDigit( input[i] )) addDigit( number, &digits, input[i++], true );
+        if ( i < inputLength && input[i] == '.' ) return (size_t) PARSE_ERROR;
     }
 
-    do {
-        c = input[i];
-        if ( c == '.' && hasDotAlready ) return (int) PARSE_ERROR;
-        if ( c == '.' ) hasDotAlready = true;
+    if ( i < inputLength && ( input[i] == 'e' || input[i] == 'E' )) {
+        number->type = J_FLOAT;
         i++;
-    } while (( isDigit( input[i] ) || input[i] == '.' ) && i < cSOURCE_LENGTH_MAX && input[i] != cENDING );
 
-    if ( i >= cSOURCE_LENGTH_MAX || input[i] == cENDING ) return (int) OVER_FLOW;
+        bool negativeExponent = false;
+        if ( i < inputLength && ( input[i] == '+' || input[i] == '-' )) negativeExponent = input[i++] == '-';
+        if ( i >= inputLength || !isDigit( input[i] )) return (size_t) PARSE_ERROR;
+
+        int64_t exponent = 0;
+        while ( i < inputLength && isDigit( input[i] )) {
+            if ( exponent < cMAX_EXPONENT ) exponent = exponent * 10 + ( input[i] - '0' );
+            i++;
+        }
+        number->exponent += negativeExponent ? -exponent : exponent;
+    }
 
-    *type = (int) ( hasDotAlready ? J_FLOAT : J_INT );
     return i;
 }
 
+/**
+ * @param input
+ * @param inputLength input中可用的长度
+ * @param type   return 1: J_INT, 2: J_FLOAT
+ * @return 0: PARSE_ERROR, other: length in UBYTEs
+ */
+size_t parseNumber( const UBYTE *input, size_t inputLength, int *type ){
+
+    DecimalNumber number;
+    size_t        length = scanNumber( input, inputLength, &number );
+    if ( length == (size_t) PARSE_ERROR) return (size_t) PARSE_ERROR;
+
+    *type = (int) number.type;
+    return length;
+}
+
+/**
+ * @return false: 不是整数或者超出int64_t的范围
+ */
+bool decimalToInt64( const DecimalNumber *number, int64_t *value ){
+
+    if ( number->type != J_INT || number->truncated || number->exponent != 0 ) return false;
+
+    uint64_t limit = number->negative ? (uint64_t) INT64_MAX + 1 : (uint64_t) INT64_MAX;
+    if ( number->mantissa > limit ) return false;
+
+    *value = number->negative ? (int64_t) ( 0 - number->mantissa ) : (int64_t) number->mantissa;
+    return true;
+}
+
+/**
+ * 不经过strtod，直接得到最接近的double
+ * 先尝试Clinger的快速路径，再使用Eisel-Lemire算法
+ * @return false: 无法快速确定结果(有效数字被截断或者是非规格化数)，需要使用strtod
+ */
+bool decimalToDouble( const DecimalNumber *number, double *value ){
+
+    if ( number->truncated ) return false;
+
+    if ( number->mantissa == 0 ) {
+        *value = number->negative ? -0.0 : 0.0;
+        return true;
+    }
+
+#if FLT_EVAL_METHOD == 0
+    // mantissa和10^exponent都可以精确的表示为double时，一次乘除法的结果就是正确舍入的
+    if ( number->mantissa <= ( (uint64_t) 1 << 53 ) && number->exponent >= -22 && number->exponent <= 22 ) {
+        double result = (double) number->mantissa;
+        if ( number->exponent < 0 ) result /= cEXACT_POWER_OF_TEN[-number->exponent];
+        else result *= cEXACT_POWER_OF_TEN[number->exponent];
+        *value = number->negative ? -result : result;
+        return true;
+    }
+#endif
+
+#ifdef __SIZEOF_INT128__
+    uint64_t bits;
+    if ( number->exponent < cSMALLEST_POWER_OF_TEN ) {
+        bits = 0;
+    } else if ( number->exponent > cLARGEST_POWER_OF_TEN ) {
+        bits = (uint64_t) 0x7FF << 52;
+    } else {
+        // mantissa * 5^q的高位，精度不够时再乘上低64位
+        int      leadingZeros = __builtin_clzll( number->mantissa );
+        uint64_t w            = number->mantissa << leadingZeros;
+        size_t   index        = (size_t) ( number->exponent - cSMALLEST_POWER_OF_TEN ) * 2;
+
+        unsigned __int128 product = (unsigned __int128) w * cPOWER_OF_FIVE_128[index];
+        uint64_t          high    = (uint64_t) ( product >> 64 );
+        uint64_t          low     = (uint64_t) product;
+        if (( high & 0x1FF ) == 0x1FF ) {
+            uint64_t secondHigh = (uint64_t) (((unsigned __int128) w * cPOWER_OF_FIVE_128[index + 1] ) >> 64 );
+            low += secondHigh;
+            if ( secondHigh > low ) high++;
+        }
+
+        int      upperBit = (int) ( high >> 63 );
+        int      shift    = upperBit + 64 - 52 - 3;
+        uint64_t mantissa = high >> shift;
+        int64_t  power2   = (( 217706 * number->exponent ) >> 16 ) + 63 + upperBit - leadingZeros + 1023;
+
+        // 非规格化数交给strtod
+        if ( power2 <= 0 ) return false;
+
+        // 刚好在两个double中间时向偶数舍入
+        if ( low <= 1 && number->exponent >= -4 && number->exponent <= 23 && ( mantissa & 3 ) == 1
+             && ( mantissa << shift ) == high ) {
+            mantissa &= ~(uint64_t) 1;
+        }
+
+        mantissa += mantissa & 1;
+        mantissa >>= 1;
+        if ( mantissa >= ( (uint64_t) 2 << 52 )) {
+            mantissa = (uint64_t) 1 << 52;
+            power2++;
+        }
+        mantissa &= ~( (uint64_t) 1 << 52 );
+
+        if ( power2 >= 0x7FF ) {
+            power2   = 0x7FF;
+            mantissa = 0;
+        }
+        bits = mantissa | ( (uint64_t) power2 << 52 );
+    }
+
+    bits |= (uint64_t) number->negative << 63;
+    memcpy( value, &bits, sizeof( double ));
+    return true;
+#else
+    return false;
+#endif
+}
+
 /**
  *
  * @param input
+ * @param inputLength
  * @return length in UBYTEs
  */
-unsigned int parseTrue( const UBYTE *input ){
-    if ( input == NULL) return (int) PARSE_ERROR;
+size_t parseTrue( const UBYTE *input, size_t inputLength ){
+    if ( input == NULL || inputLength < 4 ) return (size_t) PARSE_ERROR;
 
     if ( input[0] != 't'
          || input[1] != 'r'
          || input[2] != 'u'
          || input[3] != 'e' )
-        return (int) PARSE_ERROR;
+        return (size_t) PARSE_ERROR;
 
     return 4;
 }
@@ -86,17 +336,18 @@ unsigned int parseTrue( const UBYTE *input ){
 /**
  *
  * @param input
+ * @param inputLength
  * @return length in UBYTEs
  */
-unsigned int parseFalse( const UBYTE *input ){
-    if ( input == NULL) return (int) PARSE_ERROR;
+size_t parseFalse( const UBYTE *input, size_t inputLength ){
+    if ( input == NULL || inputLength < 5 ) return (size_t) PARSE_ERROR;
 
     if ( input[0] != 'f'
          || input[1] != 'a'
          || input[2] != 'l'
          || input[3] != 's'
          || input[4] != 'e' )
-        return (int) PARSE_ERROR;
+        return (size_t) PARSE_ERROR;
 
     return 5;
 }
@@ -104,1001 +355,4817 @@ unsigned int parseFalse( const UBYTE *input ){
 /**
  *
  * @param input
+ * @param inputLength
  * @return length in UBYTEs
  */
-unsigned int parseNull( const UBYTE *input ){
-    if ( input == NULL) return (int) PARSE_ERROR;
+size_t parseNull( const UBYTE *input, size_t inputLength ){
+    if ( input == NULL || inputLength < 4 ) return (size_t) PARSE_ERROR;
 
     if ( input[0] != 'n'
          || input[1] != 'u'
          || input[2] != 'l'
          || input[3] != 'l' )
-        return (int) PARSE_ERROR;
+        return (size_t) PARSE_ERROR;
 
     return 4;
 }
 
+#define cSCAN_KINDS_ON_STACK 4                    // 不超过64 * 4层时不分配内存
+
+/* scanValue的状态，跨越block时需要保留 */
+typedef struct {
+    size_t   depth;                // 当前嵌套的层数
+    bool     inString;             // 是否在字符串内部
+    bool     escapeNext;           // 上一个block的最后一个字节是转义符
+    uint64_t *kinds;               // 每一层一个bit，1: array, 0: object
+    size_t   kindCapacity;         // kinds中bit的个数
+    uint64_t stackKinds[cSCAN_KINDS_ON_STACK];
+} ScanState;
+
+/* 记录新的一层是object还是array，层数超过kindCapacity时在堆上翻倍 */
+bool pushScanKind( ScanState *state, bool isArray ){
+
+    if ( state->depth == state->kindCapacity ) {
+        size_t   words  = state->kindCapacity / 64;
+        uint64_t *bigger = state->kinds == state->stackKinds
+                           ? (uint64_t *) malloc( sizeof( uint64_t ) * words * 2 )
+                           : (uint64_t *) realloc( state->kinds, sizeof( uint64_t ) * words * 2 );
+        if ( bigger == NULL) return false;
+        if ( state->kinds == state->stackKinds ) memcpy( bigger, state->stackKinds, sizeof( state->stackKinds ));
+        state->kinds        = bigger;
+        state->kindCapacity = words * 2 * 64;
+    }
+
+    uint64_t bit = (uint64_t) 1 << ( state->depth % 64 );
+    if ( isArray ) state->kinds[state->depth / 64] |= bit;
+    else state->kinds[state->depth / 64] &= ~bit;
+    state->depth++;
+    return true;
+}
+
 /**
- *
- * @param input
- * @return length in UBYTEs
+ * 处理一个block中的结构字符，mask中的第n位对应input[base + n]
+ * 只关心 " \ { } [ ]，其它字节已经被mask过滤掉
+ * @param width block的长度，转义符在最后一个字节时由下一个block跳过
+ * @return true: value已经结束，结束位置写入end，括号不配对时end为PARSE_ERROR
  */
-unsigned int parseString( const UBYTE *input ){
-    if ( input == NULL) return (int) PARSE_ERROR;
-
-    if ( input[0] != '"' ) return (int) PARSE_ERROR;
+bool scanMask( const UBYTE *input, size_t base, unsigned width, uint64_t mask, ScanState *state, size_t *end ){
+
+    while ( mask ) {
+        unsigned bit = (unsigned) __builtin_ctzll( mask );
+        mask &= mask - 1;
+        UBYTE c = input[base + bit];
+
+        if ( state->inString ) {
+            if ( c == '\\' ) {
+                // 跳过被转义的字节，可能在下一个block
+                if ( bit == width - 1 ) state->escapeNext = true;
+                else mask &= ~( (uint64_t) 1 << ( bit + 1 ));
+            } else if ( c == '"' ) {
+                state->inString = false;
+                if ( state->depth == 0 ) {
+                    *end = base + bit + 1;
+                    return true;
+                }
+            }
+            continue;
+        }
 
-    int i = 1;
+        if ( c == '"' ) {
+            state->inString = true;
+        } else if ( c == '{' || c == '[' ) {
+            if ( !pushScanKind( state, c == '[' )) {
+                *end = (size_t) PARSE_ERROR;
+                return true;
+            }
+        } else if ( c == '}' || c == ']' ) {
+            size_t depth   = --state->depth;
+            bool   isArray = ( state->kinds[depth / 64] >> ( depth % 64 ) & 1 ) != 0;
+            if ( isArray != ( c == ']' )) {
+                *end = (size_t) PARSE_ERROR;
+                return true;
+            }
+            if ( depth == 0 ) {
+                *end = base + bit + 1;
+                return true;
+            }
+        }
+    }
 
-    bool lastIsControl = false;
+    return false;
+}
 
-    while ( input[i] != cENDING ) {
+/* 逐字节处理剩余部分 */
+size_t scanValueTail( const UBYTE *input, size_t i, size_t inputLength, ScanState *state ){
 
-        UBYTE c = input[i];
-        if ( c == '\\' && lastIsControl == false ) {
-            lastIsControl = true;
-            i++;
+    for ( ; i < inputLength; i++ ) {
+        if ( state->escapeNext ) {
+            state->escapeNext = false;
             continue;
         }
 
-        if ( c == '"' && lastIsControl == false )break;
+        UBYTE c = input[i];
+        if ( c != '"' && c != '\\' && c != '{' && c != '}' && c != '[' && c != ']' ) continue;
 
-        i++;
-        lastIsControl = false;
+        size_t end;
+        if ( scanMask( input, i, 1, 1, state, &end )) return end;
     }
 
-    if ( input[i] == cENDING ) return (int) OVER_FLOW;
+    return (size_t) OVER_FLOW;
+}
 
-    // including left and right "
-    return i + 1;
+void initScanState( const UBYTE *input, ScanState *state ){
+    state->depth        = 0;
+    state->inString     = input[0] == '"';
+    state->escapeNext   = false;
+    state->kinds        = state->stackKinds;
+    state->kindCapacity = cSCAN_KINDS_ON_STACK * 64;
+    if ( !state->inString ) pushScanKind( state, input[0] == '[' );
+}
+
+/* 返回scan的结果，释放层数较多时分配的内存 */
+size_t releaseScanState( ScanState *state, size_t result ){
+    if ( state->kinds != state->stackKinds ) free( state->kinds );
+    return result;
 }
 
 /**
- * 解析key，并且判断是否和targetKey一致, 这里没有判断长度越界，有潜在风险
- * @param input
- * @param targetKey 以0结尾的需要查找的key
- * @param keyLength 用于返回的key长度，包含左右双引号
- * @return 0: PARSE_ERROR, 1: FOUND,  -1: NOT FOUND
+ * 不做校验，只根据引号、转义和括号找到value的结尾
+ * @param input       以 " { [ 开头
+ * @param inputLength
+ * @return 0: OVER_FLOW或者括号不配对, other: length in UBYTEs
  */
-int parseKey( const UBYTE *input, const UBYTE *targetKey, int *keyLength ){
+size_t scanValueScalar( const UBYTE *input, size_t inputLength ){
 
-    if ( input == NULL) return (int) PARSE_ERROR;
-    if ( input[0] != '"' ) return (int) PARSE_ERROR;
+    ScanState state;
+    initScanState( input, &state );
+    return releaseScanState( &state, scanValueTail( input, 1, inputLength, &state ));
+}
 
-    int i = 1;
+#if defined( __x86_64__ ) || defined( __i386__ )
 
-    bool isSame        = true;             // 判断是否和targetKey一致
-    bool lastIsControl = false;
+__attribute__(( target( "sse2" )))
+size_t scanValueSSE2( const UBYTE *input, size_t inputLength ){
 
-    while ( input[i] != cENDING ) {
+    ScanState state;
+    initScanState( input, &state );
 
-        UBYTE c = input[i];
-        if ( c == '"' && lastIsControl == false )break;
+    const __m128i quote     = _mm_set1_epi8( '"' );
+    const __m128i backslash = _mm_set1_epi8( '\\' );
+    const __m128i open      = _mm_set1_epi8( '{' );
+    const __m128i close     = _mm_set1_epi8( '}' );
+    const __m128i lower     = _mm_set1_epi8( 0x20 );
 
-        if ( isSame ) {
-            // 这里不会有targetKey越界风险，因为source不会为0
-            isSame = input[i] == targetKey[i - 1];
-        }
+    size_t i = 1, end;
+    for ( ; i + 16 <= inputLength; i += 16 ) {
+        __m128i block  = _mm_loadu_si128((const __m128i *) ( input + i ));
+        __m128i folded = _mm_or_si128( block, lower );    // 只用于定位，'[' -> '{', ']' -> '}'
+        __m128i hits   = _mm_or_si128( _mm_or_si128( _mm_cmpeq_epi8( block, quote ), _mm_cmpeq_epi8( block, backslash )),
+                                       _mm_or_si128( _mm_cmpeq_epi8( folded, open ), _mm_cmpeq_epi8( folded, close )));
 
-        if ( c == '\\' && lastIsControl == false ) {
-            lastIsControl = true;
-            i++;
-            continue;
+        uint64_t mask = (uint64_t) (unsigned) _mm_movemask_epi8( hits );
+        if ( state.escapeNext ) {
+            // 上一个block的最后一个字节是转义符
+            mask &= ~(uint64_t) 1;
+            state.escapeNext = false;
         }
-
-        i++;
-        lastIsControl = false;
+        if ( mask && scanMask( input, i, 16, mask, &state, &end )) return releaseScanState( &state, end );
     }
 
-    if ( input[i] == cENDING ) return (int) PARSE_ERROR;
-
-    *keyLength = i + 1;
+    return releaseScanState( &state, scanValueTail( input, i, inputLength, &state ));
+}
 
-    isSame = isSame && targetKey[i - 1] == cENDING;
+__attribute__(( target( "avx2" )))
+size_t scanValueAVX2( const UBYTE *input, size_t inputLength ){
+
+    ScanState state;
+    initScanState( input, &state );
+
+    const __m256i quote     = _mm256_set1_epi8( '"' );
+    const __m256i backslash = _mm256_set1_epi8( '\\' );
+    const __m256i open      = _mm256_set1_epi8( '{' );
+    const __m256i close     = _mm256_set1_epi8( '}' );
+    const __m256i lower     = _mm256_set1_epi8( 0x20 );
+
+    size_t i = 1, end;
+    for ( ; i + 32 <= inputLength; i += 32 ) {
+        __m256i block  = _mm256_loadu_si256((const __m256i *) ( input + i ));
+        __m256i folded = _mm256_or_si256( block, lower );    // 只用于定位，'[' -> '{', ']' -> '}'
+        __m256i hits   = _mm256_or_si256(
+                _mm256_or_si256( _mm256_cmpeq_epi8( block, quote ), _mm256_cmpeq_epi8( block, backslash )),
+                _mm256_or_si256( _mm256_cmpeq_epi8( folded, open ), _mm256_cmpeq_epi8( folded, close )));
+
+        uint64_t mask = (uint64_t) (uint32_t) _mm256_movemask_epi8( hits );
+        if ( state.escapeNext ) {
+            // 上一个block的最后一个字节是转义符
+            mask &= ~(uint64_t) 1;
+            state.escapeNext = false;
+        }
+        if ( mask && scanMask( input, i, 32, mask, &state, &end )) return releaseScanState( &state, end );
+    }
 
-    return isSame ? 1 : -1;
+    return releaseScanState( &state, scanValueTail( input, i, inputLength, &state ));
 }
 
-const UBYTE *parseValue( const UBYTE *input, int *length, int *lengthWithBlanks, Search *search, ValueType *valueType );
+#endif
 
-const UBYTE *parseObject( const UBYTE *input, int *objectLength, Search *search ){
-    CHECK_NULL( input )
+size_t scanValueDispatch( const UBYTE *input, size_t inputLength );
 
-    if (( input[0] ) != '{' ) {
-        search->valueType = J_PARSE_ERROR;
-        return PARSE_ERROR;
-    }
+/* 第一次调用时根据CPU选择实现 */
+size_t (*scanValueKernel)( const UBYTE *input, size_t inputLength ) = scanValueDispatch;
 
-    int i = 1;
-    bool justParsedKey             = false;      // 解析完key;
-    bool JustParsedValue           = false;    // 解析完一对Key，value;
-    bool targetKeyFoundInThisLevel = false;
+size_t scanValueDispatch( const UBYTE *input, size_t inputLength ){
 
-    UBYTE c;
-    do {
-        c = input[i];
-        if ( isWhiteSpace( c )) {
-            i++;
-            continue;
-        }
+    size_t (*kernel)( const UBYTE *input, size_t inputLength ) = scanValueScalar;
+#if defined( __x86_64__ ) || defined( __i386__ )
+    __builtin_cpu_init();
+    if ( __builtin_cpu_supports( "avx2" )) {
+        kernel = scanValueAVX2;
+    } else if ( __builtin_cpu_supports( "sse2" )) {
+        kernel = scanValueSSE2;
+    }
+#endif
+    STORE_KERNEL( scanValueKernel, kernel );
 
-        if ( c == '"' ) {
+    return kernel( input, inputLength );
+}
 
-            int keyLength = 0;
-            if ( search->pattern != NULL) {
+/**
+ * 快速跳过一个string、object或者array
+ * object和array只检查括号的种类和字符串是否配对，不检查内部的语法
+ * @param input
+ * @param inputLength
+ * @return 0: PARSE_ERROR, other: length in UBYTEs
+ */
+size_t scanValue( const UBYTE *input, size_t inputLength ){
+    if ( input == NULL || inputLength == 0 ) return (size_t) PARSE_ERROR;
+    if ( input[0] != '"' && input[0] != '{' && input[0] != '[' ) return (size_t) PARSE_ERROR;
 
-                int result = parseKey( input + i, search->pattern, &keyLength );
-                if ( result == 0 ) {
-                    search->valueType = J_PARSE_ERROR;
-                    return PARSE_ERROR;
-                }
-                targetKeyFoundInThisLevel = result == 1;
-                if ( targetKeyFoundInThisLevel )search->pattern = NULL;
+    return LOAD_KERNEL( scanValueKernel )( input, inputLength );
+}
 
-            } else {
+/**
+ *
+ * @param input
+ * @param inputLength
+ * @return length in UBYTEs
+ */
+size_t parseString( const UBYTE *input, size_t inputLength ){
+    if ( input == NULL || inputLength == 0 ) return (size_t) PARSE_ERROR;
 
-                keyLength = parseString( input + i );
-                if ( keyLength == (int) PARSE_ERROR) {
-                    search->valueType = J_PARSE_ERROR;
-                    return PARSE_ERROR;
-                }
-            }
+    if ( input[0] != '"' ) return (size_t) PARSE_ERROR;
 
-            // 指针后移，包括匹配的引号也跳过
-            i += keyLength;
-            justParsedKey = true;
-            continue;
-        }
+    // including left and right "
+    return scanValue( input, inputLength );
+}
 
-        if ( c == ':' ) {
-            if ( !justParsedKey ) {
-                search->valueType = J_PARSE_ERROR;
-                return PARSE_ERROR;
-            }
+/**
+ * 找到第一个转义符
+ * @return 转义符的位置，没有转义符时返回length
+ */
+size_t findBackslashScalar( const UBYTE *input, size_t length ){
 
-            // 解析本层的对象
-            i++;
-            int valueLength      = 0;
-            int lengthWithBlanks = 0;
+    const UBYTE *found = (const UBYTE *) memchr( input, '\\', length );
+    return found == NULL ? length : (size_t) ( found - input );
+}
 
-            Search    searchNextLevel = { NULL, search->valueType, search->keyFoundInObject, S_NORMAL };
-            ValueType valueType;
+#if defined( __x86_64__ ) || defined( __i386__ )
 
-            const UBYTE *result = parseValue( input + i, &valueLength, &lengthWithBlanks,
-                                              search->options == S_RECURSIVE ? search : &searchNextLevel, &valueType );
+__attribute__(( target( "sse2" )))
+size_t findBackslashSSE2( const UBYTE *input, size_t length ){
 
-            if ( result == PARSE_ERROR) {
-                search->valueType = J_PARSE_ERROR;
-                return PARSE_ERROR;
-            }
+    const __m128i backslash = _mm_set1_epi8( '\\' );
 
-            if ( targetKeyFoundInThisLevel ) {
+    size_t i = 0;
+    for ( ; i + 16 <= length; i += 16 ) {
+        __m128i  block = _mm_loadu_si128((const __m128i *) ( input + i ));
+        unsigned mask  = (unsigned) _mm_movemask_epi8( _mm_cmpeq_epi8( block, backslash ));
+        if ( mask ) return i + (size_t) __builtin_ctz( mask );
+    }
 
-                // key在本层
-                search->keyFoundInObject = true;
-                search->valueType        = valueType;
-                *objectLength = valueLength;
-                return result;
-            }
+    return i + findBackslashScalar( input + i, length - i );
+}
 
-            if ( search->keyFoundInObject ) {
-                // key在下层已经找到
-                *objectLength = valueLength;
-                return result;
-            }
+__attribute__(( target( "avx2" )))
+size_t findBackslashAVX2( const UBYTE *input, size_t length ){
 
-            // 继续查找
-            JustParsedValue = true;
-            justParsedKey   = false;
-            i += lengthWithBlanks;
-            continue;
-        }
+    const __m256i backslash = _mm256_set1_epi8( '\\' );
 
-        if ( c == ',' ) {
+    size_t i = 0;
+    for ( ; i + 32 <= length; i += 32 ) {
+        __m256i  block = _mm256_loadu_si256((const __m256i *) ( input + i ));
+        uint32_t mask  = (uint32_t) _mm256_movemask_epi8( _mm256_cmpeq_epi8( block, backslash ));
+        if ( mask ) return i + (size_t) __builtin_ctz( mask );
+    }
 
-            if ( !JustParsedValue ) {
-                search->valueType = J_PARSE_ERROR;
-                return PARSE_ERROR;
-            }
+    return i + findBackslashScalar( input + i, length - i );
+}
 
-            i++;
-            JustParsedValue = false;
-            continue;
-        }
+#endif
 
-        if ( c == '}' ) {
-            break;
-        }
+size_t findBackslashDispatch( const UBYTE *input, size_t length );
 
-        search->valueType = J_PARSE_ERROR;
-        return PARSE_ERROR;
+/* 第一次调用时根据CPU选择实现 */
+size_t (*findBackslashKernel)( const UBYTE *input, size_t length ) = findBackslashDispatch;
 
-    } while ( input[i] != cENDING && i < cSOURCE_LENGTH_MAX );
+size_t findBackslashDispatch( const UBYTE *input, size_t length ){
 
-    if ( input[i] == cENDING || i >= cSOURCE_LENGTH_MAX ) {
-        search->valueType = J_PARSE_ERROR;
-        return OVER_FLOW;
+    size_t (*kernel)( const UBYTE *input, size_t length ) = findBackslashScalar;
+#if defined( __x86_64__ ) || defined( __i386__ )
+    __builtin_cpu_init();
+    if ( __builtin_cpu_supports( "avx2" )) {
+        kernel = findBackslashAVX2;
+    } else if ( __builtin_cpu_supports( "sse2" )) {
+        kernel = findBackslashSSE2;
     }
+#endif
+    STORE_KERNEL( findBackslashKernel, kernel );
 
-    *objectLength = i + 1;
+    return kernel( input, length );
+}
 
-    search->valueType = J_NOT_FOUND;
-    return input;
+/* 第一个转义符的位置，没有时返回length */
+size_t findBackslash( const UBYTE *input, size_t length ){
+    return LOAD_KERNEL( findBackslashKernel )( input, length );
 }
 
-const UBYTE *parseArray( const UBYTE *input, int *arrayLength, Search *search ){
-    CHECK_NULL( input )
+/* 解析\u后面的4个16进制数字，出错返回false */
+bool parseHex4( const UBYTE *input, size_t length, uint32_t *value ){
 
-    int i = 0;
-    if ( input[i] != '[' ) return PARSE_ERROR;
-    i++;
+    if ( length < 4 ) return false;
 
-    do {
-        UBYTE c = input[i];
+    *value = 0;
+    for ( int i = 0; i < 4; i++ ) {
+        UBYTE    c = input[i];
+        uint32_t digit;
+        if ( c >= '0' && c <= '9' ) digit = c - '0';
+        else if (( c | 0x20 ) >= 'a' && ( c | 0x20 ) <= 'f' ) digit = ( c | 0x20 ) - 'a' + 10;
+        else return false;
+        *value = *value << 4 | digit;
+    }
+    return true;
+}
 
-        if ( isWhiteSpace( c )) {
-            i++;
-            continue;
-        }
+/**
+ * 解析一个转义序列，😀这样的代理对合并为一个字符
+ * @param input    以\开头
+ * @param length
+ * @param output   UTF-8编码的结果，最多4个字节
+ * @param consumed 转义序列的长度
+ * @return UTF-8编码的长度，0: 转义序列不正确或者代理对不完整
+ */
+size_t decodeEscape( const UBYTE *input, size_t length, UBYTE *output, size_t *consumed ){
+
+    if ( length < 2 ) return 0;
+
+    *consumed = 2;
+    switch ( input[1] ) {
+        case '"': output[0] = '"'; return 1;
+        case '\\': output[0] = '\\'; return 1;
+        case '/': output[0] = '/'; return 1;
+        case 'b': output[0] = '\b'; return 1;
+        case 'f': output[0] = '\f'; return 1;
+        case 'n': output[0] = '\n'; return 1;
+        case 'r': output[0] = '\r'; return 1;
+        case 't': output[0] = '\t'; return 1;
+        case 'u': break;
+        default: return 0;
+    }
 
-        if ( input[i] == ']' ) {
-            break;
-        }
+    uint32_t codePoint;
+    if ( !parseHex4( input + 2, length - 2, &codePoint )) return 0;
+    *consumed = 6;
+
+    if ( codePoint >= 0xDC00 && codePoint <= 0xDFFF ) return 0;
+    if ( codePoint >= 0xD800 && codePoint <= 0xDBFF ) {
+        // 高位代理后面必须紧跟低位代理
+        uint32_t low;
+        if ( length < 12 || input[6] != '\\' || input[7] != 'u' || !parseHex4( input + 8, length - 8, &low )
+             || low < 0xDC00 || low > 0xDFFF )
+            return 0;
+        codePoint = 0x10000 + (( codePoint - 0xD800 ) << 10 ) + ( low - 0xDC00 );
+        *consumed = 12;
+    }
 
-        int       valueLength      = 0;
-        int       lengthWithBlanks = 0;
-        ValueType valueType;
+    if ( codePoint < 0x80 ) {
+        output[0] = (UBYTE) codePoint;
+        return 1;
+    }
+    if ( codePoint < 0x800 ) {
+        output[0] = (UBYTE) ( 0xC0 | codePoint >> 6 );
+        output[1] = (UBYTE) ( 0x80 | ( codePoint & 0x3F ));
+        return 2;
+    }
+    if ( codePoint < 0x10000 ) {
+        output[0] = (UBYTE) ( 0xE0 | codePoint >> 12 );
+        output[1] = (UBYTE) ( 0x80 | ( codePoint >> 6 & 0x3F ));
+        output[2] = (UBYTE) ( 0x80 | ( codePoint & 0x3F ));
+        return 3;
+    }
+    output[0] = (UBYTE) ( 0xF0 | codePoint >> 18 );
+    output[1] = (UBYTE) ( 0x80 | ( codePoint >> 12 & 0x3F ));
+    output[2] = (UBYTE) ( 0x80 | ( codePoint >> 6 & 0x3F ));
+    output[3] = (UBYTE) ( 0x80 | ( codePoint & 0x3F ));
+    return 4;
+}
 
-        Search      normalSearch = { NULL, search->valueType, search->keyFoundInObject, S_NORMAL };
-        const UBYTE *result      = parseValue( input + i, &valueLength, &lengthWithBlanks,
-                                               search->options == S_NORMAL ? &normalSearch : search, &valueType );
+bool unescapeString( const UBYTE *input, size_t length, UBYTE *output, size_t *outputLength ){
 
-        if ( result == PARSE_ERROR) return PARSE_ERROR;
+    if ( input == NULL || output == NULL || outputLength == NULL) return false;
 
-        if ( search->keyFoundInObject ) {
-            // key在下层已经找到
-            *arrayLength = valueLength; // 此时这个长度并不是完整的array，已经不需要完全解析本数组，只需要返回找到的值即可
-            return result;
-        }
+    size_t i = 0, written = 0;
+    while ( true ) {
+        // 两个转义符之间的内容整段拷贝
+        size_t run = findBackslash( input + i, length - i );
+        memmove( output + written, input + i, run );
+        written += run;
+        i += run;
+        if ( i == length ) break;
+
+        size_t consumed;
+        size_t decoded = decodeEscape( input + i, length - i, output + written, &consumed );
+        if ( decoded == 0 ) return false;
+        written += decoded;
+        i += consumed;
+    }
+
+    *outputLength = written;
+    return true;
+}
+
+/**
+ * 比较转义前的key和不带转义的targetKey，不分配内存
+ * 反转义后不会变长，所以key比targetKey短时一定不同
+ */
+bool isSameUnescapedKey( const UBYTE *key, size_t keyLength, const UBYTE *targetKey, size_t targetKeyLength ){
+
+    if ( keyLength < targetKeyLength ) return false;
+
+    size_t i = 0, j = 0;
+    while ( true ) {
+        size_t run = findBackslash( key + i, keyLength - i );
+        if ( run > targetKeyLength - j || memcmp( key + i, targetKey + j, run ) != 0 ) return false;
+        i += run;
+        j += run;
+        if ( i == keyLength ) return j == targetKeyLength;
+
+        UBYTE  decoded[4];
+        size_t consumed;
+        size_t decodedLength = decodeEscape( key + i, keyLength - i, decoded, &consumed );
+        if ( decodedLength == 0 || decodedLength > targetKeyLength - j
+             || memcmp( decoded, targetKey + j, decodedLength ) != 0 )
+            return false;
+        i += consumed;
+        j += decodedLength;
+    }
+}
 
-        i += lengthWithBlanks;
+/**
+ * 找到第一个不正确的UTF-8字节，ASCII每次检查8个字节
+ * @return 出错的位置，全部正确时返回length
+ */
+size_t findUtf8ErrorScalar( const UBYTE *input, size_t length ){
+
+    size_t i = 0;
+    while ( i < length ) {
+        if ( i + 8 <= length ) {
+            uint64_t block;
+            memcpy( &block, input + i, sizeof( block ));
+            if (( block & 0x8080808080808080ull ) == 0 ) {
+                i += 8;
+                continue;
+            }
+        }
 
-        if ( input[i] == ',' ) {
+        UBYTE c = input[i];
+        if ( c < 0x80 ) {
             i++;
             continue;
         }
 
-        if ( input[i] == ']' )break;
+        // 第二个字节的范围，用来排除过长编码、代理区和超过U+10FFFF的字符
+        size_t count;
+        UBYTE  low = 0x80, high = 0xBF;
+        if ( c >= 0xC2 && c <= 0xDF ) count = 2;
+        else if ( c >= 0xE0 && c <= 0xEF ) {
+            count = 3;
+            if ( c == 0xE0 ) low = 0xA0;
+            if ( c == 0xED ) high = 0x9F;
+        } else if ( c >= 0xF0 && c <= 0xF4 ) {
+            count = 4;
+            if ( c == 0xF0 ) low = 0x90;
+            if ( c == 0xF4 ) high = 0x8F;
+        } else return i;
+
+        if ( i + count > length || input[i + 1] < low || input[i + 1] > high ) return i;
+        for ( size_t j = 2; j < count; j++ ) {
+            if (( input[i + j] & 0xC0 ) != 0x80 ) return i;
+        }
+        i += count;
+    }
+    return length;
+}
 
-        return PARSE_ERROR;
+bool validateUtf8Scalar( const UBYTE *input, size_t length ){
+    return findUtf8ErrorScalar( input, length ) == length;
+}
 
-    } while ( input[i] != cENDING && i < cSOURCE_LENGTH_MAX );
+#if defined( __x86_64__ ) || defined( __i386__ )
+
+/* 查表法校验UTF-8(Keiser & Lemire)，每个字节按前一个字节的高低4位和自己的高4位查3张表，结果相与不为0即出错 */
+#define cUTF8_TOO_SHORT   (1 << 0)
+#define cUTF8_TOO_LONG    (1 << 1)
+#define cUTF8_OVERLONG_3  (1 << 2)
+#define cUTF8_TOO_LARGE   (1 << 3)
+#define cUTF8_SURROGATE   (1 << 4)
+#define cUTF8_OVERLONG_2  (1 << 5)
+#define cUTF8_TOO_LARGE_1000 (1 << 6)
+#define cUTF8_OVERLONG_4  (1 << 6)
+#define cUTF8_TWO_CONTS   (1 << 7)
+#define cUTF8_CARRY       ( cUTF8_TOO_SHORT | cUTF8_TOO_LONG | cUTF8_TWO_CONTS )
+
+__attribute__(( target( "avx2" )))
+__m256i utf8TableLookup( __m256i index, const char *table ){
+    __m128i half = _mm_loadu_si128((const __m128i *) table );
+    return _mm256_shuffle_epi8( _mm256_broadcastsi128_si256( half ), index );
+}
 
-    *arrayLength = i + 1;
-    return input;
+/* 返回这个block中出错的字节，previous是上一个block */
+__attribute__(( target( "avx2" )))
+__m256i checkUtf8Block( __m256i block, __m256i previous ){
+
+    static const char byte1High[16] = {
+            cUTF8_TOO_LONG, cUTF8_TOO_LONG, cUTF8_TOO_LONG, cUTF8_TOO_LONG,
+            cUTF8_TOO_LONG, cUTF8_TOO_LONG, cUTF8_TOO_LONG, cUTF8_TOO_LONG,
+            (char) cUTF8_TWO_CONTS, (char) cUTF8_TWO_CONTS, (char) cUTF8_TWO_CONTS, (char) cUTF8_TWO_CONTS,
+            cUTF8_TOO_SHORT | cUTF8_OVERLONG_2,
+            cUTF8_TOO_SHORT,
+            cUTF8_TOO_SHORT | cUTF8_OVERLONG_3 | cUTF8_SURROGATE,
+            cUTF8_TOO_SHORT | cUTF8_TOO_LARGE | cUTF8_TOO_LARGE_1000 | cUTF8_OVERLONG_4 };
+    static const char byte1Low[16]  = {
+            (char) ( cUTF8_CARRY | cUTF8_OVERLONG_3 | cUTF8_OVERLONG_2 | cUTF8_OVERLONG_4 ),
+            (char) ( cUTF8_CARRY | cUTF8_OVERLONG_2 ),
+            (char) cUTF8_CARRY, (char) cUTF8_CARRY,
+            (char) ( cUTF8_CARRY | cUTF8_TOO_LARGE ),
+            (char) ( cUTF8_CARRY | cUTF8_TOO_LARGE | cUTF8_TOO_LARGE_1000 ),
+            (char) ( cUTF8_CARRY | cUTF8_TOO_LARGE | cUTF8_TOO_LARGE_1000 ),
+            (char) ( cUTF8_CARRY | cUTF8_TOO_LARGE | cUTF8_TOO_LARGE_1000 ),
+            (char) ( cUTF8_CARRY | cUTF8_TOO_LARGE | cUTF8_TOO_LARGE_1000 ),
+            (char) ( cUTF8_CARRY | cUTF8_TOO_LARGE | cUTF8_TOO_LARGE_1000 ),
+            (char) ( cUTF8_CARRY | cUTF8_TOO_LARGE | cUTF8_TOO_LARGE_1000 ),
+            (char) ( cUTF8_CARRY | cUTF8_TOO_LARGE | cUTF8_TOO_LARGE_1000 ),
+            (char) ( cUTF8_CARRY | cUTF8_TOO_LARGE | cUTF8_TOO_LARGE_1000 ),
+            (char) ( cUTF8_CARRY | cUTF8_TOO_LARGE | cUTF8_TOO_LARGE_1000 | cUTF8_SURROGATE ),
+            (char) ( cUTF8_CARRY | cUTF8_TOO_LARGE | cUTF8_TOO_LARGE_1000 ),
+            (char) ( cUTF8_CARRY | cUTF8_TOO_LARGE | cUTF8_TOO_LARGE_1000 ) };
+    static const char byte2High[16] = {
+            cUTF8_TOO_SHORT, cUTF8_TOO_SHORT, cUTF8_TOO_SHORT, cUTF8_TOO_SHORT,
+            cUTF8_TOO_SHORT, cUTF8_TOO_SHORT, cUTF8_TOO_SHORT, cUTF8_TOO_SHORT,
+            (char) ( cUTF8_TOO_LONG | cUTF8_OVERLONG_2 | cUTF8_TWO_CONTS | cUTF8_OVERLONG_3 | cUTF8_TOO_LARGE_1000
+                     | cUTF8_OVERLONG_4 ),
+            (char) ( cUTF8_TOO_LONG | cUTF8_OVERLONG_2 | cUTF8_TWO_CONTS | cUTF8_OVERLONG_3 | cUTF8_TOO_LARGE ),
+            (char) ( cUTF8_TOO_LONG | cUTF8_OVERLONG_2 | cUTF8_TWO_CONTS | cUTF8_SURROGATE | cUTF8_TOO_LARGE ),
+            (char) ( cUTF8_TOO_LONG | cUTF8_OVERLONG_2 | cUTF8_TWO_CONTS | cUTF8_SURROGATE | cUTF8_TOO_LARGE ),
+            cUTF8_TOO_SHORT, cUTF8_TOO_SHORT, cUTF8_TOO_SHORT, cUTF8_TOO_SHORT };
+
+    const __m256i lowNibble = _mm256_set1_epi8( 0x0F );
+
+    // 把上一个block的最后几个字节拼到前面，得到每个字节前面的第1、2、3个字节
+    __m256i carried = _mm256_permute2x128_si256( previous, block, 0x21 );
+    __m256i prev1   = _mm256_alignr_epi8( block, carried, 15 );
+    __m256i prev2   = _mm256_alignr_epi8( block, carried, 14 );
+    __m256i prev3   = _mm256_alignr_epi8( block, carried, 13 );
+
+    __m256i special = _mm256_and_si256(
+            _mm256_and_si256( utf8TableLookup( _mm256_and_si256( _mm256_srli_epi16( prev1, 4 ), lowNibble ), byte1High ),
+                              utf8TableLookup( _mm256_and_si256( prev1, lowNibble ), byte1Low )),
+            utf8TableLookup( _mm256_and_si256( _mm256_srli_epi16( block, 4 ), lowNibble ), byte2High ));
+
+    // 3、4字节编码的第3、4个字节必须是后续字节
+    __m256i third  = _mm256_subs_epu8( prev2, _mm256_set1_epi8((char) ( 0xE0 - 0x80 )));
+    __m256i fourth = _mm256_subs_epu8( prev3, _mm256_set1_epi8((char) ( 0xF0 - 0x80 )));
+    __m256i must23 = _mm256_and_si256( _mm256_or_si256( third, fourth ), _mm256_set1_epi8((char) 0x80 ));
+
+    return _mm256_xor_si256( must23, special );
 }
 
-const UBYTE *parseValue( const UBYTE *input, int *length, int *lengthWithBlanks, Search *search, ValueType *valueType ){
-    CHECK_NULL( input )
+__attribute__(( target( "avx2" )))
+bool validateUtf8AVX2( const UBYTE *input, size_t length ){
+
+    // block最后3个字节是多字节编码的开头时，下一个block必须接着校验
+    static const UBYTE cINCOMPLETE_MAX[32] = {
+            255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255,
+            255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 0xF0 - 1, 0xE0 - 1, 0xC0 - 1 };
+    const __m256i incompleteMax = _mm256_loadu_si256((const __m256i *) cINCOMPLETE_MAX );
+
+    __m256i error      = _mm256_setzero_si256();
+    __m256i previous   = _mm256_setzero_si256();
+    __m256i incomplete = _mm256_setzero_si256();
+
+    size_t i = 0;
+    for ( ; i + 32 <= length; i += 32 ) {
+        __m256i block = _mm256_loadu_si256((const __m256i *) ( input + i ));
+        if ( _mm256_movemask_epi8( block ) == 0 ) {
+            // 全部是ASCII，只需要检查上一个block是否完整
+            error = _mm256_or_si256( error, incomplete );
+        } else {
+            error      = _mm256_or_si256( error, checkUtf8Block( block, previous ));
+            incomplete = _mm256_subs_epu8( block, incompleteMax );
+        }
+        previous = block;
+    }
 
-    int i = 0;
-    while ( isWhiteSpace( input[i] ))i++;
+    // 剩下的字节补0后再校验一次，不完整的编码后面是0也会出错
+    UBYTE tail[32] = { 0 };
+    memcpy( tail, input + i, length - i );
+    __m256i block = _mm256_loadu_si256((const __m256i *) tail );
+    error    = _mm256_or_si256( error, checkUtf8Block( block, previous ));
+    previous = block;
+    error    = _mm256_or_si256( error, checkUtf8Block( _mm256_setzero_si256(), previous ));
 
+    return _mm256_testz_si256( error, error );
+}
 
-    *length = 0;
-    UBYTE *result = input + i;
+#endif
 
-    switch ( input[i] ) {
-        case '{': {
-            result = parseObject( input + i, length, search );
-            *valueType = J_OBJ;
-            break;
-        }
-        case '"':
-            *length    = parseString( input + i );
-            *valueType = J_STRING;
-            break;
-        case '[': {
-            result = parseArray( input + i, length, search );
-            *valueType = J_ARRAY;
-            break;
-        }
-        case 'f':
-            *length    = parseFalse( input + i );
-            *valueType = J_FALSE;
-            break;
-        case 't':
-            *length = parseTrue( input + i );
-            *valueType = J_TRUE;
-            break;
-        case 'n':
-            *length = parseNull( input + i );
-            *valueType = J_NULL;
-            break;
-        default: {
-            int type;
-            *length = parseNumber( input + i, &type );
-            if ( *length == (int) PARSE_ERROR) {
-                result = PARSE_ERROR;
-            } else {
-                *valueType = type == J_INT ? J_INT : J_FLOAT;
-            }
-            break;
-        }
-    }
+bool validateUtf8Dispatch( const UBYTE *input, size_t length );
 
-    if ( result == PARSE_ERROR || *length == (int) PARSE_ERROR) {
-        search->valueType = J_PARSE_ERROR;
-    }
+/* 第一次调用时根据CPU选择实现 */
+bool (*validateUtf8Kernel)( const UBYTE *input, size_t length ) = validateUtf8Dispatch;
 
-    i += *length;
-    while ( isWhiteSpace( input[i] ))i++;
+bool validateUtf8Dispatch( const UBYTE *input, size_t length ){
 
-    *lengthWithBlanks = i;
-    return result;
-}
+    bool (*kernel)( const UBYTE *input, size_t length ) = validateUtf8Scalar;
+#if defined( __x86_64__ ) || defined( __i386__ )
+    __builtin_cpu_init();
+    if ( __builtin_cpu_supports( "avx2" )) kernel = validateUtf8AVX2;
+#endif
+    STORE_KERNEL( validateUtf8Kernel, kernel );
 
-void copyAsChar( UBYTE *input, char *charPtr, int length ){
-    for ( int i = 0; i < length; i++ ) {
-        char c = *input++ & 0xFF;
-        *charPtr++ = c;
-    }
+    return kernel( input, length );
 }
 
-void *getActualValueByType( const UBYTE *input, ValueType type, int length ){
+bool validateUtf8( const UBYTE *input, size_t length ){
+    if ( input == NULL) return false;
+    return LOAD_KERNEL( validateUtf8Kernel )( input, length );
+}
 
-    switch ( type ) {
-        case J_PARSE_ERROR:
-            return PARSE_ERROR;
-
-        case J_INT: {
-            char *intStr = (char *) malloc( sizeof( char ) * ( length + 1 ));
-            CHECK_NULL( intStr )
-            copyAsChar( input, intStr, length + 1 );
-            intStr[length] = cENDING;
-
-            int  *value = (int *) malloc( sizeof( int ));
-            char *err;
-            *value = (int) round( strtod( intStr, &err ));
-            if ( *err ) { return PARSE_ERROR; }
-            return value;
-        }
-        case J_FLOAT: {
-            char *doubleStr = (char *) malloc( sizeof( char ) * ( length + 1 ));
-            CHECK_NULL( doubleStr )
-            copyAsChar( input, doubleStr, length + 1 );
-            doubleStr[length] = cENDING;
-
-            double *value = (double *) malloc( sizeof( double ));
-            char   *err;
-            *value = strtod( doubleStr, &err );
-            if ( *err ) { return PARSE_ERROR; }
-            return value;
-        }
+/**
+ * 找到字符串中第一个需要单独处理的字节: 双引号、转义符或者控制字符
+ * @return 位置，没有时返回length
+ */
+size_t findStringSpecialScalar( const UBYTE *input, size_t length ){
 
-        case J_NULL:{
-            long long *value = (long long *) malloc( sizeof( long long ));
-            *value = 0;
-            return value;
-        }
+    for ( size_t i = 0; i < length; i++ ) {
+        if ( input[i] == '"' || input[i] == '\\' || input[i] < 0x20 ) return i;
+    }
+    return length;
+}
 
-        case J_TRUE: {
-            long long *value = (long long *) malloc( sizeof( long long ));
-            *value = true;
-            return value;
-        }
+#if defined( __x86_64__ ) || defined( __i386__ )
 
-        case J_FALSE: {
-            long long *value = (long long *) malloc( sizeof( long long ));
-            *value = false;
-            return value;
-        }
+__attribute__(( target( "avx2" )))
+size_t findStringSpecialAVX2( const UBYTE *input, size_t length ){
 
-        case J_ARRAY:
-        case J_OBJ: {
-            UBYTE *value = (UBYTE *) malloc( sizeof( UBYTE ) * ( length + 1 ));
-            CHECK_NULL( value )
-            memcpy( value, input, sizeof( UBYTE ) * ( length + 1 ) );
-            value[length] = cENDING;
-            return value;
-        }
+    const __m256i quote     = _mm256_set1_epi8( '"' );
+    const __m256i backslash = _mm256_set1_epi8( '\\' );
+    const __m256i control   = _mm256_set1_epi8( 0x1F );
 
-        case J_STRING: {
-            UBYTE *value = (UBYTE *) malloc( sizeof( UBYTE ) * ( length - 1 ));
-            CHECK_NULL( value )
-            memcpy( value, input + 1, sizeof( UBYTE ) * ( length - 1 ));
-            value[length - 2] = cENDING;
-            return value;
-        }
+    size_t i = 0;
+    for ( ; i + 32 <= length; i += 32 ) {
+        __m256i block = _mm256_loadu_si256((const __m256i *) ( input + i ));
+        // 无符号比较: min(block, 0x1F) == block 即 block < 0x20
+        __m256i hits  = _mm256_or_si256(
+                _mm256_or_si256( _mm256_cmpeq_epi8( block, quote ), _mm256_cmpeq_epi8( block, backslash )),
+                _mm256_cmpeq_epi8( _mm256_min_epu8( block, control ), block ));
 
-        default: // not found
-            return NULL;
+        uint32_t mask = (uint32_t) _mm256_movemask_epi8( hits );
+        if ( mask ) return i + (size_t) __builtin_ctz( mask );
     }
+
+    return i + findStringSpecialScalar( input + i, length - i );
+}
+
+#endif
+
+size_t findStringSpecialDispatch( const UBYTE *input, size_t length );
+
+/* 第一次调用时根据CPU选择实现 */
+size_t (*findStringSpecialKernel)( const UBYTE *input, size_t length ) = findStringSpecialDispatch;
+
+size_t findStringSpecialDispatch( const UBYTE *input, size_t length ){
+
+    size_t (*kernel)( const UBYTE *input, size_t length ) = findStringSpecialScalar;
+#if defined( __x86_64__ ) || defined( __i386__ )
+    __builtin_cpu_init();
+    if ( __builtin_cpu_supports( "avx2" )) kernel = findStringSpecialAVX2;
+#endif
+    STORE_KERNEL( findStringSpecialKernel, kernel );
+
+    return kernel( input, length );
+}
+
+/* 第一个双引号、转义符或者控制字符的位置，没有时返回length */
+size_t findStringSpecial( const UBYTE *input, size_t length ){
+    return LOAD_KERNEL( findStringSpecialKernel )( input, length );
 }
 
 /**
- * 提供Index的search方法，当且仅当input是数组的情况下查找
- * @param input
- * @param index 以0为开始的下标
- * @param search
- * @return 查询结果的内容，需要手动释放指针
+ * 检查一个转义序列
+ * @param input 以\开头
+ * @return 转义序列的长度，0: 格式错误
  */
-void *parseArrayByIndex( const UBYTE *input, int index, Search *search ){
+size_t validateEscape( const UBYTE *input, size_t length ){
 
-    if ( search == NULL) {
-        return PATTERN_WRONG_FORMAT;
-    }
+    UBYTE    escaped = 1 < length ? input[1] : cENDING;
+    uint32_t codePoint;
+    if ( escaped == 'u' ) return parseHex4( input + 2, length - 2, &codePoint ) ? 6 : 0;
 
-    if ( input == NULL) {
-        search->valueType = J_PARSE_ERROR;
-        return PARSE_ERROR;
+    return escaped != cENDING && strchr( "\"\\/bfnrt", escaped ) != NULL ? 2 : 0;
+}
+
+/**
+ * 严格检查一个字符串，不允许控制字符和不正确的转义
+ * @param input 以"开头
+ * @return 包含左右双引号的长度，0: 格式错误，*errorOffset为出错的位置
+ */
+size_t validateString( const UBYTE *input, size_t length, size_t *errorOffset ){
+
+    size_t i = 1;
+    while ( true ) {
+        i += findStringSpecial( input + i, length - i );
+        *errorOffset = i;
+        if ( i >= length || input[i] < 0x20 ) return 0;
+        if ( input[i] == '"' ) return i + 1;
+
+        size_t escapeLength = validateEscape( input + i, length - i );
+        if ( escapeLength == 0 ) return 0;
+        i += escapeLength;
     }
+}
 
-    if ( index < 0 ) {
-        search->valueType = J_PATTERN_WRONG_FORMAT;
-        return PATTERN_WRONG_FORMAT;
+/* 不带双引号的字符串内容能否原样写入JSON: 没有未转义的双引号、控制字符和不正确的转义 */
+bool isEscapedStringContent( const UBYTE *input, size_t length ){
+
+    size_t i = 0;
+    while ( true ) {
+        i += findStringSpecial( input + i, length - i );
+        if ( i >= length ) return true;
+        if ( input[i] != '\\' ) return false;
+
+        size_t escapeLength = validateEscape( input + i, length - i );
+        if ( escapeLength == 0 ) return false;
+        i += escapeLength;
     }
+}
 
-    int i = 0;
-    UBYTE c;
-    search->options = S_NORMAL;
+/**
+ * 严格按照RFC 8259检查数字: -?(0|[1-9][0-9]*)(\.[0-9]+)?([eE][+-]?[0-9]+)?
+ * 不接受1.、.5、01、+1
+ * @return 数字的长度，0: 格式错误
+ */
+size_t validateNumber( const UBYTE *input, size_t length ){
 
-    while ( isWhiteSpace( input[i] ) && i < cSOURCE_LENGTH_MAX )i++;
-    if ( i >= cSOURCE_LENGTH_MAX ) {
-        search->valueType = J_PARSE_ERROR;
-        return OVER_FLOW;
+    size_t i = 0;
+    if ( i < length && input[i] == '-' ) i++;
+
+    if ( i < length && input[i] == '0' ) {
+        i++;
+    } else if ( i < length && input[i] >= '1' && input[i] <= '9' ) {
+        while ( i < length && isDigit( input[i] )) i++;
+    } else {
+        return 0;
     }
 
-    if ( input[i] != '[' ) {
-        search->valueType = J_PARSE_ERROR;
-        return PARSE_ERROR;
+    if ( i < length && input[i] == '.' ) {
+        i++;
+        if ( i >= length || !isDigit( input[i] )) return 0;
+        while ( i < length && isDigit( input[i] )) i++;
     }
 
-    do {
-        c = input[++i];
-        if ( isWhiteSpace( c ))continue;
+    if ( i < length && ( input[i] == 'e' || input[i] == 'E' )) {
+        i++;
+        if ( i < length && ( input[i] == '+' || input[i] == '-' )) i++;
+        if ( i >= length || !isDigit( input[i] )) return 0;
+        while ( i < length && isDigit( input[i] )) i++;
+    }
 
-        if ( c == ']' )break;
+    return i;
+}
 
-        int         length          = 0;
-        int         lengthWithBlank = 0;
-        ValueType   valueType;
-        const UBYTE *valueStart     = parseValue( input + i, &length, &lengthWithBlank, search, &valueType );
+/* 严格检查时等待的内容 */
+typedef enum {
+    V_VALUE,                       // 一个value
+    V_KEY,                         // object中的key
+    V_AFTER_VALUE                  // value之后的','或者结束符
+} ValidateState;
 
-        if ( valueStart == PARSE_ERROR) {
-            search->valueType = J_PARSE_ERROR;
-            return PARSE_ERROR;
-        }
+bool validateJson( const UBYTE *input, size_t inputLength, size_t *errorOffset ){
 
-        if ( index-- == 0 ) {
+    size_t offset = 0;
+    if ( errorOffset == NULL) errorOffset = &offset;
+    *errorOffset = 0;
+    if ( input == NULL) return false;
 
-            // 找到当前的value
-            search->valueType = valueType;
-            return getActualValueByType( valueStart, search->valueType, length );
+    if ( !validateUtf8( input, inputLength )) {
+        // 只有出错时才逐个字节找出错的位置
+        *errorOffset = findUtf8ErrorScalar( input, inputLength );
+        return false;
+    }
 
-        } else {
+    // 每层是'{'还是'['，不递归，嵌套再深也不会栈溢出
+    UBYTE  *stack   = NULL;
+    size_t depth    = 0, capacity = 0;
+    size_t i        = 0;
+    bool   valid    = false;
+
+    ValidateState state = V_VALUE;
+    while ( true ) {
+        while ( i < inputLength && isWhiteSpace( input[i] )) i++;
 
-            i += lengthWithBlank;
+        if ( state == V_AFTER_VALUE ) {
+            if ( depth == 0 ) {
+                valid = i == inputLength;
+                break;
+            }
+            if ( i >= inputLength ) break;
 
+            UBYTE container = stack[depth - 1];
             if ( input[i] == ',' ) {
-                // just skip
-            } else if ( input[i] == ']' ) {
-                i--; // 如果间隔符号刚好是']'的情况
+                i++;
+                state = container == '{' ? V_KEY : V_VALUE;
+            } else if ( input[i] == ( container == '{' ? '}' : ']' )) {
+                i++;
+                depth--;
             } else {
-                search->valueType = J_PARSE_ERROR;
-                return PARSE_ERROR;
+                break;
             }
+            continue;
         }
 
-    } while ( c != cENDING && i < cSOURCE_LENGTH_MAX );
+        if ( i >= inputLength ) break;
+        UBYTE c = input[i];
 
-    search->valueType = J_PARSE_ERROR;
-    return PARSE_ERROR;
-}
+        if ( state == V_KEY ) {
+            if ( c != '"' ) break;
+            size_t length = validateString( input + i, inputLength - i, errorOffset );
+            if ( length == 0 ) {
+                i += *errorOffset;
+                break;
+            }
+            i += length;
+            while ( i < inputLength && isWhiteSpace( input[i] )) i++;
+            if ( i >= inputLength || input[i] != ':' ) break;
+            i++;
+            state = V_VALUE;
+            continue;
+        }
 
-void *macroKeyValueSearch( const UBYTE *input, Search *search ){
+        if ( c == '{' || c == '[' ) {
+            if ( depth == capacity ) {
+                capacity = capacity == 0 ? 64 : capacity * 2;
+                UBYTE *bigger = (UBYTE *) realloc( stack, capacity );
+                if ( bigger == NULL) break;
+                stack = bigger;
+            }
+            stack[depth++] = c;
+            i++;
 
-    if ( search == NULL) {
-        return PATTERN_WRONG_FORMAT;
-    }
+            // 空的object或者array
+            while ( i < inputLength && isWhiteSpace( input[i] )) i++;
+            if ( i < inputLength && input[i] == ( c == '{' ? '}' : ']' )) {
+                i++;
+                depth--;
+                state = V_AFTER_VALUE;
+            } else {
+                state = c == '{' ? V_KEY : V_VALUE;
+            }
+            continue;
+        }
 
-    if ( search->pattern == NULL) {
-        search->valueType = J_PATTERN_WRONG_FORMAT;
-        return PATTERN_WRONG_FORMAT;
-    }
+        size_t length = 0;
+        if ( c == '"' ) {
+            length = validateString( input + i, inputLength - i, errorOffset );
+            if ( length == 0 ) {
+                i += *errorOffset;
+                break;
+            }
+        } else if ( c == 't' ) {
+            length = parseTrue( input + i, inputLength - i );
+        } else if ( c == 'f' ) {
+            length = parseFalse( input + i, inputLength - i );
+        } else if ( c == 'n' ) {
+            length = parseNull( input + i, inputLength - i );
+        } else {
+            length = validateNumber( input + i, inputLength - i );
+        }
+        if ( length == 0 ) break;
 
-    if ( input == NULL) {
-        search->valueType = J_PARSE_ERROR;
-        return PARSE_ERROR;
+        i += length;
+        state = V_AFTER_VALUE;
     }
 
-    int       length          = 0;
-    int       lengthWithBlank = 0;
-    ValueType valueType;
-    search->keyFoundInObject = false;
-    search->valueType        = J_NOT_FOUND;
+    free( stack );
+    *errorOffset = valid ? inputLength : i;
+    return valid;
+}
 
-    const UBYTE *valueBegin = parseValue( input, &length, &lengthWithBlank, search, &valueType );
-    if ( valueBegin == PARSE_ERROR) {
-        search->valueType = J_PARSE_ERROR;
-        return PARSE_ERROR;
-    }
+/**
+ * 解析key，并且判断是否和targetKey一致
+ * @param input
+ * @param inputLength
+ * @param targetKey       需要查找的key, 不要求以0结尾
+ * @param targetKeyLength targetKey的长度
+ * @param unescapeKey     true: 先对key反转义再比较，false: 直接比较原始字节
+ * @param keyLength       用于返回的key长度，包含左右双引号
+ * @return 0: PARSE_ERROR, 1: FOUND,  -1: NOT FOUND
+ */
+int parseKey( const UBYTE *input, size_t inputLength, const UBYTE *targetKey, size_t targetKeyLength,
+              bool unescapeKey, size_t *keyLength ){
 
-    return getActualValueByType( valueBegin, search->valueType, length );
-}
+    size_t length = parseString( input, inputLength );
+    if ( length == (size_t) PARSE_ERROR) return 0;
 
-void *marcoPathSearch( const UBYTE *input, Search *search ){
+    *keyLength = length;
 
-    if ( search == NULL) {
-        return PATTERN_WRONG_FORMAT;
-    }
+    // 不包含左右双引号
+    bool isSame = unescapeKey ? isSameUnescapedKey( input + 1, length - 2, targetKey, targetKeyLength )
+                              : length - 2 == targetKeyLength && memcmp( input + 1, targetKey, targetKeyLength ) == 0;
 
-    if ( search->pattern == NULL) {
-        search->valueType = J_PATTERN_WRONG_FORMAT;
-        return PATTERN_WRONG_FORMAT;
-    }
+    return isSame ? 1 : -1;
+}
 
-    if ( input == NULL) {
-        search->valueType = J_PARSE_ERROR;
-        return PARSE_ERROR;
-    }
+/* value第一个字节的分类，查表代替逐个比较 */
+typedef enum {
+    C_INVALID = 0,
+    C_OBJECT,
+    C_ARRAY,
+    C_STRING,
+    C_TRUE,
+    C_FALSE,
+    C_NULL,
+    C_NUMBER
+} ValueClass;
+
+const UBYTE cVALUE_CLASS[256] = {
+        ['{'] = C_OBJECT, ['['] = C_ARRAY, ['"'] = C_STRING, ['t'] = C_TRUE, ['f'] = C_FALSE, ['n'] = C_NULL,
+        ['-'] = C_NUMBER, ['0'] = C_NUMBER, ['1'] = C_NUMBER, ['2'] = C_NUMBER, ['3'] = C_NUMBER,
+        ['4'] = C_NUMBER, ['5'] = C_NUMBER, ['6'] = C_NUMBER, ['7'] = C_NUMBER, ['8'] = C_NUMBER, ['9'] = C_NUMBER
+};
 
-    UBYTE *pattern = search->pattern;
-    search->options          = S_NORMAL;
-    search->keyFoundInObject = false;
+/**
+ * 解析object和array以外的value
+ * @return length in UBYTEs, 0: PARSE_ERROR
+ */
+size_t parseScalar( const UBYTE *input, size_t inputLength, ValueClass valueClass, ValueType *valueType ){
 
-    if ( pattern == NULL || ( *pattern != cPATH_SEPARATE && *pattern != '[' )) {
-        search->valueType = J_PATTERN_WRONG_FORMAT;
-        return PATTERN_WRONG_FORMAT;
+    switch ( valueClass ) {
+        case C_STRING:
+            *valueType = J_STRING;
+            return parseString( input, inputLength );
+        case C_TRUE:
+            *valueType = J_TRUE;
+            return parseTrue( input, inputLength );
+        case C_FALSE:
+            *valueType = J_FALSE;
+            return parseFalse( input, inputLength );
+        case C_NULL:
+            *valueType = J_NULL;
+            return parseNull( input, inputLength );
+        case C_NUMBER: {
+            int    type   = J_INT;
+            size_t length = parseNumber( input, inputLength, &type );
+            *valueType = type == J_INT ? J_INT : J_FLOAT;
+            return length;
+        }
+        default:
+            return (size_t) PARSE_ERROR;
     }
+}
 
-    void *source = (void *) input;
+/* 查找时每一层object或array的状态 */
+typedef struct {
+    bool   isObject;
+    bool   keyMatched;             // 刚解析的key与pattern一致，下一个value就是结果
+    bool   justParsedKey;          // 解析完key
+    bool   justParsedValue;        // 解析完一对key, value
+    size_t valueStart;             // 正在解析的value的起始位置
+} SearchFrame;
 
-    while ( *pattern != cENDING ) {
+#define cSEARCH_FRAMES_ON_STACK 64                // 不超过这个深度时不分配内存
+const size_t cSEARCH_DEPTH_DEFAULT = 1024;        // SearchState.maxDepth为0时最多嵌套的层数
 
-        if ( *pattern == cPATH_SEPARATE ) {
-            // search in object
-            pattern++;
+/**
+ * 在object或者array中查找key，用显式的栈代替递归，栈的深度不超过search->maxDepth
+ * S_NORMAL只比较根object的key，下层直接跳过；S_RECURSIVE按深度优先返回第一个出现的key
+ *
+ * @param input  以{或[开头
+ * @param length 找到时为结果的长度，否则为整个object或array的长度
+ * @return 找到时为结果的起始位置，找不到时为input，出错或者超过最大深度返回PARSE_ERROR
+ */
+const UBYTE *searchNested( const UBYTE *input, size_t inputLength, size_t *length, SearchState *search ){
+
+    SearchFrame stackFrames[cSEARCH_FRAMES_ON_STACK];
+    SearchFrame *frames   = stackFrames;
+    size_t      capacity  = cSEARCH_FRAMES_ON_STACK;
+    size_t      maxDepth  = search->maxDepth == 0 ? cSEARCH_DEPTH_DEFAULT : search->maxDepth;
+    size_t      depth     = 0;
+    size_t      i         = 0;
+    bool        enterNext = true;          // input[i]是需要进入的{或[
+    const UBYTE *result   = PARSE_ERROR;
+
+    while ( true ) {
+
+        if ( enterNext ) {
+            if ( depth == maxDepth ) break;
+            if ( depth == capacity ) {
+                // 超过栈上的层数时才在堆上分配，每次翻倍
+                capacity *= 2;
+                SearchFrame *bigger = frames == stackFrames
+                                      ? (SearchFrame *) malloc( sizeof( SearchFrame ) * capacity )
+                                      : (SearchFrame *) realloc( frames, sizeof( SearchFrame ) * capacity );
+                if ( bigger == NULL) break;
+                if ( frames == stackFrames ) memcpy( bigger, stackFrames, sizeof( stackFrames ));
+                frames = bigger;
+            }
+
+            SearchFrame frame = { input[i] == '{', false, false, false, 0 };
+            frames[depth++] = frame;
+            enterNext = false;
+            i++;
+        }
 
-            UBYTE *keyStart = pattern, *tempKey;
-            int   keyLength = 0;
+        SearchFrame *frame = &frames[depth - 1];
+        while ( i < inputLength && isWhiteSpace( input[i] )) i++;
+        if ( i >= inputLength ) break;
+
+        UBYTE c          = input[i];
+        bool  closed     = false;      // 本层结束
+        if ( frame->isObject ) {
+            if ( c == '"' ) {
+                size_t keyLength = 0;
+                if ( search->pattern != NULL) {
+                    int found = parseKey( input + i, inputLength - i, search->pattern, search->patternLength,
+                                          search->unescapeKey, &keyLength );
+                    if ( found == 0 ) break;
+                    frame->keyMatched = found == 1;
+                    if ( frame->keyMatched ) search->pattern = NULL;
+                } else {
+                    keyLength = parseString( input + i, inputLength - i );
+                    if ( keyLength == (size_t) PARSE_ERROR) break;
+                }
 
-            while ( *pattern != cPATH_SEPARATE && *pattern != '[' && *pattern != ']' && *pattern != cENDING ) {
-                keyLength++;
-                pattern++;
+                // 指针后移，包括匹配的引号也跳过
+                i += keyLength;
+                frame->justParsedKey = true;
+                continue;
             }
-            if ( keyLength == 0 ) {
-                if ( source != input ) free( source );
-                search->valueType = J_PATTERN_WRONG_FORMAT;
-                return PATTERN_WRONG_FORMAT;
+
+            if ( c == ',' ) {
+                if ( !frame->justParsedValue ) break;
+                i++;
+                frame->justParsedValue = false;
+                continue;
             }
-            tempKey = (UBYTE *) malloc( sizeof( UBYTE ) * ( keyLength + 1 ));
-            CHECK_NULL( tempKey );
-            memcpy( tempKey, keyStart, sizeof( UBYTE ) * ( keyLength + 1 ) );
-            tempKey[keyLength] = cENDING;
-
-            // ready to search
-            Search    keySearch = { tempKey, J_NOT_FOUND, false, S_NORMAL };
-            int       length, lengthWithBlanks;
-            ValueType valueType;
-
-            const void *result = parseValue((UBYTE *) source, &length, &lengthWithBlanks, &keySearch, &valueType );
-            free( tempKey );
-
-            // not found the value and parse error
-            if ( result == PARSE_ERROR) {
-                if ( source != input ) free( source );
-                search->valueType = J_PARSE_ERROR;
-                return PARSE_ERROR;
+
+            if ( c == ':' ) {
+                if ( !frame->justParsedKey ) break;
+                i++;
+                while ( i < inputLength && isWhiteSpace( input[i] )) i++;
+            } else if ( c == '}' ) {
+                closed = true;
+            } else {
+                break;
             }
+        } else {
+            closed = c == ']';
+        }
 
-            // not found the value
-            if ( keySearch.valueType == J_NOT_FOUND ) {
-                if ( source != input ) free( source );
+        ValueType valueType;
+        if ( closed ) {
+            i++;
+            valueType = frame->isObject ? J_OBJ : J_ARRAY;
+            if ( --depth == 0 ) {
+                *length = i;
                 search->valueType = J_NOT_FOUND;
-                return NOT_FOUND;
+                result = input;
+                break;
+            }
+            frame = &frames[depth - 1];
+        } else {
+            // 本层的下一个value
+            ValueClass valueClass = i < inputLength ? (ValueClass) cVALUE_CLASS[input[i]] : C_INVALID;
+            size_t     valueLength;
+
+            frame->valueStart = i;
+            if ( valueClass == C_OBJECT || valueClass == C_ARRAY ) {
+                if ( frame->isObject && frame->keyMatched && search->startOnly ) {
+                    // 路径的中间一跳，下一跳会自己找到这个value的结尾
+                    search->keyFoundInObject = true;
+                    search->valueType        = valueClass == C_OBJECT ? J_OBJ : J_ARRAY;
+                    *length = inputLength - i;
+                    result = input + i;
+                    break;
+                }
+                if ( search->options == S_RECURSIVE ) {
+                    enterNext = true;
+                    continue;
+                }
+                valueLength = scanValue( input + i, inputLength - i );
+                valueType   = valueClass == C_OBJECT ? J_OBJ : J_ARRAY;
+            } else {
+                valueLength = parseScalar( input + i, inputLength - i, valueClass, &valueType );
+            }
+            if ( valueLength == (size_t) PARSE_ERROR) break;
+            i += valueLength;
+        }
+
+        // frame中的一个value刚刚结束，范围是[frame->valueStart, i)
+        if ( frame->isObject ) {
+            if ( frame->keyMatched ) {
+                search->keyFoundInObject = true;
+                search->valueType        = valueType;
+                *length = i - frame->valueStart;
+                result = input + frame->valueStart;
+                break;
             }
+            frame->justParsedValue = true;
+            frame->justParsedKey   = false;
+        } else {
+            while ( i < inputLength && isWhiteSpace( input[i] )) i++;
+            if ( i < inputLength && input[i] == ',' ) i++;
+            else if ( i >= inputLength || input[i] != ']' ) break;
+        }
+    }
+
+    if ( frames != stackFrames ) free( frames );
+    if ( result == PARSE_ERROR) search->valueType = J_PARSE_ERROR;
+    return result;
+}
 
-            // found the value
-            search->valueType = keySearch.valueType;
+const UBYTE *parseValue( const UBYTE *input, size_t inputLength, size_t *length, size_t *lengthWithBlanks,
+                         SearchState *search, ValueType *valueType ){
+    CHECK_NULL( input )
 
-            // do some cleaning to prevent the memory leak
-            UBYTE *toBeFree = source;
+    size_t i = 0;
+    while ( i < inputLength && isWhiteSpace( input[i] ))i++;
 
-            // recurse search if path not empty
-            source = getActualValueByType( result, keySearch.valueType, length );
 
-            if ( toBeFree != input )free( toBeFree );
-            continue;
+    *length = 0;
+    const UBYTE *result     = input + i;
+    size_t      rest        = inputLength - i;
+    ValueClass  valueClass  = i < inputLength ? (ValueClass) cVALUE_CLASS[input[i]] : C_INVALID;
+
+    if ( valueClass == C_OBJECT || valueClass == C_ARRAY ) {
+        *valueType = valueClass == C_OBJECT ? J_OBJ : J_ARRAY;
+
+        // 没有需要查找的key，整个object或array直接跳过
+        if ( search->pattern == NULL && search->options == S_NORMAL ) {
+            *length = scanValue( input + i, rest );
+        } else {
+            result = searchNested( input + i, rest, length, search );
         }
+    } else {
+        *length = parseScalar( input + i, rest, valueClass, valueType );
+    }
 
-        if ( *pattern == '[' ) {
-            // search in array
-            pattern++;
+    if ( result == PARSE_ERROR || *length == (size_t) PARSE_ERROR) {
+        search->valueType = J_PARSE_ERROR;
+        result = PARSE_ERROR;
+    }
 
-            UBYTE *numberStart = pattern, *tempIntStr;
-            int   keyLength    = 0;
+    i += *length;
+    while ( i < inputLength && isWhiteSpace( input[i] ))i++;
 
-            while ( *pattern != ']' && *pattern != cENDING ) {
-                keyLength++;
-                pattern++;
-            }
-            if ( *pattern == cENDING ) {
-                if ( source != input ) free( source );
-                search->valueType = J_PATTERN_WRONG_FORMAT;
-                return PATTERN_WRONG_FORMAT;
-            }
-            tempIntStr = (UBYTE *) malloc( sizeof( UBYTE ) * ( keyLength + 1 ));
-            CHECK_NULL( tempIntStr )
-            memcpy( tempIntStr, numberStart, sizeof( UBYTE ) * ( keyLength + 1 ) );
-            tempIntStr[keyLength] = cENDING;
-
-            char *err;
-            int  index            = (int) round( strtod((char *) tempIntStr, &err ));
-            if ( index < 0 || *err != 0 ) {
-                if ( source != input ) free( source );
-                search->valueType = J_PATTERN_WRONG_FORMAT;
-                return PATTERN_WRONG_FORMAT;
-            }
+    *lengthWithBlanks = i;
+    return result;
+}
 
-            free( tempIntStr );
-            Search tempSearch = { NULL, J_NOT_FOUND, false };
-            void   *result    = parseArrayByIndex( source, index, &tempSearch );
-            if ( result == PARSE_ERROR) {
-                if ( source != input ) free( source );
-                search->valueType = J_PARSE_ERROR;
-                return PARSE_ERROR;
-            }
+void copyAsChar( const UBYTE *input, char *charPtr, size_t length ){
+    for ( size_t i = 0; i < length; i++ ) {
+        char c = *input++ & 0xFF;
+        *charPtr++ = c;
+    }
+}
 
-            // not found the value
-            if ( tempSearch.valueType == J_NOT_FOUND ) {
-                if ( source != input ) free( source );
-                search->valueType = J_NOT_FOUND;
-                return NOT_FOUND;
-            }
+/* arena中额外分配的block */
+struct ArenaBlock {
+    ArenaBlock *next;
+    size_t     capacity;
+    size_t     used;
+};
 
-            // found the value
-            search->valueType = tempSearch.valueType;
+const size_t cARENA_ALIGN = 8;                   // arena中分配的内存按8字节对齐
 
-            // do some cleaning to prevent the memory leak
-            if ( source != input ) free( source );
+bool initArena( Arena *arena, void *buffer, size_t capacity ){
 
-            // recurse search if path not empty
-            source = result;
-            pattern++;
-            continue;
+    if ( arena == NULL) return false;
+
+    arena->ownsBuffer = buffer == NULL;
+    if ( buffer == NULL && capacity > 0 ) {
+        buffer = malloc( capacity );
+        if ( buffer == NULL) {
+            arena->buffer   = NULL;
+            arena->capacity = 0;
+            return false;
         }
+    }
 
-        search->valueType = J_PATTERN_WRONG_FORMAT;
-        return PATTERN_WRONG_FORMAT;
+    arena->buffer   = (UBYTE *) buffer;
+    arena->capacity = capacity;
+    arena->used     = 0;
+    arena->overflow = NULL;
+    return true;
+}
+
+void *arenaAlloc( Arena *arena, size_t size ){
+
+    if ( arena == NULL) return malloc( size );
+
+    size = ( size + cARENA_ALIGN - 1 ) & ~( cARENA_ALIGN - 1 );
+
+    // 大部分情况下只需要移动指针
+    uintptr_t start = ((uintptr_t) arena->buffer + arena->used + cARENA_ALIGN - 1 ) & ~(uintptr_t) ( cARENA_ALIGN - 1 );
+    size_t    used  = (size_t) ( start - (uintptr_t) arena->buffer );
+    if ( arena->buffer != NULL && used + size <= arena->capacity ) {
+        arena->used = used + size;
+        return (void *) start;
     }
 
-    return source;
+    ArenaBlock *block = arena->overflow;
+    if ( block != NULL && block->used + size <= block->capacity ) {
+        void *value = (UBYTE *) ( block + 1 ) + block->used;
+        block->used += size;
+        return value;
+    }
+
+    // buffer不够用时再额外分配，reset时释放
+    size_t capacity = size > arena->capacity ? size : arena->capacity;
+    block = (ArenaBlock *) malloc( sizeof( ArenaBlock ) + capacity );
+    CHECK_NULL( block )
+
+    block->next     = arena->overflow;
+    block->capacity = capacity;
+    block->used     = size;
+    arena->overflow = block;
+    return block + 1;
 }
 
-/**********************************************************************************************************************/
+void resetArena( Arena *arena ){
 
-/* 从这里以下是测试代码 */
-void printTestResult( char *name, char *result, char *expected, ValueType valueType ){
+    if ( arena == NULL) return;
 
-    char buf[2048];
-    switch ( valueType ) {
-        case J_NOT_FOUND:
-            sprintf( buf, "not found..." );
-            break;
-        case J_PATTERN_WRONG_FORMAT:
-            sprintf( buf, "wrong pattern format" );
-            break;
-        case J_FLOAT:
-            sprintf( buf, "number is %.9f", *(double *) result );
-            break;
-        case J_INT:
-            sprintf( buf, "number is %d", *(int *) result );
-            break;
-        case J_PARSE_ERROR:
-            sprintf( buf, "parse error" );
-            break;
-        case J_STRING:
-            sprintf( buf, "string is %s", (char *) result );
-            break;
-        case J_ARRAY:
-            sprintf( buf, "array is %s", (char *) result );
-            break;
-        case J_OBJ:
-            sprintf( buf, "obj is %s", (char *) result );
-            break;
-        case J_TRUE:
-            sprintf( buf, "value is true" );
-            break;
-        case J_FALSE:
-            sprintf( buf, "value is false" );
-            break;
-        default: //case J_NULL:
-            sprintf( buf, "value is null" );
-            break;
+    while ( arena->overflow != NULL) {
+        ArenaBlock *next = arena->overflow->next;
+        free( arena->overflow );
+        arena->overflow = next;
     }
+    arena->used = 0;
+}
 
-    if ( strcmp( buf, expected ) == 0 ) {
-        printf( "%s, test passed!\n", name );
-    } else {
-        printf( "%s, test failed, expected: [%s], actual: [%s]\n", name, expected, buf );
-    }
-}
-
-void test( char *name, char *input, char *key, char *expected, bool isRecursive ){
-
-    Search search  = { (UBYTE *) key, J_NOT_FOUND, false, isRecursive ? S_RECURSIVE : S_NORMAL };
-    void   *result = macroKeyValueSearch((UBYTE *) input, &search );
-
-    printTestResult( name, result, expected, search.valueType );
-}
-
-void test2( char *name, char *input, int index, char *expected ){
-
-    Search search  = { NULL, J_NOT_FOUND, false, S_NORMAL };
-    void   *result = parseArrayByIndex((UBYTE *) input, index, &search );
-
-    printTestResult( name, result, expected, search.valueType );
-}
-
-void test3( char *name, char *input, char *pattern, char *expected ){
-
-    Search search  = { pattern, J_NOT_FOUND, false, S_NORMAL };
-    void   *result = marcoPathSearch((UBYTE *) input, &search );
-
-    printTestResult( name, result, expected, search.valueType );
-}
-
-int main(){
-
-    test( "1", "{\"x\":\"1\"}", "x", "string is 1", true );
-    test( "2", "    {   \"x22\"   :  123  }", "x22", "number is 123", true );
-    test( "3", "    {   \"x22\"   :  12890000  }", "x222", "not found...", true );
-    test( "4", "    {   \"x22\"   :  [ 12.99, 0.989, 99.9, \"\",{} ]  }", "x22",
-          "array is [ 12.99, 0.989, 99.9, \"\",{} ]", true );
-    test( "5", "    {  \"1\": true,  \"x22\"   :  [ 12, 99, 99, \"\",{} ]  }", "1", "value is true", true );
-    test( "6", "    {  \"1\": true,  \"x22\"   :  [ 12, 99, 99, \"\",{} ],\"3\": null  }", "3", "value is null", true );
-    test( "7", "    {  \"1\": true,  \"x22\"   :  [ 12, 99, 99, \"\",{} ],\"3\": { "
-               "\"user\":{},"
-               "\"data\":\"x12345\""
-               "}", "data", "string is x12345", true );
-    test( "8", "    {  \"1\": true,  \"x22\"   :  [ 12, 99, 99, \"\", { \"data\" : \"59\" } ],\"3\": null  }", "data",
-          "string is 59", true );
-    test( "9", "    {  \"我0\": true,  \"x22\"   :  [ 12, 99, 99, \"\", { \"data\" : 59.980 } ],\"3\": null  }", "我0",
-          "value is true", true );
-    test( "10", "    {  \"0\": \"1233\",  \"x22\"   :  [ 12, 99, 99, \"\", { \"data\" : 59 } ],\"3\": \"我的\"  }", "3",
-          "string is 我的", true );
-    test( "11", "    {  \"0\": \"12{33\",  \"x2}2\"   :  [ 12, 99, 99, \"\", { \"data\" : 59 } ],\"3\": {}  }", "3",
-          "obj is {}", true );
-    test( "12", "    {     }   ", "1", "not found...", true );
-    test( "13", " {   \"x\":  12}", "", "not found...", true );
-    test( "14", " {   \"x\":  12}", "xx", "not found...", true );
-    test( "15", " {   \"xxx\":  12}", "xx", "not found...", true );
-    test( "16", " {   ", "xx", "parse error", true );
-
-    test( "17", "    {  \"0\": \"12{33\",  \"x2}2\"   :  [ 12, 99, 99, \"\", { \"data\" : 59 } ],\"3\": {}  }", "data",
-          "not found...", false );
-    test( "18", "    {  \"0\": \"12{33\",  \"x2}2\"   :  [ 12, 99, 99, \"\", { \"data\" : 59 } ],\"3\": {}  }", "3",
-          "obj is {}", false );
-
-
-    test2( "19", "{\"user\":\"1234\"}", 0, "parse error" );
-    test2( "20", "{\"user\":\"1234\"}", 1, "parse error" );
-    test2( "21", "   [  \"user\"   ,    0.1234   ]    ", 1, "number is 0.123400000" );
-    test2( "22", "   [  \"user\"   ,    \"1234\"   }    ", 1, "string is 1234" );
-    test2( "23", "   [  \"user\"   ]   \"1234\"   }    ", 1, "parse error" );
-    test2( "24", "   [  0   ]   99      ", 0, "number is 0" );
-
-    UBYTE *json = "{\n"
-                  "  \"code\": 1000,\n"
-                  "  \"msg\": null,\n"
-                  "  \"data\": {\n"
-                  "    \"user\": {\n"
-                  "      \"userId\": 100001,\n"
-                  "      \"address\": \"安徽 黄山\",\n"
-                  "      \"age\": 20,\n"
-                  "      \"avatar\": \"http://www.qiniu.com/img/we.png\",\n"
-                  "      \"avatarList\": [\n"
-                  "               {\n"
-                  "                    \"avatarId\": \"JIHJSKJHKHH987JG\",\n"
-                  "                    \"url\": \"http://www.qiniu.com/img/we.png\",\n"
-                  "                    \"status\": 1\n"
-                  "                },\n"
-                  "                 {\n"
-                  "                    \"avatarId\": \"JIHJSKJHKHH987JG\",\n"
-                  "                    \"url\": \"http://www.qiniu.com/img/we.png\",\n"
-                  "                    \"status\": 100\n"
-                  "                }\n"
-                  "      ],\n"
-                  "      \"nick\": \"ss9df11\",\n"
-                  "      \"callRatio\": 90,\n"
-                  "      \"price\": 0,\n"
-                  "      \"selfIntro\": \"我是一只小小小小鸟\",\n"
-                  "       \"selfAudioIntro\" : \"http://wwwww\",\n"
-                  "       \"second\": 34,\n"
-                  "      \"setting\": 0,\n"
-                  "      \"account\": 0,\n"
-                  "      \"followCount\":10,\n"
-                  "      \"fansCount\":2,\n"
-                  "      \"talkTime\":456,\n"
-                  "      \"tags\":\"发放,温柔,儿童\",\n"
-                  "      \"gifts\": [\n"
-                  "       {\n"
-                  "         \"name\":\"草莓\",\n"
-                  "         \"image\":\"http://ww.qiniu.com/img/gift1.png\",\n"
-                  "         \"price\":400,\n"
-                  "         \"amount\":\"4\",\n"
-                  "       },\n"
-                  "       {\n"
-                  "         \"name\":\"香蕉\",\n"
-                  "         \"image\":\"http://ww.qiniu.com/img/gift2.png\",\n"
-                  "         \"price\":1400,\n"
-                  "         \"amount\":\"40\"\n"
-                  "       }],\n"
-                  "       \"loginDuration\" : \"1\",\n"
-                  "       \"recentVisitors\":[\n"
-                  "       {\n"
-                  "          \"userId\" : 123456,\n"
-                  "          \"nick\" : \"昵称昵称\",\n"
-                  "          \"avatar\" : \"http://staticnova.ruoogle.com/avatar/user24566.png\"\n"
-                  "       },\n"
-                  "       {\n"
-                  "          \"userId\" : 123457,\n"
-                  "          \"nicks\" : \"东方不败\",\n"
-                  "          \"avatar\" : \"http://staticnova.ruoogle.com/avatar/user24567.png\"\n"
-                  "       }\n"
-                  "       ]\n"
-                  "    }\n"
-                  "  }\n"
-                  "}";
-    test( "25", json, "nicks", "string is 东方不败", true );
-
-    test3( "26", json, ".data.user.userId", "number is 100001" );
-    test3( "27", json, ".data]39[", "wrong pattern format" );
-    test3( "28", json, "[.9.9]", "wrong pattern format" );
-    test3( "29", json, "[.9.]", "wrong pattern format" );
-    test3( "30", json, ".data.user.avatarList[1].status", "number is 100" );
-
-    json = "[ [ 1, 2 ,3  ]  ,[  2  ,  3,   4  ],[3,4,  [  4 , 5 , 4   ]  ]  ]";
-
-    // array
-    test2( "31", json, 2, "array is [3,4,  [  4 , 5 , 4   ]  ]" );
-    test3( "32", json, "[2][2][1]", "number is 5" );
-
-    // number
-    test( "33", "{\"data\":939485858585858585845}", "data", "number is -2147483648", true );
-    test( "34", "{\"data\":-12233.3434899}", "data", "number is -12233.343489900", true );
-    test( "35", "{\"data\":-12233.34567}", "data", "number is -12233.345670000", true );
-    test( "36", "{\"data\":-0}", "data", "number is 0", true );
-
-    // parse error
-    test( "37", "{\"data\":-0.8ab3,\"user\":\"myname\"}", "user", "parse error", false );
-    test2( "38", "[2.a, 4444,838]", 2, "parse error" );
-    test2( "39", "[2.a 4444,838]", 2, "parse error" );
-
-    json = "{\n"
-           "    \"l1\": {\n"
-           "        \"l1_1\": [\n"
-           "            \"l1_1_1\",\n"
-           "            \"l1_1_2\"\n"
-           "        ],\n"
-           "        \"l1_2\": {\n"
-           "            \"l1_2_1\": 121\n"
-           "        }\n"
-           "    },\n"
-           "    \"l2\": {\n"
-           "        \"l2_1\": null,\n"
-           "        \"l2_2\": true,\n"
-           "        \"l2_3\": }\n"
-           "    }\n"
-           "}";
-    test( "40", json, "l2_3", "parse error", true );
-
-    json = "{\n"
-           "    \"l1\": {\n"
-           "        \"l1_1\": [\n"
-           "            \"l1_1_1\",\n"
-           "            \"l1_1_2\"\n"
-           "        ],\n"
-           "        \"l1_2\": {\n"
-           "            \"l1_2_1\": 121\n"
-           "        }\n"
-           "    },\n"
-           "    \"l2\": {\n"
-           "        \"l2_1\": null,\n"
-           "        \"l2_2\": true,\n"
-           "        \"l2_3\": {\"dafadfa\":          ,\"3383\"}\n"
-           "    }\n"
-           "}";
-    test( "41", json, "l2_3", "parse error", true );
-
-    json = "{\n"
-           "    \"l1\": {\n"
-           "        \"l1_1\": [\n"
-           "            \"l1_1_1\",\n"
-           "            \"l1_1_2\"\n"
-           "        ],\n"
-           "        \"l1_2\": {\n"
-           "            \"l1_2_1\": 121\n"
-           "        }\n"
-           "    },\n"
-           "    \"l2\": {\n"
-           "        \"l2_1\": null,\n"
-           "        \"l2_2\": true,\n"
-           "        \"l2_3\": {}\n"
-           "    }\n"
-           "}";
-    test( "42", json, "l2_2", "value is true", true );
-    test3( "43", json, ".l1.l1_1[1]", "string is l1_1_2" );
-
-    test2( "44", "[8548588]", 0, "number is 8548588" );
-    test2( "45", "[\"d9d9d\" \"ddd\"]", 1, "parse error" );
-    test2( "46", "[\"d9d9d\", 0x999, \"ddd\"]", 2, "parse error" );
-    test2( "47", "[\"d9d9d\", 0x999, \"ddd\"}", 2, "parse error" );
-    test2( "48", "[\"d9d9d\", 0x999, \"ddd\",", 2, "parse error" );
-    test2( "49", "[\"d9d9d\", 0x999, \"ddd\"", 2, "parse error" );
-    test2( "50", "{\"d9d9d\", \"0x999\", \"ddd\"}", 2, "parse error" );
-
-    test( "51", "{\"user\"::\"ddd\"}", "ddd", "parse error", true );
-    test( "52", "{\"user\":[],\"user\":{},\"9\":null}", "user", "array is []", true );
-    test( "53", "{\"user\":{},\"user\":{},\"9\":null}", "", "not found...", true );
-    test( "54", "{\"user\":{},\"user2\":[],\"9\":null}", "9", "value is null", true );
-    test3( "55", "{\"user\":{},\"user2\":[[[]],{},{},[]],\"9\":null}", ".user2[3]", "array is []" );
-    test3( "56", "{\"user\":{},\"user2\":[[[]],{},{},[]],\"9\":null}", ".user2[0][0]", "array is []" );
-    test3( "57", "{\"user\":{},\"user2\":[[[1]],{},{},[]],\"9\":null}", ".user2[0][0][0]", "number is 1" );
-    test3( "58", "{\"user\":{},\"user2\":[[[1]],{},{},[[1],[],[\"111\"]]],\"9\":null}", ".user2[3][0][0]",
-           "number is 1" );
-    test( "59", "{\"user\":{},\"user2\":[[[{\"data\":[]}]],{},{},[[1],[],[\"111\"]]],\"9\":null}", "data", "array is []",
-          true );
-
-    test3( "60", "{}", ".user", "not found..." );
-    test3( "61", "{\"data\":{\"user\":{}}}", ".data.user.temp", "not found..." );
-    test3( "62", "", ".", "wrong pattern format" );
-    test3( "63", "{}", ".0", "not found..." );
-    test( "64", "", "", "parse error", true );
-    test2( "65", "", 0, "parse error" );
-    test( "66", "{\"\":null}", "", "value is null", true );
-    test2( "67", "", 0, "parse error" );
-
-    // NULL testing
-    test( "68", NULL, "", "parse error", false );
-    test( "69", NULL, "", "parse error", true );
-    test2( "70", NULL, 0, "parse error" );
-    test2( "71", "[1,2,2,2,2,]", -2, "wrong pattern format" );
-    test2( "72", "[1,2,2,2,2]", -2, "wrong pattern format" );
-    test2( "73", "[1,2,2,2,2]", 5, "not found..." );
-    test( "74", "[1,2,2,2,2]", NULL, "wrong pattern format", false );
-    test( "75", "[1,2,2,2,2]", NULL, "wrong pattern format", false );
-    test3( "76", "[111,222]", NULL, "wrong pattern format" );
-
-    json = "{\n"
-           "\t\"some\":{\n"
-           "\t\t\"data\":\n"
-           "\t\t[\n"
-           "\t\t\t{\n"
-           "\t\t\t\t\"something\":\"ag\",\n"
-           "\t\t\t\t\"haha\":\"another\",\n"
-           "\t\t\t\t\"num\":65536\n"
-           "\t\t\t}\n"
-           "\t\t\t[\n"
-           "\t\t\t\ttrue,\n"
-           "\t\t\t\tfalse,\n"
-           "\t\t\t\tnull,\n"
-           "\t\t\t\t65535,\n"
-           "\t\t\t\t{\"again\":1122}\n"
-           "\t\t\t],\n"
-           "\t\t\t12234532,\n"
-           "\t\t\t{\n"
-           "\t\t\t  \"empty\":{},\n"
-           "\t\t\t  \"null\":null,\n"
-           "\t\t\t  \"false\":false,\n"
-           "\t\t\t  \"true\":true\n"
-           "\t\t\t  \"eArray\":[]\n"
-           "\t\t\t}\n"
-           "\t\t]\n"
-           "\t}\n"
-           "}";
-    test("77",json,"empty","parse error",true);
-
-    return 0;
-}
\ No newline at end of file
+void releaseArena( Arena *arena ){
+
+    if ( arena == NULL) return;
+
+    resetArena( arena );
+    if ( arena->ownsBuffer ) free( arena->buffer );
+    arena->buffer   = NULL;
+    arena->capacity = 0;
+}
+
+/**
+ * 将数字拷贝成以0结尾的字符串后用strtod转换，数字一般很短，直接放在栈上
+ * @return false: 转换失败
+ */
+bool convertNumberByStrtod( const UBYTE *input, size_t length, double *number ){
+
+    char buffer[64], *numberStr = buffer;
+    if ( length >= sizeof( buffer )) {
+        numberStr = (char *) malloc( sizeof( char ) * ( length + 1 ));
+        if ( numberStr == NULL) return false;
+    }
+    copyAsChar( input, numberStr, length );
+    numberStr[length] = cENDING;
+
+    char *err;
+    *number = strtod( numberStr, &err );
+    bool converted = *err == cENDING;
+
+    if ( numberStr != buffer ) free( numberStr );
+    return converted;
+}
+
+/**
+ * 将数字转换为double，大部分情况下不需要strtod
+ * @return false: 转换失败
+ */
+bool convertNumber( const UBYTE *input, size_t length, double *number ){
+
+    // scanNumber出错时返回0，长度为0时也不能算作成功
+    DecimalNumber decimal;
+    if ( length == 0 || scanNumber( input, length, &decimal ) != length ) return false;
+    if ( decimalToDouble( &decimal, number )) return true;
+
+    return convertNumberByStrtod( input, length, number );
+}
+
+/**
+ * 按照类型拷贝value
+ * @param arena  NULL: 使用malloc分配
+ * @param input
+ * @param type   value的类型，内容无法转换时(如非法的转义)改为J_PARSE_ERROR
+ * @param length
+ * @return value的内容
+ */
+void *getActualValueByTypeInArena( Arena *arena, const UBYTE *input, ValueType *type, size_t length ){
+
+    switch ( *type ) {
+        case J_PARSE_ERROR:
+            return PARSE_ERROR;
+
+        case J_INT: {
+            double number;
+            if ( !convertNumber( input, length, &number )) {
+                *type = J_PARSE_ERROR;
+                return PARSE_ERROR;
+            }
+
+            int *value = (int *) arenaAlloc( arena, sizeof( int ));
+            CHECK_NULL( value )
+            *value = (int) round( number );
+            return value;
+        }
+        case J_FLOAT: {
+            double number;
+            if ( !convertNumber( input, length, &number )) {
+                *type = J_PARSE_ERROR;
+                return PARSE_ERROR;
+            }
+
+            double *value = (double *) arenaAlloc( arena, sizeof( double ));
+            CHECK_NULL( value )
+            *value = number;
+            return value;
+        }
+
+        case J_NULL:
+        case J_TRUE:
+        case J_FALSE: {
+            long long *value = (long long *) arenaAlloc( arena, sizeof( long long ));
+            CHECK_NULL( value )
+            *value = *type == J_TRUE;
+            return value;
+        }
+
+        case J_ARRAY:
+        case J_OBJ: {
+            UBYTE *value = (UBYTE *) arenaAlloc( arena, sizeof( UBYTE ) * ( length + 1 ));
+            CHECK_NULL( value )
+            memcpy( value, input, sizeof( UBYTE ) * length );
+            value[length] = cENDING;
+            return value;
+        }
+
+        case J_STRING: {
+            // 反转义后不会变长
+            UBYTE *value = (UBYTE *) arenaAlloc( arena, sizeof( UBYTE ) * ( length - 1 ));
+            CHECK_NULL( value )
+
+            size_t valueLength;
+            if ( !unescapeString( input + 1, length - 2, value, &valueLength )) {
+                if ( arena == NULL) free( value );
+                *type = J_PARSE_ERROR;
+                return PARSE_ERROR;
+            }
+            value[valueLength] = cENDING;
+            return value;
+        }
+
+        default: // not found
+            return NULL;
+    }
+}
+
+void *getActualValueByType( const UBYTE *input, ValueType *type, size_t length ){
+    return getActualValueByTypeInArena( NULL, input, type, length );
+}
+
+/**
+ * 拷贝span指向的value，value的内容无法转换时*valueType改为J_PARSE_ERROR
+ */
+void *getCheckedValueBySpan( Arena *arena, const UBYTE *input, const ValueSpan *span, ValueType *valueType ){
+
+    ValueType type = span->valueType;
+    void      *value = getActualValueByTypeInArena( arena, input + span->offset, &type, span->length );
+    if ( valueType != NULL) *valueType = type;
+    return value;
+}
+
+/**
+ * 在数组中定位下标为index的元素，不做任何拷贝
+ * @param input
+ * @param inputLength
+ * @param index  以0为开始的下标
+ * @param search
+ * @param length 用于返回元素的长度，下标超出范围时返回到数组结束为止的长度
+ *               search->startOnly时object和array元素返回到input结束为止的长度
+ * @return 元素在input中的起始位置, 找不到或者解析错误返回NULL, 具体见search->valueType
+ */
+const UBYTE *locateArrayIndex( const UBYTE *input, size_t inputLength, size_t index, SearchState *search,
+                               size_t *length ){
+
+    if ( input == NULL) {
+        search->valueType = J_PARSE_ERROR;
+        return PARSE_ERROR;
+    }
+
+    size_t i = 0;
+    search->options = S_NORMAL;
+
+    while ( i < inputLength && isWhiteSpace( input[i] ))i++;
+
+    if ( i >= inputLength || input[i] != '[' ) {
+        search->valueType = J_PARSE_ERROR;
+        return PARSE_ERROR;
+    }
+    i++;
+
+    while ( i < inputLength ) {
+        UBYTE c = input[i];
+        if ( isWhiteSpace( c )) {
+            i++;
+            continue;
+        }
+
+        if ( c == ']' ) {
+            *length = i + 1;
+            search->valueType = J_NOT_FOUND;
+            return NOT_FOUND;
+        }
+
+        ValueClass valueClass = (ValueClass) cVALUE_CLASS[c];
+        if ( index == 0 && search->startOnly && ( valueClass == C_OBJECT || valueClass == C_ARRAY )) {
+            *length = inputLength - i;
+            search->valueType = valueClass == C_OBJECT ? J_OBJ : J_ARRAY;
+            return input + i;
+        }
+
+        size_t      lengthWithBlank = 0;
+        ValueType   valueType;
+        const UBYTE *valueStart     = parseValue( input + i, inputLength - i, length, &lengthWithBlank, search,
+                                                  &valueType );
+
+        if ( valueStart == PARSE_ERROR) {
+            search->valueType = J_PARSE_ERROR;
+            return PARSE_ERROR;
+        }
+
+        if ( index-- == 0 ) {
+
+            // 找到当前的value
+            search->valueType = valueType;
+            return valueStart;
+        }
+
+        i += lengthWithBlank;
+
+        if ( i < inputLength && input[i] == ',' ) {
+            i++;
+            continue;
+        }
+
+        // 如果间隔符号刚好是']'的情况，下标超出了数组的长度
+        if ( i < inputLength && input[i] == ']' ) {
+            *length = i + 1;
+            search->valueType = J_NOT_FOUND;
+            return NOT_FOUND;
+        }
+
+        search->valueType = J_PARSE_ERROR;
+        return PARSE_ERROR;
+    }
+
+    search->valueType = J_PARSE_ERROR;
+    return PARSE_ERROR;
+}
+
+/**
+ * 提供Index的search方法，当且仅当input是数组的情况下查找
+ * 下标超出范围时search->valueType为J_NOT_FOUND，但数组之后还有空白以外的内容时为J_PARSE_ERROR
+ * @param input
+ * @param index 以0为开始的下标
+ * @param search
+ * @return 查询结果的内容，需要手动释放指针
+ */
+void *parseArrayByIndex( const UBYTE *input, int index, Search *search ){
+
+    if ( search == NULL) {
+        return PATTERN_WRONG_FORMAT;
+    }
+
+    search->options = S_NORMAL;
+
+    if ( input == NULL) {
+        search->valueType = J_PARSE_ERROR;
+        return PARSE_ERROR;
+    }
+
+    if ( index < 0 ) {
+        search->valueType = J_PATTERN_WRONG_FORMAT;
+        return PATTERN_WRONG_FORMAT;
+    }
+
+    SearchState state       = { .valueType = J_NOT_FOUND, .options = S_NORMAL };
+    size_t      length      = 0;
+    size_t      inputLength = terminatedLength( input );
+    const UBYTE *valueStart = locateArrayIndex( input, inputLength, (size_t) index, &state, &length );
+
+    // 下标超出范围时，只有数组之后没有其他内容才算找不到
+    if ( state.valueType == J_NOT_FOUND ) {
+        while ( length < inputLength && isWhiteSpace( input[length] )) length++;
+        if ( length < inputLength ) state.valueType = J_PARSE_ERROR;
+    }
+
+    search->valueType = state.valueType;
+    if ( valueStart == NULL) return NULL;
+
+    return getActualValueByType( valueStart, &search->valueType, length );
+}
+
+/**
+ * 按key查找，只修改state，Search和Query共用
+ * @param state 查找的key和选项，state->valueType返回结果的类型
+ * @return 结果在input中的起始位置；找不到或者出错返回NULL，此时不修改span
+ */
+const UBYTE *searchKeyState( const UBYTE *input, size_t inputLength, SearchState *state, ValueSpan *span ){
+
+    size_t    length          = 0;
+    size_t    lengthWithBlank = 0;
+    ValueType valueType;
+
+    const UBYTE *valueBegin = parseValue( input, inputLength, &length, &lengthWithBlank, state, &valueType );
+    if ( valueBegin == PARSE_ERROR) state->valueType = J_PARSE_ERROR;
+
+    if ( state->valueType == J_PARSE_ERROR || state->valueType == J_NOT_FOUND ) return NOT_FOUND;
+
+    if ( span != NULL) {
+        span->offset    = (size_t) ( valueBegin - input );
+        span->length    = length;
+        span->valueType = state->valueType;
+    }
+    return valueBegin;
+}
+
+const UBYTE *macroKeyValueSearchSpan( const UBYTE *input, size_t inputLength, Search *search, ValueSpan *span ){
+
+    if ( search == NULL) {
+        return PATTERN_WRONG_FORMAT;
+    }
+
+    if ( search->pattern == NULL) {
+        search->valueType = J_PATTERN_WRONG_FORMAT;
+        return PATTERN_WRONG_FORMAT;
+    }
+
+    if ( input == NULL || ( search->strict && !validateJson( input, inputLength, NULL))) {
+        search->valueType = J_PARSE_ERROR;
+        return PARSE_ERROR;
+    }
+
+    SearchState state = { .pattern = search->pattern, .patternLength = strlen((const char *) search->pattern ),
+                          .valueType = J_NOT_FOUND, .options = search->options,
+                          .unescapeKey = search->unescapeKey, .maxDepth = search->maxDepth };
+
+    const UBYTE *valueBegin = searchKeyState( input, inputLength, &state, span );
+
+    search->keyFoundInObject = state.keyFoundInObject;
+    search->valueType        = state.valueType;
+    return valueBegin;
+}
+
+void *macroKeyValueSearchInArena( Arena *arena, const UBYTE *input, size_t inputLength, Search *search ){
+
+    ValueSpan   span;
+    const UBYTE *valueBegin = macroKeyValueSearchSpan( input, inputLength, search, &span );
+    if ( valueBegin == NULL) return NULL;
+
+    return getCheckedValueBySpan( arena, input, &span, &search->valueType );
+}
+
+void *macroKeyValueSearchWithLength( const UBYTE *input, size_t inputLength, Search *search ){
+
+    return macroKeyValueSearchInArena( NULL, input, inputLength, search );
+}
+
+void *macroKeyValueSearch( const UBYTE *input, Search *search ){
+
+    return macroKeyValueSearchWithLength( input, terminatedLength( input ), search );
+}
+
+void *getValueBySpanInArena( Arena *arena, const UBYTE *input, const ValueSpan *span ){
+
+    if ( input == NULL || span == NULL) return PARSE_ERROR;
+
+    return getCheckedValueBySpan( arena, input, span, NULL );
+}
+
+void *getValueBySpan( const UBYTE *input, const ValueSpan *span ){
+
+    return getValueBySpanInArena( NULL, input, span );
+}
+
+/**
+ * 解析路径中的一段, .key或者[n]
+ * @param pattern 以0结尾的路径
+ * @param segment 用于返回解析结果，key直接指向pattern，hash为0
+ * @return 下一段的起始位置, PATTERN_WRONG_FORMAT: 格式错误
+ */
+const UBYTE *nextPathSegment( const UBYTE *pattern, PathSegment *segment ){
+
+    if ( *pattern == cPATH_SEPARATE ) {
+        pattern++;
+
+        const UBYTE *keyStart = pattern;
+        while ( *pattern != cPATH_SEPARATE && *pattern != '[' && *pattern != ']' && *pattern != cENDING ) {
+            pattern++;
+        }
+        if ( pattern == keyStart ) return PATTERN_WRONG_FORMAT;
+
+        segment->type      = P_KEY;
+        segment->key       = keyStart;
+        segment->keyLength = (size_t) ( pattern - keyStart );
+        segment->index     = 0;
+        segment->hash      = 0;
+        return pattern;
+    }
+
+    if ( *pattern == '[' ) {
+        pattern++;
+
+        const UBYTE *numberStart = pattern;
+        size_t      index        = 0;
+
+        while ( *pattern != ']' && *pattern != cENDING ) {
+            if ( !isDigit( *pattern ) || index > ( INT_MAX - 9 ) / 10 ) return PATTERN_WRONG_FORMAT;
+            index = index * 10 + ( *pattern - '0' );
+            pattern++;
+        }
+        if ( *pattern == cENDING || pattern == numberStart ) return PATTERN_WRONG_FORMAT;
+
+        segment->type      = P_INDEX;
+        segment->key       = NULL;
+        segment->keyLength = 0;
+        segment->index     = index;
+        segment->hash      = 0;
+        return pattern + 1;
+    }
+
+    return PATTERN_WRONG_FORMAT;
+}
+
+/**
+ * 路径中的一跳，在source中查找segment，找到后source指向找到的value
+ * 中间的一跳不需要value的长度，只有最后一跳计算，避免每一跳都扫描整个下层
+ * @param source       当前所在的value，找到后更新为下一层的value
+ * @param sourceLength source之后可用的长度，找到后更新为下一层value的长度
+ * @param segment
+ * @param isLast       false时找到的object和array不计算长度，sourceLength为到input结束为止的长度
+ * @return 找到的value类型，J_NOT_FOUND或者J_PARSE_ERROR
+ */
+ValueType searchPathSegment( const UBYTE **source, size_t *sourceLength, const PathSegment *segment, bool isLast ){
+
+    SearchState state  = { .pattern = segment->key, .patternLength = segment->keyLength,
+                           .valueType = J_NOT_FOUND, .options = S_NORMAL, .startOnly = !isLast };
+    size_t      length = 0;
+    const UBYTE *result;
+
+    if ( segment->type == P_KEY ) {
+        // search in object
+        size_t    lengthWithBlanks;
+        ValueType valueType;
+        result = parseValue( *source, *sourceLength, &length, &lengthWithBlanks, &state, &valueType );
+    } else {
+        // search in array
+        result = locateArrayIndex( *source, *sourceLength, segment->index, &state, &length );
+    }
+
+    // not found the value and parse error
+    if ( result == PARSE_ERROR && state.valueType == J_PARSE_ERROR ) return J_PARSE_ERROR;
+
+    // not found the value
+    if ( result == NOT_FOUND || state.valueType == J_NOT_FOUND ) return J_NOT_FOUND;
+
+    // found the value, continue in the sub value
+    *source       = result;
+    *sourceLength = length;
+    return state.valueType;
+}
+
+const UBYTE *marcoPathSearchSpanWithLength( const UBYTE *input, size_t inputLength, Search *search, ValueSpan *span ){
+
+    if ( search == NULL) {
+        return PATTERN_WRONG_FORMAT;
+    }
+
+    if ( search->pattern == NULL) {
+        search->valueType = J_PATTERN_WRONG_FORMAT;
+        return PATTERN_WRONG_FORMAT;
+    }
+
+    if ( input == NULL || ( search->strict && !validateJson( input, inputLength, NULL))) {
+        search->valueType = J_PARSE_ERROR;
+        return PARSE_ERROR;
+    }
+
+    const UBYTE *pattern = search->pattern;
+    search->options          = S_NORMAL;
+    search->keyFoundInObject = false;
+
+    if ( *pattern != cPATH_SEPARATE && *pattern != '[' ) {
+        search->valueType = J_PATTERN_WRONG_FORMAT;
+        return PATTERN_WRONG_FORMAT;
+    }
+
+    // 每一跳都只是在原始input中移动指针，不拷贝中间结果
+    const UBYTE *source      = input;
+    size_t      sourceLength = inputLength;
+
+    while ( *pattern != cENDING ) {
+
+        PathSegment segment;
+        pattern = nextPathSegment( pattern, &segment );
+        if ( pattern == PATTERN_WRONG_FORMAT) {
+            search->valueType = J_PATTERN_WRONG_FORMAT;
+            return PATTERN_WRONG_FORMAT;
+        }
+
+        search->valueType = searchPathSegment( &source, &sourceLength, &segment, *pattern == cENDING );
+        if ( search->valueType == J_PARSE_ERROR ) return PARSE_ERROR;
+        if ( search->valueType == J_NOT_FOUND ) return NOT_FOUND;
+    }
+
+    if ( span != NULL) {
+        span->offset    = (size_t) ( source - input );
+        span->length    = sourceLength;
+        span->valueType = search->valueType;
+    }
+
+    return source;
+}
+
+const UBYTE *marcoPathSearchSpan( const UBYTE *input, Search *search, ValueSpan *span ){
+
+    return marcoPathSearchSpanWithLength( input, terminatedLength( input ), search, span );
+}
+
+void *marcoPathSearchInArena( Arena *arena, const UBYTE *input, size_t inputLength, Search *search ){
+
+    ValueSpan   span;
+    const UBYTE *leaf = marcoPathSearchSpanWithLength( input, inputLength, search, &span );
+    if ( leaf == NULL) return NULL;
+
+    // 只有最终的叶子节点需要拷贝
+    return getCheckedValueBySpan( arena, input, &span, &search->valueType );
+}
+
+void *marcoPathSearchWithLength( const UBYTE *input, size_t inputLength, Search *search ){
+
+    return marcoPathSearchInArena( NULL, input, inputLength, search );
+}
+
+void *marcoPathSearch( const UBYTE *input, Search *search ){
+
+    return marcoPathSearchWithLength( input, terminatedLength( input ), search );
+}
+
+CompiledPath *compilePath( const UBYTE *pattern ){
+
+    if ( pattern == NULL || ( *pattern != cPATH_SEPARATE && *pattern != '[' )) return PATTERN_WRONG_FORMAT;
+
+    // 第一遍只检查格式并计算段数
+    size_t      segmentCount = 0;
+    PathSegment segment;
+    const UBYTE *next        = pattern;
+    while ( *next != cENDING ) {
+        next = nextPathSegment( next, &segment );
+        if ( next == PATTERN_WRONG_FORMAT) return PATTERN_WRONG_FORMAT;
+        segmentCount++;
+    }
+
+    size_t       patternLength = (size_t) ( next - pattern );
+    CompiledPath *path         = (CompiledPath *) malloc(
+            sizeof( CompiledPath ) + sizeof( PathSegment ) * segmentCount + patternLength + 1 );
+    CHECK_NULL( path )
+
+    path->segmentCount = segmentCount;
+    path->segments     = (PathSegment *) ( path + 1 );
+    path->pattern      = (UBYTE *) ( path->segments + segmentCount );
+    memcpy( path->pattern, pattern, patternLength + 1 );
+
+    // 第二遍在拷贝上切分，key直接指向拷贝
+    next = path->pattern;
+    for ( size_t i = 0; i < segmentCount; i++ ) {
+        next = nextPathSegment( next, &path->segments[i] );
+        path->segments[i].hash = path->segments[i].type == P_KEY
+                                 ? hashKey( path->segments[i].key, path->segments[i].keyLength ) : 0;
+    }
+
+    return path;
+}
+
+void freeCompiledPath( CompiledPath *path ){
+    free( path );
+}
+
+const UBYTE *compiledPathSearchSpan( const CompiledPath *path, const UBYTE *input, size_t inputLength,
+                                     ValueSpan *span ){
+
+    ValueType valueType = J_PARSE_ERROR;
+
+    if ( path == NULL) {
+        valueType = J_PATTERN_WRONG_FORMAT;
+    } else if ( input != NULL) {
+
+        const UBYTE *source      = input;
+        size_t      sourceLength = inputLength;
+
+        for ( size_t i = 0; i < path->segmentCount; i++ ) {
+            valueType = searchPathSegment( &source, &sourceLength, &path->segments[i], i + 1 == path->segmentCount );
+            if ( valueType == J_PARSE_ERROR || valueType == J_NOT_FOUND ) break;
+        }
+
+        if ( valueType != J_PARSE_ERROR && valueType != J_NOT_FOUND ) {
+            if ( span != NULL) {
+                span->offset    = (size_t) ( source - input );
+                span->length    = sourceLength;
+                span->valueType = valueType;
+            }
+            return source;
+        }
+    }
+
+    if ( span != NULL) {
+        span->offset    = 0;
+        span->length    = 0;
+        span->valueType = valueType;
+    }
+    return NULL;
+}
+
+void *compiledPathSearchInArena( Arena *arena, const CompiledPath *path, const UBYTE *input, size_t inputLength,
+                                 ValueType *valueType ){
+
+    ValueSpan   span;
+    const UBYTE *leaf = compiledPathSearchSpan( path, input, inputLength, &span );
+    if ( valueType != NULL) *valueType = span.valueType;
+    if ( leaf == NULL) return NULL;
+
+    return getCheckedValueBySpan( arena, input, &span, valueType );
+}
+
+void *compiledPathSearch( const CompiledPath *path, const UBYTE *input, size_t inputLength, ValueType *valueType ){
+
+    return compiledPathSearchInArena( NULL, path, input, inputLength, valueType );
+}
+
+/* PathSet中的节点，每个节点对应路径中的一段，根节点对应整个input */
+typedef struct {
+    PathSegment segment;
+    size_t      firstChild;        // cNO_NODE: 没有下一层
+    size_t      nextSibling;       // cNO_NODE: 没有同层的下一个节点
+    size_t      firstPattern;      // 在这个节点结束的第一个pattern, cNO_NODE: 没有
+} PathSetNode;
+
+struct PathSet {
+    size_t      patternCount;
+    size_t      nodeCount;
+    PathSetNode *nodes;            // nodes[0]为根节点
+    size_t      *nextSamePattern;  // 在同一个节点结束的下一个pattern, cNO_NODE: 没有
+    UBYTE       *patterns;         // 所有pattern的拷贝，segment中的key指向这里
+};
+
+/* 一次扫描中的状态 */
+typedef struct {
+    const PathSet *set;
+    const UBYTE   *input;
+    ValueSpan     *spans;
+    size_t        foundCount;
+} PathSetWalk;
+
+const size_t cNO_NODE = (size_t) -1;
+
+bool isSamePathSegment( const PathSegment *a, const PathSegment *b ){
+    if ( a->type != b->type ) return false;
+    if ( a->type == P_INDEX ) return a->index == b->index;
+    return a->keyLength == b->keyLength && memcmp( a->key, b->key, a->keyLength ) == 0;
+}
+
+PathSet *compilePathSet( const UBYTE **patterns, size_t patternCount ){
+
+    if ( patterns == NULL || patternCount == 0 ) return PATTERN_WRONG_FORMAT;
+
+    // 第一遍只检查格式并计算需要的空间
+    size_t      segmentCount = 0, patternBytes = 0;
+    PathSegment segment;
+    for ( size_t p = 0; p < patternCount; p++ ) {
+
+        const UBYTE *next = patterns[p];
+        if ( next == NULL || ( *next != cPATH_SEPARATE && *next != '[' )) return PATTERN_WRONG_FORMAT;
+
+        while ( *next != cENDING ) {
+            next = nextPathSegment( next, &segment );
+            if ( next == PATTERN_WRONG_FORMAT) return PATTERN_WRONG_FORMAT;
+            segmentCount++;
+        }
+        patternBytes += (size_t) ( next - patterns[p] ) + 1;
+    }
+
+    size_t  maxNodeCount = segmentCount + 1;
+    PathSet *set         = (PathSet *) malloc( sizeof( PathSet ) + sizeof( PathSetNode ) * maxNodeCount
+                                               + sizeof( size_t ) * patternCount + patternBytes );
+    CHECK_NULL( set )
+
+    set->patternCount    = patternCount;
+    set->nodes           = (PathSetNode *) ( set + 1 );
+    set->nextSamePattern = (size_t *) ( set->nodes + maxNodeCount );
+    set->patterns        = (UBYTE *) ( set->nextSamePattern + patternCount );
+
+    PathSetNode root = { { .type = P_KEY }, cNO_NODE, cNO_NODE, cNO_NODE };
+    set->nodes[0]  = root;
+    set->nodeCount = 1;
+
+    // 第二遍在拷贝上切分，并插入到trie中，相同的前缀共用节点
+    UBYTE *copy = set->patterns;
+    for ( size_t p = 0; p < patternCount; p++ ) {
+
+        size_t patternLength = strlen((const char *) patterns[p] );
+        memcpy( copy, patterns[p], patternLength + 1 );
+
+        size_t      node  = 0;
+        const UBYTE *next = copy;
+        while ( *next != cENDING ) {
+            next = nextPathSegment( next, &segment );
+
+            size_t child = set->nodes[node].firstChild, last = cNO_NODE;
+            while ( child != cNO_NODE && !isSamePathSegment( &set->nodes[child].segment, &segment )) {
+                last  = child;
+                child = set->nodes[child].nextSibling;
+            }
+
+            if ( child == cNO_NODE ) {
+                child = set->nodeCount++;
+                PathSetNode newNode = { segment, cNO_NODE, cNO_NODE, cNO_NODE };
+                set->nodes[child] = newNode;
+                if ( last == cNO_NODE ) {
+                    set->nodes[node].firstChild = child;
+                } else {
+                    set->nodes[last].nextSibling = child;
+                }
+            }
+            node = child;
+        }
+
+        set->nextSamePattern[p]     = set->nodes[node].firstPattern;
+        set->nodes[node].firstPattern = p;
+        copy += patternLength + 1;
+    }
+
+    return set;
+}
+
+void freePathSet( PathSet *set ){
+    free( set );
+}
+
+const UBYTE *walkPathSetValue( PathSetWalk *walk, size_t node, const UBYTE *input, size_t inputLength,
+                               size_t *length, size_t *lengthWithBlanks );
+
+/* 在object中只进入有路径经过的key，其它的value直接跳过 */
+const UBYTE *walkPathSetObject( PathSetWalk *walk, size_t node, const UBYTE *input, size_t inputLength,
+                                size_t *objectLength ){
+
+    const PathSetNode *nodes = walk->set->nodes;
+
+    size_t i             = 1;
+    bool   justParsedKey = false, justParsedValue = false;
+    size_t child         = cNO_NODE;
+
+    while ( i < inputLength ) {
+        UBYTE c = input[i];
+        if ( isWhiteSpace( c )) {
+            i++;
+            continue;
+        }
+
+        if ( c == '"' && !justParsedKey && !justParsedValue ) {
+            size_t keyLength = parseString( input + i, inputLength - i );
+            if ( keyLength == (size_t) PARSE_ERROR) return PARSE_ERROR;
+
+            child = nodes[node].firstChild;
+            while ( child != cNO_NODE ) {
+                const PathSegment *segment = &nodes[child].segment;
+                if ( segment->type == P_KEY && segment->keyLength == keyLength - 2
+                     && memcmp( segment->key, input + i + 1, keyLength - 2 ) == 0 )
+                    break;
+                child = nodes[child].nextSibling;
+            }
+
+            i += keyLength;
+            justParsedKey = true;
+            continue;
+        }
+
+        if ( c == ':' && justParsedKey ) {
+            i++;
+
+            size_t      valueLength, valueLengthWithBlanks;
+            const UBYTE *result;
+            if ( child != cNO_NODE ) {
+                result = walkPathSetValue( walk, child, input + i, inputLength - i, &valueLength,
+                                           &valueLengthWithBlanks );
+            } else {
+                SearchState skip = { .valueType = J_NOT_FOUND, .options = S_NORMAL };
+                ValueType   valueType;
+                result = parseValue( input + i, inputLength - i, &valueLength, &valueLengthWithBlanks, &skip,
+                                     &valueType );
+            }
+            if ( result == PARSE_ERROR) return PARSE_ERROR;
+
+            // 所有的路径都已经找到，不需要再继续
+            if ( walk->foundCount == walk->set->patternCount ) return input;
+
+            i += valueLengthWithBlanks;
+            justParsedKey   = false;
+            justParsedValue = true;
+            continue;
+        }
+
+        if ( c == ',' && justParsedValue ) {
+            i++;
+            justParsedValue = false;
+            continue;
+        }
+
+        if ( c == '}' && !justParsedKey ) {
+            *objectLength = i + 1;
+            return input;
+        }
+
+        return PARSE_ERROR;
+    }
+
+    return OVER_FLOW;
+}
+
+/* 在array中只进入有路径经过的下标，其它的元素直接跳过 */
+const UBYTE *walkPathSetArray( PathSetWalk *walk, size_t node, const UBYTE *input, size_t inputLength,
+                               size_t *arrayLength ){
+
+    const PathSetNode *nodes = walk->set->nodes;
+
+    size_t i     = 1;
+    size_t index = 0;
+
+    while ( i < inputLength ) {
+        if ( isWhiteSpace( input[i] )) {
+            i++;
+            continue;
+        }
+
+        if ( input[i] == ']' && index == 0 )break;
+
+        size_t child = nodes[node].firstChild;
+        while ( child != cNO_NODE
+                && ( nodes[child].segment.type != P_INDEX || nodes[child].segment.index != index )) {
+            child = nodes[child].nextSibling;
+        }
+
+        size_t      valueLength, valueLengthWithBlanks;
+        const UBYTE *result;
+        if ( child != cNO_NODE ) {
+            result = walkPathSetValue( walk, child, input + i, inputLength - i, &valueLength,
+                                       &valueLengthWithBlanks );
+        } else {
+            SearchState skip = { .valueType = J_NOT_FOUND, .options = S_NORMAL };
+            ValueType   valueType;
+            result = parseValue( input + i, inputLength - i, &valueLength, &valueLengthWithBlanks, &skip,
+                                 &valueType );
+        }
+        if ( result == PARSE_ERROR) return PARSE_ERROR;
+
+        // 所有的路径都已经找到，不需要再继续
+        if ( walk->foundCount == walk->set->patternCount ) return input;
+
+        i += valueLengthWithBlanks;
+        index++;
+
+        if ( i < inputLength && input[i] == ',' ) {
+            i++;
+            continue;
+        }
+
+        if ( i < inputLength && input[i] == ']' )break;
+
+        return PARSE_ERROR;
+    }
+
+    if ( i >= inputLength ) return OVER_FLOW;
+
+    *arrayLength = i + 1;
+    return input;
+}
+
+const UBYTE *walkPathSetValue( PathSetWalk *walk, size_t node, const UBYTE *input, size_t inputLength,
+                               size_t *length, size_t *lengthWithBlanks ){
+
+    const PathSetNode *current = &walk->set->nodes[node];
+
+    size_t i = 0;
+    while ( i < inputLength && isWhiteSpace( input[i] ))i++;
+
+    const UBYTE *result;
+    ValueType   valueType;
+    UBYTE       c = i < inputLength ? input[i] : cENDING;
+
+    if ( current->firstChild != cNO_NODE && c == '{' ) {
+        valueType = J_OBJ;
+        result    = walkPathSetObject( walk, node, input + i, inputLength - i, length );
+    } else if ( current->firstChild != cNO_NODE && c == '[' ) {
+        valueType = J_ARRAY;
+        result    = walkPathSetArray( walk, node, input + i, inputLength - i, length );
+    } else {
+        // 没有路径再往下，直接跳过整个value
+        SearchState skip = { .valueType = J_NOT_FOUND, .options = S_NORMAL };
+        size_t      blanks;
+        result = parseValue( input + i, inputLength - i, length, &blanks, &skip, &valueType );
+    }
+
+    if ( result == PARSE_ERROR) return PARSE_ERROR;
+    if ( walk->foundCount == walk->set->patternCount ) return result;
+
+    // 在这个节点结束的pattern
+    for ( size_t p = current->firstPattern; p != cNO_NODE; p = walk->set->nextSamePattern[p] ) {
+        ValueSpan *span = &walk->spans[p];
+        if ( span->valueType != J_NOT_FOUND ) continue;
+
+        span->offset    = (size_t) ( result - walk->input );
+        span->length    = *length;
+        span->valueType = valueType;
+        walk->foundCount++;
+    }
+
+    i += *length;
+    while ( i < inputLength && isWhiteSpace( input[i] ))i++;
+
+    *lengthWithBlanks = i;
+    return result;
+}
+
+size_t pathSetSearch( const PathSet *set, const UBYTE *input, size_t inputLength, ValueSpan *spans ){
+
+    if ( set == NULL || spans == NULL) return 0;
+
+    for ( size_t p = 0; p < set->patternCount; p++ ) {
+        spans[p].offset    = 0;
+        spans[p].length    = 0;
+        spans[p].valueType = J_NOT_FOUND;
+    }
+
+    PathSetWalk walk = { set, input, spans, 0 };
+    size_t      length, lengthWithBlanks;
+
+    if ( input == NULL || walkPathSetValue( &walk, 0, input, inputLength, &length, &lengthWithBlanks ) == NULL) {
+        // 解析出错，还没有找到的pattern都标记为出错
+        for ( size_t p = 0; p < set->patternCount; p++ ) {
+            if ( spans[p].valueType == J_NOT_FOUND ) spans[p].valueType = J_PARSE_ERROR;
+        }
+    }
+
+    return walk.foundCount;
+}
+
+/* tape中的一个节点，object的每个成员由一个key节点和紧跟着的value节点组成 */
+typedef struct {
+    size_t    offset;              // 在input中的起始位置
+    size_t    length;              // string和key包含左右双引号
+    size_t    next;                // 跳过这个节点以及所有子节点后的下一个节点
+    uint32_t  childCount;          // object: 成员个数, array: 元素个数
+    bool      isKey;
+    ValueType valueType;
+} TapeNode;
+
+struct JsonTape {
+    const UBYTE *input;            // 不拷贝input，使用tape期间input需要保持有效
+    size_t      inputLength;
+    size_t      nodeCount;
+    size_t      nodeCapacity;
+    TapeNode    nodes[];           // nodes[0]为根节点
+};
+
+/* 追加一个节点，空间不够时扩展，返回节点的位置 */
+size_t appendTapeNode( JsonTape **tape, size_t offset, ValueType valueType, bool isKey ){
+
+    JsonTape *current = *tape;
+    if ( current->nodeCount == current->nodeCapacity ) {
+        size_t   capacity = current->nodeCapacity * 2;
+        JsonTape *bigger  = (JsonTape *) realloc( current, sizeof( JsonTape ) + sizeof( TapeNode ) * capacity );
+        if ( bigger == NULL) return cNO_NODE;
+        bigger->nodeCapacity = capacity;
+        *tape = current = bigger;
+    }
+
+    size_t   node  = current->nodeCount++;
+    TapeNode value = { offset, 0, node + 1, 0, isKey, valueType };
+    current->nodes[node] = value;
+    return node;
+}
+
+/* 保证buffer中至少有needed个元素的空间，不够时翻倍 */
+bool reserveBuffer( void **buffer, size_t *capacity, size_t needed, size_t itemSize ){
+
+    if ( needed <= *capacity ) return true;
+
+    size_t bigger = *capacity == 0 ? 16 : *capacity * 2;
+    while ( bigger < needed ) bigger *= 2;
+
+    void *items = realloc( *buffer, bigger * itemSize );
+    if ( items == NULL) return false;
+    *buffer   = items;
+    *capacity = bigger;
+    return true;
+}
+
+/* tape中还没有结束的object或array */
+typedef struct {
+    size_t   node;
+    uint32_t childCount;
+    UBYTE    closing;
+} TapeFrame;
+
+/* 解析object中的key和后面的':'，写入一个key节点 */
+bool appendTapeKey( JsonTape **tape, size_t *position ){
+
+    const UBYTE *input      = ( *tape )->input;
+    size_t      inputLength = ( *tape )->inputLength;
+    size_t      i           = *position;
+
+    while ( i < inputLength && isWhiteSpace( input[i] ))i++;
+
+    size_t keyLength = parseString( input + i, inputLength - i );
+    if ( keyLength == (size_t) PARSE_ERROR) return false;
+
+    size_t keyNode = appendTapeNode( tape, i, J_STRING, true );
+    if ( keyNode == cNO_NODE ) return false;
+    ( *tape )->nodes[keyNode].length = keyLength;
+
+    i += keyLength;
+    while ( i < inputLength && isWhiteSpace( input[i] ))i++;
+    if ( i >= inputLength || input[i] != ':' ) return false;
+
+    *position = i + 1;
+    return true;
+}
+
+/* object或array在end之前结束，所有子节点都已经写入 */
+void closeTapeFrame( JsonTape *tape, const TapeFrame *frame, size_t end ){
+
+    TapeNode *value = &tape->nodes[frame->node];
+    value->length     = end - value->offset;
+    value->next       = tape->nodeCount;
+    value->childCount = frame->childCount;
+}
+
+/**
+ * 解析一个value并写入tape，用显式的栈代替递归，object和array结束时再填写next和childCount
+ * @return value的长度，包含后面的空白; 0: PARSE_ERROR
+ */
+size_t buildTapeValue( JsonTape **tape, size_t offset ){
+
+    const UBYTE *input      = ( *tape )->input;
+    size_t      inputLength = ( *tape )->inputLength;
+    TapeFrame   stackFrames[cSEARCH_FRAMES_ON_STACK];
+    TapeFrame   *frames     = stackFrames;
+    size_t      capacity    = cSEARCH_FRAMES_ON_STACK;
+    size_t      depth       = 0;
+    size_t      i           = offset;
+    size_t      result      = (size_t) PARSE_ERROR;
+
+    while ( true ) {
+
+        // 开始一个value
+        while ( i < inputLength && isWhiteSpace( input[i] ))i++;
+        if ( i >= inputLength ) break;
+
+        UBYTE c = input[i];
+        if ( c == '{' || c == '[' ) {
+
+            size_t node = appendTapeNode( tape, i, c == '{' ? J_OBJ : J_ARRAY, false );
+            if ( node == cNO_NODE ) break;
+            if ( depth == capacity ) {
+                // 超过栈上的层数时才在堆上分配
+                TapeFrame *bigger = frames == stackFrames ? NULL : frames;
+                if ( !reserveBuffer((void **) &bigger, &capacity, depth + 1, sizeof( TapeFrame ))) break;
+                if ( frames == stackFrames ) memcpy( bigger, stackFrames, sizeof( stackFrames ));
+                frames = bigger;
+            }
+
+            TapeFrame frame = { node, 0, c == '{' ? '}' : ']' };
+            frames[depth++] = frame;
+            i++;
+            while ( i < inputLength && isWhiteSpace( input[i] ))i++;
+
+            // 非空的object或array，进入第一个成员
+            if ( i >= inputLength || input[i] != frame.closing ) {
+                if ( c == '{' && !appendTapeKey( tape, &i )) break;
+                continue;
+            }
+            i++;
+            closeTapeFrame( *tape, &frames[--depth], i );
+
+        } else {
+
+            SearchState skip = { .valueType = J_NOT_FOUND, .options = S_NORMAL };
+            size_t      length, lengthWithBlanks;
+            ValueType   valueType;
+            if ( parseValue( input + i, inputLength - i, &length, &lengthWithBlanks, &skip, &valueType ) == PARSE_ERROR)
+                break;
+
+            size_t node = appendTapeNode( tape, i, valueType, false );
+            if ( node == cNO_NODE ) break;
+            ( *tape )->nodes[node].length = length;
+            i += length;
+        }
+
+        // 一个value结束，逐层处理后面的','或者结束符
+        bool failed = false;
+        while ( true ) {
+            while ( i < inputLength && isWhiteSpace( input[i] ))i++;
+            if ( depth == 0 ) break;
+
+            TapeFrame *frame = &frames[depth - 1];
+            frame->childCount++;
+            if ( i < inputLength && input[i] == ',' ) {
+                i++;
+                break;
+            }
+            if ( i < inputLength && input[i] == frame->closing ) {
+                i++;
+                closeTapeFrame( *tape, frame, i );
+                depth--;
+                continue;
+            }
+            failed = true;
+            break;
+        }
+
+        if ( failed ) break;
+        if ( depth == 0 ) {
+            result = i - offset;
+            break;
+        }
+        if ( frames[depth - 1].closing == '}' && !appendTapeKey( tape, &i )) break;
+    }
+
+    if ( frames != stackFrames ) free( frames );
+    return result;
+}
+
+JsonTape *buildTape( const UBYTE *input, size_t inputLength ){
+
+    if ( input == NULL) return PARSE_ERROR;
+
+    // 大约每8个字节一个节点，不够时再扩展
+    size_t   capacity = inputLength / 8 + 16;
+    JsonTape *tape    = (JsonTape *) malloc( sizeof( JsonTape ) + sizeof( TapeNode ) * capacity );
+    CHECK_NULL( tape )
+
+    tape->input        = input;
+    tape->inputLength  = inputLength;
+    tape->nodeCount    = 0;
+    tape->nodeCapacity = capacity;
+
+    if ( buildTapeValue( &tape, 0 ) == (size_t) PARSE_ERROR) {
+        free( tape );
+        return PARSE_ERROR;
+    }
+
+    // 去掉多余的空间
+    JsonTape *fitted = (JsonTape *) realloc( tape, sizeof( JsonTape ) + sizeof( TapeNode ) * tape->nodeCount );
+    if ( fitted != NULL) {
+        tape               = fitted;
+        tape->nodeCapacity = tape->nodeCount;
+    }
+
+    return tape;
+}
+
+void freeTape( JsonTape *tape ){
+    free( tape );
+}
+
+const UBYTE *tapeInput( const JsonTape *tape ){
+    return tape == NULL ? NULL : tape->input;
+}
+
+/* 查找失败，span中返回失败的原因 */
+const UBYTE *tapeError( ValueType valueType, ValueSpan *span ){
+    if ( span != NULL) {
+        span->offset    = 0;
+        span->length    = 0;
+        span->valueType = valueType;
+    }
+    return NOT_FOUND;
+}
+
+/* 根据node返回结果，cNO_NODE表示找不到 */
+const UBYTE *tapeNodeResult( const JsonTape *tape, size_t node, ValueSpan *span ){
+
+    if ( node == cNO_NODE ) return tapeError( J_NOT_FOUND, span );
+
+    const TapeNode *value = &tape->nodes[node];
+    if ( span != NULL) {
+        span->offset    = value->offset;
+        span->length    = value->length;
+        span->valueType = value->valueType;
+    }
+    return tape->input + value->offset;
+}
+
+/* 在node的下一层中查找segment，利用next直接跳过不相关的子节点 */
+size_t tapeChild( const JsonTape *tape, size_t node, const PathSegment *segment ){
+
+    const TapeNode *nodes = tape->nodes;
+
+    if ( segment->type == P_KEY ) {
+        if ( nodes[node].valueType != J_OBJ ) return cNO_NODE;
+
+        size_t child = node + 1;
+        for ( uint32_t i = 0; i < nodes[node].childCount; i++ ) {
+            const TapeNode *key = &nodes[child];
+            if ( key->length - 2 == segment->keyLength
+                 && memcmp( tape->input + key->offset + 1, segment->key, segment->keyLength ) == 0 )
+                return child + 1;
+            child = nodes[child + 1].next;
+        }
+        return cNO_NODE;
+    }
+
+    if ( nodes[node].valueType != J_ARRAY || segment->index >= nodes[node].childCount ) return cNO_NODE;
+
+    size_t child = node + 1;
+    for ( size_t i = 0; i < segment->index; i++ ) child = nodes[child].next;
+    return child;
+}
+
+const UBYTE *tapeKeySearch( const JsonTape *tape, const UBYTE *key, SearchOptions options, ValueSpan *span ){
+
+    if ( tape == NULL) return tapeError( J_PARSE_ERROR, span );
+    if ( key == NULL) return tapeError( J_PATTERN_WRONG_FORMAT, span );
+
+    PathSegment segment = { .type = P_KEY, .key = key, .keyLength = strlen((const char *) key ) };
+    if ( options == S_NORMAL ) return tapeNodeResult( tape, tapeChild( tape, 0, &segment ), span );
+
+    // 节点按照在input中出现的顺序排列，第一个匹配的key就是递归查找的结果
+    for ( size_t node = 0; node < tape->nodeCount; node++ ) {
+        const TapeNode *value = &tape->nodes[node];
+        if ( value->isKey && value->length - 2 == segment.keyLength
+             && memcmp( tape->input + value->offset + 1, key, segment.keyLength ) == 0 )
+            return tapeNodeResult( tape, node + 1, span );
+    }
+    return tapeNodeResult( tape, cNO_NODE, span );
+}
+
+const UBYTE *tapeIndexSearch( const JsonTape *tape, size_t index, ValueSpan *span ){
+
+    if ( tape == NULL) return tapeError( J_PARSE_ERROR, span );
+
+    PathSegment segment = { .type = P_INDEX, .index = index };
+    return tapeNodeResult( tape, tapeChild( tape, 0, &segment ), span );
+}
+
+const UBYTE *tapePathSearch( const JsonTape *tape, const UBYTE *pattern, ValueSpan *span ){
+
+    if ( tape == NULL) return tapeError( J_PARSE_ERROR, span );
+    if ( pattern == NULL || ( *pattern != cPATH_SEPARATE && *pattern != '[' ))
+        return tapeError( J_PATTERN_WRONG_FORMAT, span );
+
+    size_t node = 0;
+    while ( *pattern != cENDING && node != cNO_NODE ) {
+        PathSegment segment;
+        pattern = nextPathSegment( pattern, &segment );
+        if ( pattern == PATTERN_WRONG_FORMAT) return tapeError( J_PATTERN_WRONG_FORMAT, span );
+        node = tapeChild( tape, node, &segment );
+    }
+    return tapeNodeResult( tape, node, span );
+}
+
+const UBYTE *tapeCompiledPathSearch( const JsonTape *tape, const CompiledPath *path, ValueSpan *span ){
+
+    if ( tape == NULL) return tapeError( J_PARSE_ERROR, span );
+    if ( path == NULL) return tapeError( J_PATTERN_WRONG_FORMAT, span );
+
+    size_t node = 0;
+    for ( size_t i = 0; i < path->segmentCount && node != cNO_NODE; i++ ) {
+        node = tapeChild( tape, node, &path->segments[i] );
+    }
+    return tapeNodeResult( tape, node, span );
+}
+
+/**
+ * 直接将整数转换为int64_t，不经过double，超出范围时返回false
+ * @param input
+ * @param length
+ * @param value
+ * @return false: 不是整数或者溢出
+ */
+bool parseInt64( const UBYTE *input, size_t length, int64_t *value ){
+
+    DecimalNumber number;
+    if ( length == 0 || scanNumber( input, length, &number ) != length ) return false;
+
+    return decimalToInt64( &number, value );
+}
+
+bool getInt64BySpan( const UBYTE *input, const ValueSpan *span, int64_t *value ){
+
+    if ( input == NULL || span == NULL || value == NULL || span->valueType != J_INT ) return false;
+
+    return parseInt64( input + span->offset, span->length, value );
+}
+
+bool getDoubleBySpan( const UBYTE *input, const ValueSpan *span, double *value ){
+
+    if ( input == NULL || span == NULL || value == NULL) return false;
+    if ( span->valueType != J_INT && span->valueType != J_FLOAT ) return false;
+
+    return convertNumber( input + span->offset, span->length, value );
+}
+
+bool getBoolBySpan( const UBYTE *input, const ValueSpan *span, bool *value ){
+
+    if ( input == NULL || span == NULL || value == NULL) return false;
+    if ( span->valueType != J_TRUE && span->valueType != J_FALSE ) return false;
+
+    *value = span->valueType == J_TRUE;
+    return true;
+}
+
+bool getStringViewBySpan( const UBYTE *input, const ValueSpan *span, StringView *view ){
+
+    if ( input == NULL || span == NULL || view == NULL || span->valueType != J_STRING ) return false;
+
+    // 不包含左右双引号，转义符保持原样
+    view->data   = input + span->offset + 1;
+    view->length = span->length - 2;
+    return true;
+}
+
+/* 流式解析的状态 */
+typedef enum {
+    ST_VALUE,                      // 等待一个value
+    ST_VALUE_OR_END,               // '['之后，等待value或者']'
+    ST_KEY_OR_END,                 // '{'之后，等待key或者'}'
+    ST_KEY_START,                  // object中','之后，等待key
+    ST_KEY,                        // 在key中
+    ST_COLON,                      // key之后，等待':'
+    ST_STRING,                     // 在字符串value中
+    ST_LITERAL,                    // 在数字、true、false、null中
+    ST_AFTER_VALUE,                // value之后，等待','或者结束符
+    ST_DONE                        // 根节点已经结束
+} StreamState;
+
+/* 每一层打开的object或者array */
+typedef struct {
+    bool   isObject;
+    bool   onPath;                 // 这个容器在目标路径上
+    bool   keyMatched;             // 当前成员的key和目标一致
+    size_t index;                  // array中当前元素的下标
+} StreamFrame;
+
+#define cSTREAM_LITERAL_MAX 512    // 数字、true、false、null的最大长度
+
+struct StreamParser {
+    const CompiledPath *path;      // 按路径查找，NULL时按key查找
+    const UBYTE        *key;
+    size_t             keyLength;
+    SearchOptions      options;
+
+    StreamState  state;
+    StreamFrame  *frames;
+    size_t       depth;            // 当前打开的容器个数
+    size_t       maxDepth;
+
+    bool         escapeNext;       // 字符串中上一个字节是转义符
+    const UBYTE  *compareKey;      // 当前key需要比较的目标，NULL: 不需要比较
+    size_t       compareKeyLength;
+    size_t       keyPosition;
+    bool         keyMismatch;
+
+    UBYTE        literal[cSTREAM_LITERAL_MAX];
+    size_t       literalLength;
+
+    bool         capturing;        // 正在拷贝目标value
+    size_t       captureDepth;
+    UBYTE        *capture;
+    size_t       captureLength;
+    size_t       captureCapacity;
+    size_t       maxValueLength;
+
+    size_t       consumed;         // 之前的chunk的总长度
+    ValueSpan    result;           // offset为在整个输入流中的位置
+    StreamStatus status;
+};
+
+StreamParser *createStreamParser( const CompiledPath *path, const UBYTE *key, SearchOptions options, size_t maxDepth,
+                                  size_t maxValueLength ){
+
+    if ( maxDepth == 0 ) return PATTERN_WRONG_FORMAT;
+
+    StreamParser *parser = (StreamParser *) calloc( 1, sizeof( StreamParser ) + sizeof( StreamFrame ) * maxDepth );
+    CHECK_NULL( parser )
+
+    parser->path           = path;
+    parser->key            = key;
+    parser->keyLength      = key == NULL ? 0 : strlen((const char *) key );
+    parser->options        = options;
+    parser->frames         = (StreamFrame *) ( parser + 1 );
+    parser->maxDepth       = maxDepth;
+    parser->maxValueLength = maxValueLength;
+
+    resetStreamParser( parser );
+    return parser;
+}
+
+StreamParser *createStreamPathParser( const CompiledPath *path, size_t maxDepth, size_t maxValueLength ){
+    if ( path == NULL) return PATTERN_WRONG_FORMAT;
+
+    return createStreamParser( path, NULL, S_NORMAL, maxDepth, maxValueLength );
+}
+
+StreamParser *createStreamKeyParser( const UBYTE *key, SearchOptions options, size_t maxDepth,
+                                     size_t maxValueLength ){
+    if ( key == NULL) return PATTERN_WRONG_FORMAT;
+
+    return createStreamParser( NULL, key, options, maxDepth, maxValueLength );
+}
+
+void resetStreamParser( StreamParser *parser ){
+
+    if ( parser == NULL) return;
+
+    parser->state            = ST_VALUE;
+    parser->depth            = 0;
+    parser->escapeNext       = false;
+    parser->literalLength    = 0;
+    parser->capturing        = false;
+    parser->captureLength    = 0;
+    parser->consumed         = 0;
+    parser->result.offset    = 0;
+    parser->result.length    = 0;
+    parser->result.valueType = J_NOT_FOUND;
+    parser->status           = STREAM_NEED_MORE;
+}
+
+void freeStreamParser( StreamParser *parser ){
+
+    if ( parser == NULL) return;
+
+    free( parser->capture );
+    free( parser );
+}
+
+/* 拷贝目标value在当前chunk中的部分 */
+bool appendStreamCapture( StreamParser *parser, const UBYTE *data, size_t length ){
+
+    if ( length == 0 ) return true;
+    if ( parser->captureLength + length > parser->maxValueLength ) return false;
+
+    if ( parser->captureLength + length > parser->captureCapacity ) {
+        size_t capacity = parser->captureCapacity == 0 ? 64 : parser->captureCapacity;
+        while ( capacity < parser->captureLength + length ) capacity *= 2;
+        if ( capacity > parser->maxValueLength ) capacity = parser->maxValueLength;
+
+        UBYTE *bigger = (UBYTE *) realloc( parser->capture, capacity );
+        if ( bigger == NULL) return false;
+        parser->capture         = bigger;
+        parser->captureCapacity = capacity;
+    }
+
+    memcpy( parser->capture + parser->captureLength, data, length );
+    parser->captureLength += length;
+    return true;
+}
+
+StreamStatus failStream( StreamParser *parser ){
+    parser->result.valueType = J_PARSE_ERROR;
+    parser->status           = STREAM_ERROR;
+    return parser->status;
+}
+
+/**
+ * 当前容器中的下一个成员是不是在目标路径上
+ * @param isTarget 用于返回是不是目标value本身
+ * @return 是否在路径上
+ */
+bool isStreamMemberOnPath( const StreamParser *parser, bool *isTarget ){
+
+    *isTarget = false;
+    if ( parser->depth == 0 ) return parser->path != NULL;
+
+    const StreamFrame *parent = &parser->frames[parser->depth - 1];
+
+    if ( parser->path == NULL) {
+        // key查找只在object中，S_NORMAL只查找根节点
+        *isTarget = parent->isObject && parent->keyMatched
+                    && ( parser->options == S_RECURSIVE || parser->depth == 1 );
+        return false;
+    }
+
+    if ( !parent->onPath || parser->depth > parser->path->segmentCount ) return false;
+
+    const PathSegment *segment = &parser->path->segments[parser->depth - 1];
+    bool              matched  = parent->isObject ? parent->keyMatched
+                                                  : segment->type == P_INDEX && segment->index == parent->index;
+
+    *isTarget = matched && parser->depth == parser->path->segmentCount;
+    return matched && !*isTarget;
+}
+
+/* 一个value结束，end为结束位置之后在当前chunk中的下标 */
+void endStreamValue( StreamParser *parser, const UBYTE *chunk, size_t captureFrom, size_t end ){
+
+    if ( parser->capturing && parser->depth == parser->captureDepth ) {
+        if ( !appendStreamCapture( parser, chunk + captureFrom, end - captureFrom )) {
+            failStream( parser );
+            return;
+        }
+        parser->capturing     = false;
+        parser->result.length = parser->captureLength;
+        parser->status        = STREAM_FOUND;
+        return;
+    }
+
+    if ( parser->depth == 0 ) {
+        parser->state          = ST_DONE;
+        parser->status         = STREAM_NOT_FOUND;
+        return;
+    }
+
+    parser->state = ST_AFTER_VALUE;
+}
+
+/* 数字、true、false、null结束，使用与parseValue相同的语法检查 */
+void endStreamLiteral( StreamParser *parser, const UBYTE *chunk, size_t captureFrom, size_t end ){
+
+    SearchState skip = { .valueType = J_NOT_FOUND, .options = S_NORMAL };
+    size_t      length, lengthWithBlanks;
+    ValueType   valueType;
+
+    if ( parseValue( parser->literal, parser->literalLength, &length, &lengthWithBlanks, &skip, &valueType )
+         == PARSE_ERROR || length != parser->literalLength ) {
+        failStream( parser );
+        return;
+    }
+
+    if ( parser->capturing && parser->depth == parser->captureDepth ) parser->result.valueType = valueType;
+    parser->literalLength = 0;
+    endStreamValue( parser, chunk, captureFrom, end );
+}
+
+StreamStatus feedStreamParser( StreamParser *parser, const UBYTE *chunk, size_t chunkLength ){
+
+    if ( parser == NULL) return STREAM_ERROR;
+    if ( parser->status != STREAM_NEED_MORE ) return parser->status;
+    if ( chunk == NULL && chunkLength > 0 ) return failStream( parser );
+
+    size_t i = 0, captureFrom = 0;
+
+    while ( i < chunkLength && parser->status == STREAM_NEED_MORE ) {
+        UBYTE c = chunk[i];
+
+        switch ( parser->state ) {
+
+            case ST_KEY_OR_END:
+            case ST_KEY_START:
+                if ( isWhiteSpace( c )) break;
+                if ( c == '}' && parser->state == ST_KEY_OR_END ) {
+                    parser->depth--;
+                    endStreamValue( parser, chunk, captureFrom, i + 1 );
+                    break;
+                }
+                if ( c != '"' ) return failStream( parser );
+
+                {
+                    // 只有在路径上或者按key查找时才需要比较key
+                    StreamFrame *frame = &parser->frames[parser->depth - 1];
+                    parser->compareKey = NULL;
+                    if ( parser->path == NULL) {
+                        if ( parser->options == S_RECURSIVE || parser->depth == 1 ) {
+                            parser->compareKey       = parser->key;
+                            parser->compareKeyLength = parser->keyLength;
+                        }
+                    } else if ( frame->onPath && parser->depth <= parser->path->segmentCount
+                                && parser->path->segments[parser->depth - 1].type == P_KEY ) {
+                        parser->compareKey       = parser->path->segments[parser->depth - 1].key;
+                        parser->compareKeyLength = parser->path->segments[parser->depth - 1].keyLength;
+                    }
+                    parser->keyPosition = 0;
+                    parser->keyMismatch = parser->compareKey == NULL;
+                    parser->escapeNext  = false;
+                    parser->state       = ST_KEY;
+                }
+                break;
+
+            case ST_KEY:
+                if ( !parser->escapeNext && c == '"' ) {
+                    parser->frames[parser->depth - 1].keyMatched =
+                            !parser->keyMismatch && parser->keyPosition == parser->compareKeyLength;
+                    parser->state = ST_COLON;
+                    break;
+                }
+                parser->escapeNext = !parser->escapeNext && c == '\\';
+
+                // 与parseKey相同，比较转义前的原始字节
+                if ( !parser->keyMismatch ) {
+                    if ( parser->keyPosition < parser->compareKeyLength
+                         && parser->compareKey[parser->keyPosition] == c ) {
+                        parser->keyPosition++;
+                    } else {
+                        parser->keyMismatch = true;
+                    }
+                }
+                break;
+
+            case ST_COLON:
+                if ( isWhiteSpace( c )) break;
+                if ( c != ':' ) return failStream( parser );
+                parser->state = ST_VALUE;
+                break;
+
+            case ST_VALUE:
+            case ST_VALUE_OR_END: {
+                if ( isWhiteSpace( c )) break;
+                if ( c == ']' && parser->state == ST_VALUE_OR_END ) {
+                    parser->depth--;
+                    endStreamValue( parser, chunk, captureFrom, i + 1 );
+                    break;
+                }
+
+                // 已经在截取时，嵌套在结果里面的同名key不是新的结果，与macroKeyValueSearch一致
+                bool isTarget;
+                bool onPath = isStreamMemberOnPath( parser, &isTarget );
+                isTarget = isTarget && !parser->capturing;
+                if ( isTarget ) {
+                    parser->capturing     = true;
+                    parser->captureDepth  = parser->depth;
+                    parser->captureLength = 0;
+                    parser->result.offset = parser->consumed + i;
+                    captureFrom = i;
+                }
+
+                if ( c == '{' || c == '[' ) {
+                    if ( parser->depth == parser->maxDepth ) return failStream( parser );
+
+                    StreamFrame frame = { c == '{', onPath, false, 0 };
+                    parser->frames[parser->depth++] = frame;
+                    parser->state = c == '{' ? ST_KEY_OR_END : ST_VALUE_OR_END;
+                    if ( isTarget ) parser->result.valueType = c == '{' ? J_OBJ : J_ARRAY;
+                } else if ( c == '"' ) {
+                    parser->escapeNext = false;
+                    parser->state      = ST_STRING;
+                    if ( isTarget ) parser->result.valueType = J_STRING;
+                } else if ( c == '-' || isDigit( c ) || c == 't' || c == 'f' || c == 'n' ) {
+                    parser->literal[0]    = c;
+                    parser->literalLength = 1;
+                    parser->state         = ST_LITERAL;
+                } else {
+                    return failStream( parser );
+                }
+                break;
+            }
+
+            case ST_STRING:
+                if ( parser->escapeNext ) {
+                    parser->escapeNext = false;
+                    break;
+                }
+                if ( c == '\\' ) {
+                    parser->escapeNext = true;
+                    break;
+                }
+                if ( c == '"' ) endStreamValue( parser, chunk, captureFrom, i + 1 );
+                break;
+
+            case ST_LITERAL:
+                if ( !isWhiteSpace( c ) && c != ',' && c != ']' && c != '}' ) {
+                    if ( parser->literalLength == cSTREAM_LITERAL_MAX ) return failStream( parser );
+                    parser->literal[parser->literalLength++] = c;
+                    break;
+                }
+
+                // 结束符属于下一个状态，重新处理
+                endStreamLiteral( parser, chunk, captureFrom, i );
+                continue;
+
+            case ST_AFTER_VALUE: {
+                if ( isWhiteSpace( c )) break;
+
+                StreamFrame *frame = &parser->frames[parser->depth - 1];
+                if ( c == ',' ) {
+                    frame->index++;
+                    frame->keyMatched = false;
+                    parser->state     = frame->isObject ? ST_KEY_START : ST_VALUE;
+                    break;
+                }
+                if ( c != ( frame->isObject ? '}' : ']' )) return failStream( parser );
+
+                parser->depth--;
+                endStreamValue( parser, chunk, captureFrom, i + 1 );
+                break;
+            }
+
+            case ST_DONE:
+                break;
+        }
+        i++;
+    }
+
+    if ( parser->status == STREAM_NEED_MORE ) {
+        if ( parser->capturing && !appendStreamCapture( parser, chunk + captureFrom, chunkLength - captureFrom ))
+            return failStream( parser );
+        parser->consumed += chunkLength;
+    }
+
+    return parser->status;
+}
+
+StreamStatus finishStreamParser( StreamParser *parser ){
+
+    if ( parser == NULL) return STREAM_ERROR;
+    if ( parser->status != STREAM_NEED_MORE ) return parser->status;
+
+    // 根节点是数字时，只有在输入结束时才知道数字已经结束
+    if ( parser->state == ST_LITERAL && parser->depth == 0 ) {
+        endStreamLiteral( parser, NULL, 0, 0 );
+        if ( parser->status != STREAM_NEED_MORE ) return parser->status;
+    }
+
+    // 文档没有结束
+    return failStream( parser );
+}
+
+const UBYTE *streamParserResult( const StreamParser *parser, ValueSpan *span ){
+
+    if ( parser == NULL || parser->status != STREAM_FOUND ) return NOT_FOUND;
+
+    if ( span != NULL) *span = parser->result;
+    return parser->capture;
+}
+
+#define cPARALLEL_MIN_CHUNK 65536   // 每个线程至少处理的字节数
+
+/* 一个线程的查询结果，最后按线程的顺序拼接 */
+typedef struct {
+    NdjsonRecord *records;
+    size_t       count;
+    size_t       capacity;
+    bool         failed;
+} RecordList;
+
+size_t parallelThreadCount( size_t threadCount, size_t inputLength ){
+
+    if ( threadCount == 0 ) {
+        long processors = sysconf( _SC_NPROCESSORS_ONLN );
+        threadCount = processors > 0 ? (size_t) processors : 1;
+    }
+    if ( threadCount > inputLength / cPARALLEL_MIN_CHUNK ) threadCount = inputLength / cPARALLEL_MIN_CHUNK;
+    return threadCount == 0 ? 1 : threadCount;
+}
+
+/**
+ * 每个worker一个线程执行routine，全部结束后返回
+ * 第一个worker以及创建线程失败的worker由当前线程执行
+ */
+void runInParallel( void *(*routine)( void * ), void *workers, size_t workerSize, size_t count ){
+
+    pthread_t *threads = count > 1 ? (pthread_t *) calloc( count, sizeof( pthread_t )) : NULL;
+    bool      *started = count > 1 ? (bool *) calloc( count, sizeof( bool )) : NULL;
+
+    for ( size_t t = 1; t < count && threads != NULL && started != NULL; t++ ) {
+        started[t] = pthread_create( &threads[t], NULL, routine, (UBYTE *) workers + workerSize * t ) == 0;
+    }
+    routine( workers );
+
+    for ( size_t t = 1; t < count; t++ ) {
+        if ( started != NULL && started[t] ) pthread_join( threads[t], NULL );
+        else routine((UBYTE *) workers + workerSize * t );
+    }
+    free( threads );
+    free( started );
+}
+
+NdjsonRecord *appendRecord( RecordList *list ){
+
+    if ( list->count == list->capacity ) {
+        size_t       capacity = list->capacity == 0 ? 256 : list->capacity * 2;
+        NdjsonRecord *bigger  = (NdjsonRecord *) realloc( list->records, capacity * sizeof( NdjsonRecord ));
+        if ( bigger == NULL) {
+            list->failed = true;
+            return NULL;
+        }
+        list->records  = bigger;
+        list->capacity = capacity;
+    }
+    return &list->records[list->count++];
+}
+
+/* 按顺序拼接所有线程的结果，并释放每个线程的结果 */
+NdjsonRecord *mergeRecords( RecordList *lists, size_t listCount, size_t *recordCount ){
+
+    size_t total  = 0;
+    bool   failed = false;
+    for ( size_t t = 0; t < listCount; t++ ) {
+        total += lists[t].count;
+        failed = failed || lists[t].failed;
+    }
+
+    NdjsonRecord *records = failed ? NULL : (NdjsonRecord *) malloc(( total == 0 ? 1 : total ) * sizeof( NdjsonRecord ));
+
+    if ( records != NULL) {
+        *recordCount = 0;
+        for ( size_t t = 0; t < listCount; t++ ) {
+            if ( lists[t].count == 0 ) continue;
+            memcpy( records + *recordCount, lists[t].records, lists[t].count * sizeof( NdjsonRecord ));
+            *recordCount += lists[t].count;
+        }
+    }
+
+    for ( size_t t = 0; t < listCount; t++ ) free( lists[t].records );
+    return records;
+}
+
+/**
+ * 在input中[offset, offset + length)的一个值上执行查询，结果的offset为在整个input中的位置
+ * path和search都为NULL时，结果就是这个值本身
+ */
+void searchRecord( const CompiledPath *path, const Search *search, const UBYTE *input, size_t offset, size_t length,
+                   NdjsonRecord *result ){
+
+    const UBYTE *record = input + offset;
+
+    result->offset = offset;
+    result->length = length;
+
+    if ( path != NULL) {
+        compiledPathSearchSpan( path, record, length, &result->value );
+    } else if ( search != NULL) {
+        Search state = *search;
+        if ( macroKeyValueSearchSpan( record, length, &state, &result->value ) == NOT_FOUND ) {
+            ValueSpan notFound = { 0, 0, state.valueType };
+            result->value = notFound;
+        }
+    } else {
+        SearchState skip = { .valueType = J_NOT_FOUND, .options = S_NORMAL };
+        size_t      valueLength, lengthWithBlanks;
+        ValueType   valueType;
+        const UBYTE *value = parseValue( record, length, &valueLength, &lengthWithBlanks, &skip, &valueType );
+
+        ValueSpan span = { value == PARSE_ERROR ? 0 : (size_t) ( value - record ), valueLength,
+                           value == PARSE_ERROR ? J_PARSE_ERROR : valueType };
+        if ( value == PARSE_ERROR ) span.length = 0;
+        result->value = span;
+    }
+    if ( result->value.valueType != J_NOT_FOUND && result->value.valueType != J_PARSE_ERROR )
+        result->value.offset += offset;
+}
+
+/* NDJSON的一个worker，处理起始位置在[begin, end)中的记录 */
+typedef struct {
+    const CompiledPath *path;
+    const Search       *search;     // path为NULL时按key查找
+    const UBYTE        *input;
+    size_t             inputLength;
+    size_t             begin;
+    size_t             end;
+    size_t             start;       // 推测的第一条记录的起始位置
+    size_t             stop;        // 最后一条记录之后的位置
+    RecordList         *list;
+} NdjsonWorker;
+
+/* 记录的结束位置：字符串之外的第一个换行符 */
+size_t findRecordEnd( const UBYTE *input, size_t inputLength, size_t start ){
+
+    bool inString = false;
+
+    for ( size_t i = start; i < inputLength; i++ ) {
+        UBYTE c = input[i];
+        if ( inString ) {
+            if ( c == '\\' ) i++;
+            else if ( c == '"' ) inString = false;
+        } else if ( c == '"' ) {
+            inString = true;
+        } else if ( c == '\n' ) {
+            return i;
+        }
+    }
+    return inputLength;
+}
+
+void searchNdjsonRecord( NdjsonWorker *worker, size_t offset, size_t length ){
+
+    // 空行不算记录
+    size_t i = 0;
+    while ( i < length && isWhiteSpace( worker->input[offset + i] )) i++;
+    if ( i == length ) return;
+
+    NdjsonRecord *result = appendRecord( worker->list );
+    if ( result != NULL) searchRecord( worker->path, worker->search, worker->input, offset, length, result );
+}
+
+/* 从start开始处理记录，直到记录的起始位置不在worker的范围内 */
+void runNdjsonWorker( NdjsonWorker *worker, size_t start ){
+
+    size_t position = start;
+
+    worker->list->count  = 0;
+    worker->list->failed = false;
+    while ( position < worker->end && position < worker->inputLength && !worker->list->failed ) {
+        size_t recordEnd = findRecordEnd( worker->input, worker->inputLength, position );
+        searchNdjsonRecord( worker, position, recordEnd - position );
+        position = recordEnd + 1;
+    }
+    worker->stop = position < worker->end ? worker->end : position;
+}
+
+void *ndjsonWorkerThread( void *argument ){
+
+    NdjsonWorker *worker = (NdjsonWorker *) argument;
+
+    // 假设begin之后的第一个换行符不在字符串中，合并时再检查
+    size_t start = worker->begin;
+    if ( start > 0 ) {
+        const UBYTE *newline = memchr( worker->input + start - 1, '\n', worker->inputLength - start + 1 );
+        start = newline == NULL ? worker->inputLength : (size_t) ( newline - worker->input ) + 1;
+    }
+    worker->start = start;
+    runNdjsonWorker( worker, start );
+    return NULL;
+}
+
+NdjsonRecord *ndjsonSearch( const CompiledPath *path, const Search *search, const UBYTE *input, size_t inputLength,
+                            size_t threadCount, size_t *recordCount ){
+
+    threadCount = parallelThreadCount( threadCount, inputLength );
+
+    NdjsonWorker *workers = (NdjsonWorker *) calloc( threadCount, sizeof( NdjsonWorker ));
+    RecordList   *lists   = (RecordList *) calloc( threadCount, sizeof( RecordList ));
+    NdjsonRecord *records = NULL;
+
+    if ( workers != NULL && lists != NULL) {
+        for ( size_t t = 0; t < threadCount; t++ ) {
+            NdjsonWorker *worker = &workers[t];
+            worker->path        = path;
+            worker->search      = search;
+            worker->input       = input;
+            worker->inputLength = inputLength;
+            worker->begin       = inputLength / threadCount * t;
+            worker->end         = t + 1 == threadCount ? inputLength : inputLength / threadCount * ( t + 1 );
+            worker->list        = &lists[t];
+        }
+        runInParallel( ndjsonWorkerThread, workers, sizeof( NdjsonWorker ), threadCount );
+
+        // 推测的起始位置在字符串中，从上一个范围真正结束的位置重新处理
+        size_t expected = 0;
+        for ( size_t t = 0; t < threadCount; t++ ) {
+            if ( workers[t].start != expected ) runNdjsonWorker( &workers[t], expected );
+            expected = workers[t].stop;
+        }
+        records = mergeRecords( lists, threadCount, recordCount );
+    }
+
+    free( workers );
+    free( lists );
+    return records;
+}
+
+NdjsonRecord *ndjsonPathSearch( const CompiledPath *path, const UBYTE *input, size_t inputLength, size_t threadCount,
+                                size_t *recordCount ){
+    CHECK_NULL( path )
+    CHECK_NULL( input )
+    CHECK_NULL( recordCount )
+
+    return ndjsonSearch( path, NULL, input, inputLength, threadCount, recordCount );
+}
+
+NdjsonRecord *ndjsonKeySearch( const UBYTE *key, SearchOptions options, const UBYTE *input, size_t inputLength,
+                               size_t threadCount, size_t *recordCount ){
+    CHECK_NULL( key )
+    CHECK_NULL( input )
+    CHECK_NULL( recordCount )
+
+    Search search = { .pattern = (UBYTE *) key, .valueType = J_NOT_FOUND, .options = options };
+    return ndjsonSearch( NULL, &search, input, inputLength, threadCount, recordCount );
+}
+
+/* 并行扫描一个大数组时的一个worker，负责[begin, end)这一段 */
+typedef struct {
+    const CompiledPath *path;
+    const UBYTE        *input;
+    size_t             inputLength;
+    size_t             rootStart;          // 根数组'['的位置
+    size_t             begin;
+    size_t             end;
+
+    // 第一遍：假设begin处不在字符串中，统计引号的奇偶以及两种情况下的嵌套深度变化
+    bool               oddQuotes;
+    long               depthChangeOutside;
+    long               depthChangeInside;
+
+    // 第二遍：begin处真实的状态
+    bool               inString;
+    long               depth;
+    RecordList         *list;
+} ArrayWorker;
+
+void *countArrayChunk( void *argument ){
+
+    ArrayWorker *worker   = (ArrayWorker *) argument;
+    const UBYTE *input    = worker->input;
+    bool        inString  = false;
+    long        outside   = 0, inside = 0;
+
+    for ( size_t i = worker->begin; i < worker->end; i++ ) {
+        UBYTE c = input[i];
+        if ( c == '\\' ) {
+            // 分段时保证转义符和被转义的字符在同一段中
+            i++;
+        } else if ( c == '"' ) {
+            inString = !inString;
+        } else if ( c == '{' || c == '[' ) {
+            if ( inString ) inside++;
+            else outside++;
+        } else if ( c == '}' || c == ']' ) {
+            if ( inString ) inside--;
+            else outside--;
+        }
+    }
+
+    worker->oddQuotes          = inString;
+    worker->depthChangeOutside = outside;
+    worker->depthChangeInside  = inside;
+    return NULL;
+}
+
+/* 根数组中一个元素的扫描状态，用来发现元素中有多个value */
+typedef enum {
+    E_BLANK,                       // 还没有遇到value
+    E_VALUE,                       // 在数字、true、false、null中间
+    E_VALUE_END                    // value已经结束，只能是空白、','或者']'
+} ElementState;
+
+void *failArrayChunk( ArrayWorker *worker ){
+    worker->list->failed = true;
+    return NULL;
+}
+
+/**
+ * 第二遍：找到根数组中的逗号，查询起始位置在本段中的元素
+ * 根数组没有结束、之后还有其他内容或者一个元素中有多个value时，worker->list->failed为true
+ */
+void *searchArrayChunk( void *argument ){
+
+    ArrayWorker  *worker      = (ArrayWorker *) argument;
+    const UBYTE  *input       = worker->input;
+    bool         inString     = worker->inString;
+    long         depth        = worker->depth;
+    bool         hasElement   = false;       // 已经找到本段中的元素的起始位置
+    bool         afterBracket = false;       // 元素是根数组中的第一个
+    size_t       elementStart = 0;
+    ElementState element      = E_BLANK;
+    size_t       i            = worker->begin;
+
+    worker->list->count  = 0;
+    worker->list->failed = false;
+
+    // 最后一个元素可能在本段之后结束
+    for ( ; i < worker->inputLength && ( i < worker->end || hasElement ); i++ ) {
+        UBYTE c = input[i];
+        if ( inString ) {
+            if ( c == '\\' ) i++;
+            else if ( c == '"' ) {
+                inString = false;
+                if ( depth == 1 ) element = E_VALUE_END;
+            }
+            continue;
+        }
+
+        if ( isWhiteSpace( c )) {
+            if ( depth == 1 && element == E_VALUE ) element = E_VALUE_END;
+            continue;
+        }
+
+        // 根数组之前和之后只能有空白，根数组只能用']'结束
+        if (( depth <= 0 && i != worker->rootStart ) || ( depth == 1 && c == '}' )) return failArrayChunk( worker );
+
+        bool separator = depth == 1 && ( c == ',' || c == ']' );
+        if ( depth == 1 && hasElement && !separator ) {
+            // 一个元素中不能有第二个value
+            if ( element == E_VALUE_END || ( element == E_VALUE && ( c == '"' || c == '{' || c == '[' )))
+                return failArrayChunk( worker );
+            element = E_VALUE;
+        }
+
+        if ( c == '"' ) {
+            inString = true;
+        } else if ( c == '{' || c == '[' ) {
+            if ( ++depth == 1 ) {
+                hasElement   = true;
+                afterBracket = true;
+                elementStart = i + 1;
+                element      = E_BLANK;
+            }
+        } else if (( c == '}' || c == ']' ) && !separator ) {
+            if ( --depth == 1 ) element = E_VALUE_END;
+        } else if ( separator ) {
+            if ( c == ']' ) depth--;
+
+            if ( hasElement ) {
+                size_t length = i - elementStart, blanks = 0;
+                while ( blanks < length && isWhiteSpace( input[elementStart + blanks] )) blanks++;
+
+                // 空数组没有元素
+                if ( !( c == ']' && afterBracket && blanks == length )) {
+                    NdjsonRecord *result = appendRecord( worker->list );
+                    if ( result == NULL) return NULL;
+                    searchRecord( worker->path, NULL, input, elementStart, length, result );
+                }
+            }
+
+            // 根数组结束后，本段剩下的部分只能是空白
+            hasElement   = depth == 1 && i < worker->end;
+            afterBracket = false;
+            elementStart = i + 1;
+            element      = E_BLANK;
+        }
+    }
+
+    // 到了input的结尾，元素或者根数组还没有结束
+    if ( i >= worker->inputLength && ( hasElement || depth > 0 || inString )) return failArrayChunk( worker );
+    return NULL;
+}
+
+NdjsonRecord *parallelArraySearch( const CompiledPath *path, const UBYTE *input, size_t inputLength,
+                                   size_t threadCount, size_t *elementCount ){
+    CHECK_NULL( input )
+    CHECK_NULL( elementCount )
+
+    size_t start = 0;
+    while ( start < inputLength && isWhiteSpace( input[start] )) start++;
+    if ( start == inputLength || input[start] != '[' ) return PARSE_ERROR;
+
+    threadCount = parallelThreadCount( threadCount, inputLength );
+
+    ArrayWorker  *workers  = (ArrayWorker *) calloc( threadCount, sizeof( ArrayWorker ));
+    RecordList   *lists    = (RecordList *) calloc( threadCount, sizeof( RecordList ));
+    NdjsonRecord *elements = NULL;
+
+    if ( workers != NULL && lists != NULL) {
+        size_t begin = 0;
+        for ( size_t t = 0; t < threadCount; t++ ) {
+            size_t end = t + 1 == threadCount ? inputLength : inputLength / threadCount * ( t + 1 );
+            // 不在转义符之后分段，这样每一段的状态只与引号的奇偶有关
+            while ( end < inputLength && end > begin && input[end - 1] == '\\' ) end++;
+            if ( end < begin ) end = begin;
+
+            ArrayWorker *worker = &workers[t];
+            worker->path        = path;
+            worker->input       = input;
+            worker->inputLength = inputLength;
+            worker->rootStart   = start;
+            worker->begin       = begin;
+            worker->end         = end;
+            worker->list        = &lists[t];
+            begin = end;
+        }
+        runInParallel( countArrayChunk, workers, sizeof( ArrayWorker ), threadCount );
+
+        // 由每一段的统计依次推出下一段开始处是否在字符串中，以及嵌套深度
+        bool inString = false;
+        long depth    = 0;
+        for ( size_t t = 0; t < threadCount; t++ ) {
+            workers[t].inString = inString;
+            workers[t].depth    = depth;
+            depth += inString ? workers[t].depthChangeInside : workers[t].depthChangeOutside;
+            inString = inString != workers[t].oddQuotes;
+        }
+        runInParallel( searchArrayChunk, workers, sizeof( ArrayWorker ), threadCount );
+
+        elements = mergeRecords( lists, threadCount, elementCount );
+    }
+
+    free( workers );
+    free( lists );
+    return elements;
+}
+
+bool openMappedFile( const char *fileName, MappedFile *file ){
+
+    if ( fileName == NULL || file == NULL) return false;
+
+    int fd = open( fileName, O_RDONLY );
+    if ( fd < 0 ) return false;
+
+    struct stat status;
+    if ( fstat( fd, &status ) != 0 || status.st_size < 0 || (uint64_t) status.st_size > SIZE_MAX ) {
+        close( fd );
+        return false;
+    }
+
+    file->length = (size_t) status.st_size;
+    file->data   = (const UBYTE *) "";
+    if ( file->length > 0 ) {
+        void *mapping = mmap( NULL, file->length, PROT_READ, MAP_PRIVATE, fd, 0 );
+        if ( mapping == MAP_FAILED ) {
+            close( fd );
+            return false;
+        }
+        // 查询基本上都是从头到尾扫描一次，让内核尽早预读并回收已经读过的页
+        madvise( mapping, file->length, MADV_SEQUENTIAL );
+        file->data = (const UBYTE *) mapping;
+    }
+
+    // 映射之后不再需要文件描述符
+    close( fd );
+    return true;
+}
+
+void closeMappedFile( MappedFile *file ){
+
+    if ( file == NULL) return;
+
+    if ( file->length > 0 ) munmap((void *) file->data, file->length );
+    file->data   = NULL;
+    file->length = 0;
+}
+
+const UBYTE *mappedFileKeySearch( const MappedFile *file, Search *search, ValueSpan *span ){
+    CHECK_NULL( file )
+
+    return macroKeyValueSearchSpan( file->data, file->length, search, span );
+}
+
+const UBYTE *mappedFilePathSearch( const MappedFile *file, Search *search, ValueSpan *span ){
+    CHECK_NULL( file )
+
+    return marcoPathSearchSpanWithLength( file->data, file->length, search, span );
+}
+
+bool initArrayIterator( ArrayIterator *iterator, const UBYTE *input, size_t inputLength ){
+
+    if ( iterator == NULL) return false;
+
+    size_t i = 0;
+    while ( input != NULL && i < inputLength && isWhiteSpace( input[i] )) i++;
+
+    iterator->input       = input;
+    iterator->inputLength = inputLength;
+    iterator->position    = i + 1;
+    iterator->index       = 0;
+    iterator->finished    = input == NULL || i == inputLength || input[i] != '[';
+    return !iterator->finished;
+}
+
+bool nextArrayElement( ArrayIterator *iterator, ValueSpan *span ){
+
+    ValueSpan result = { 0, 0, J_NOT_FOUND };
+    if ( span != NULL) *span = result;
+
+    if ( iterator == NULL || iterator->finished ) return false;
+
+    const UBYTE *input = iterator->input;
+    size_t      i      = iterator->position;
+
+    while ( i < iterator->inputLength && isWhiteSpace( input[i] )) i++;
+
+    // 空数组
+    if ( iterator->index == 0 && i < iterator->inputLength && input[i] == ']' ) {
+        iterator->position = i + 1;
+        iterator->finished = true;
+        return false;
+    }
+
+    result.valueType = J_PARSE_ERROR;
+
+    SearchState skip = { .valueType = J_NOT_FOUND, .options = S_NORMAL };
+    size_t      length, lengthWithBlanks;
+    ValueType   valueType;
+    const UBYTE *value = parseValue( input + i, iterator->inputLength - i, &length, &lengthWithBlanks, &skip,
+                                     &valueType );
+
+    if ( value != PARSE_ERROR) {
+        size_t end = i + lengthWithBlanks;
+        if ( end < iterator->inputLength && ( input[end] == ',' || input[end] == ']' )) {
+            result.offset = (size_t) ( value - input );
+            result.length = length;
+            result.valueType = valueType;
+
+            iterator->position = end + 1;
+            iterator->finished = input[end] == ']';
+            iterator->index++;
+        } else {
+            value = PARSE_ERROR;
+        }
+    }
+
+    if ( value == PARSE_ERROR) iterator->finished = true;
+    if ( span != NULL) *span = result;
+    return value != PARSE_ERROR;
+}
+
+struct ArrayIndex {
+    const UBYTE *input;            // 不拷贝input，使用index期间input需要保持有效
+    size_t      inputLength;
+    size_t      count;
+    size_t      capacity;
+    ValueSpan   elements[];
+};
+
+ArrayIndex *buildArrayIndex( const UBYTE *input, size_t inputLength ){
+
+    ArrayIterator iterator;
+    if ( !initArrayIterator( &iterator, input, inputLength )) return PARSE_ERROR;
+
+    // 大约每16个字节一个元素，不够时再扩展
+    size_t     capacity = inputLength / 16 + 16;
+    ArrayIndex *index   = (ArrayIndex *) malloc( sizeof( ArrayIndex ) + sizeof( ValueSpan ) * capacity );
+    CHECK_NULL( index )
+
+    index->input       = input;
+    index->inputLength = inputLength;
+    index->count       = 0;
+    index->capacity    = capacity;
+
+    ValueSpan span;
+    while ( nextArrayElement( &iterator, &span )) {
+        if ( index->count == index->capacity ) {
+            ArrayIndex *bigger = (ArrayIndex *) realloc( index, sizeof( ArrayIndex )
+                                                                + sizeof( ValueSpan ) * index->capacity * 2 );
+            if ( bigger == NULL) {
+                free( index );
+                return NULL;
+            }
+            index           = bigger;
+            index->capacity = index->capacity * 2;
+        }
+        index->elements[index->count++] = span;
+    }
+
+    // 与parseArrayByIndex一致，数组之后只能有空白
+    size_t end = iterator.position;
+    while ( span.valueType != J_PARSE_ERROR && end < inputLength && isWhiteSpace( input[end] )) end++;
+
+    if ( span.valueType == J_PARSE_ERROR || end < inputLength ) {
+        free( index );
+        return PARSE_ERROR;
+    }
+
+    // 去掉多余的空间
+    ArrayIndex *fitted = (ArrayIndex *) realloc( index, sizeof( ArrayIndex ) + sizeof( ValueSpan ) * index->count );
+    if ( fitted != NULL) {
+        index           = fitted;
+        index->capacity = index->count;
+    }
+    return index;
+}
+
+void freeArrayIndex( ArrayIndex *index ){
+    free( index );
+}
+
+size_t arrayIndexCount( const ArrayIndex *index ){
+    return index == NULL ? 0 : index->count;
+}
+
+const UBYTE *arrayIndexInput( const ArrayIndex *index ){
+    return index == NULL ? NULL : index->input;
+}
+
+const UBYTE *arrayIndexSearch( const ArrayIndex *index, size_t position, ValueSpan *span ){
+
+    ValueSpan result = { 0, 0, index == NULL ? J_PARSE_ERROR : J_NOT_FOUND };
+
+    if ( index != NULL && position < index->count ) result = index->elements[position];
+    if ( span != NULL) *span = result;
+
+    return result.valueType == J_NOT_FOUND || result.valueType == J_PARSE_ERROR ? NOT_FOUND
+                                                                                : index->input + result.offset;
+}
+
+/* 对象索引中的一个key，parent为cNO_NODE时表示递归查找时第一次出现的位置 */
+typedef struct {
+    uint64_t hash;
+    size_t   parent;
+    size_t   keyNode;              // cNO_NODE: 空位
+} KeySlot;
+
+struct ObjectIndex {
+    JsonTape *tape;
+    bool     valid;                // input符合RFC 8259，用于Search.strict
+    size_t   *levelStarts;         // levelStarts[d]: 第一个嵌套在d层之内的object或array，用于Search.maxDepth
+    size_t   levelCount;
+    size_t   slotMask;             // slot个数减1，slot个数是2的幂
+    KeySlot  slots[];
+};
+
+size_t keySlotPosition( uint64_t hash, size_t parent ){
+    return (size_t) ( hash ^ ((uint64_t) parent * 0x9E3779B97F4A7C15ull ));
+}
+
+/* 查找parent下的key，找不到返回cNO_NODE */
+size_t findKeySlot( const ObjectIndex *index, size_t parent, const UBYTE *key, size_t keyLength, uint64_t hash ){
+
+    const TapeNode *nodes = index->tape->nodes;
+    const UBYTE    *input = index->tape->input;
+
+    for ( size_t i = keySlotPosition( hash, parent ) & index->slotMask;; i = ( i + 1 ) & index->slotMask ) {
+        const KeySlot *slot = &index->slots[i];
+        if ( slot->keyNode == cNO_NODE ) return cNO_NODE;
+
+        const TapeNode *keyNode = &nodes[slot->keyNode];
+        if ( slot->hash == hash && slot->parent == parent && keyNode->length - 2 == keyLength
+             && memcmp( input + keyNode->offset + 1, key, keyLength ) == 0 )
+            return slot->keyNode;
+    }
+}
+
+/* 同一个parent下重复的key只保留第一个 */
+void insertKeySlot( ObjectIndex *index, size_t parent, size_t keyNode ){
+
+    const TapeNode *node   = &index->tape->nodes[keyNode];
+    const UBYTE    *key    = index->tape->input + node->offset + 1;
+    size_t         length  = node->length - 2;
+    uint64_t       hash    = hashKey( key, length );
+
+    if ( findKeySlot( index, parent, key, length, hash ) != cNO_NODE ) return;
+
+    size_t i = keySlotPosition( hash, parent ) & index->slotMask;
+    while ( index->slots[i].keyNode != cNO_NODE ) i = ( i + 1 ) & index->slotMask;
+
+    KeySlot slot = { hash, parent, keyNode };
+    index->slots[i] = slot;
+}
+
+ObjectIndex *buildObjectIndex( const UBYTE *input, size_t inputLength ){
+
+    JsonTape *tape = buildTape( input, inputLength );
+    CHECK_NULL( tape )
+
+    size_t keyCount = 0;
+    for ( size_t node = 0; node < tape->nodeCount; node++ ) keyCount += tape->nodes[node].isKey;
+
+    // 每个key最多两个slot，负载不超过一半
+    size_t slotCount = 16;
+    while ( slotCount < keyCount * 4 ) slotCount *= 2;
+
+    ObjectIndex *index  = (ObjectIndex *) malloc( sizeof( ObjectIndex ) + sizeof( KeySlot ) * slotCount );
+    size_t      *parents = (size_t *) malloc( sizeof( size_t ) * ( tape->nodeCount + 1 ));
+    if ( index == NULL || parents == NULL) {
+        free( index );
+        free( parents );
+        freeTape( tape );
+        return NULL;
+    }
+
+    index->tape        = tape;
+    index->valid       = validateJson( input, inputLength, NULL);
+    index->levelStarts = NULL;
+    index->levelCount  = 0;
+    index->slotMask    = slotCount - 1;
+    for ( size_t i = 0; i < slotCount; i++ ) index->slots[i].keyNode = cNO_NODE;
+
+    // 节点按照在input中出现的顺序排列，用栈记录当前所在的object或array
+    size_t depth = 0, levelCapacity = 0;
+    for ( size_t node = 0; node < tape->nodeCount; node++ ) {
+        while ( depth > 0 && node >= tape->nodes[parents[depth - 1]].next ) depth--;
+
+        const TapeNode *value = &tape->nodes[node];
+        if ( value->isKey ) {
+            insertKeySlot( index, cNO_NODE, node );
+            insertKeySlot( index, parents[depth - 1], node );
+        } else if ( value->valueType == J_OBJ || value->valueType == J_ARRAY ) {
+            // 第一次到达这一层的节点就是这一层最早出现的节点
+            if ( depth == index->levelCount ) {
+                if ( !reserveBuffer((void **) &index->levelStarts, &levelCapacity, depth + 1, sizeof( size_t ))) {
+                    free( parents );
+                    free( index->levelStarts );
+                    free( index );
+                    freeTape( tape );
+                    return NULL;
+                }
+                index->levelStarts[index->levelCount++] = node;
+            }
+            parents[depth++] = node;
+        }
+    }
+
+    free( parents );
+    return index;
+}
+
+void freeObjectIndex( ObjectIndex *index ){
+
+    if ( index == NULL) return;
+
+    freeTape( index->tape );
+    free( index->levelStarts );
+    free( index );
+}
+
+const UBYTE *objectIndexInput( const ObjectIndex *index ){
+    return index == NULL ? NULL : tapeInput( index->tape );
+}
+
+/* 在node的下一层中查找segment，key使用hash，下标使用tape */
+size_t objectIndexChild( const ObjectIndex *index, size_t node, const PathSegment *segment, uint64_t hash ){
+
+    if ( segment->type == P_INDEX ) return tapeChild( index->tape, node, segment );
+    if ( index->tape->nodes[node].valueType != J_OBJ ) return cNO_NODE;
+
+    size_t keyNode = findKeySlot( index, node, segment->key, segment->keyLength, hash );
+    return keyNode == cNO_NODE ? cNO_NODE : keyNode + 1;
+}
+
+/**
+ * unescapeKey时按在input中的顺序比较反转义后的key，S_NORMAL只比较根object的key
+ * 没有转义符的key反转义后不变，hash已经找到了其中第一个，只需要逐个比较带转义符的key
+ * @param candidate hash找到的key节点，cNO_NODE: 没有找到
+ */
+size_t findUnescapedKey( const ObjectIndex *index, bool recursive, const UBYTE *key, size_t keyLength,
+                         size_t candidate ){
+
+    const TapeNode *nodes = index->tape->nodes;
+    const UBYTE    *input = index->tape->input;
+    size_t         end    = recursive ? index->tape->nodeCount : nodes[0].next;
+
+    for ( size_t node = 1; node < end; node = recursive ? node + 1 : nodes[node + 1].next ) {
+        const TapeNode *keyNode = &nodes[node];
+        if ( !keyNode->isKey ) continue;
+
+        const UBYTE *rawKey    = input + keyNode->offset + 1;
+        size_t      rawLength  = keyNode->length - 2;
+        if ( memchr( rawKey, '\\', rawLength ) == NULL) {
+            if ( node == candidate ) return node;
+        } else if ( isSameUnescapedKey( rawKey, rawLength, key, keyLength )) {
+            return node;
+        }
+    }
+    return cNO_NODE;
+}
+
+const UBYTE *objectIndexSearch( const ObjectIndex *index, Search *search, ValueSpan *span ){
+
+    if ( search == NULL) return tapeError( J_PATTERN_WRONG_FORMAT, span );
+    if ( search->pattern == NULL) {
+        search->valueType = J_PATTERN_WRONG_FORMAT;
+        return tapeError( J_PATTERN_WRONG_FORMAT, span );
+    }
+    if ( index == NULL || ( search->strict && !index->valid )) {
+        search->valueType = J_PARSE_ERROR;
+        return tapeError( J_PARSE_ERROR, span );
+    }
+
+    const UBYTE *key       = search->pattern;
+    size_t      keyLength  = strlen((const char *) key );
+    uint64_t    hash       = hashKey( key, keyLength );
+    bool        recursive  = search->options == S_RECURSIVE;
+    size_t      keyNode    = cNO_NODE;
+
+    if ( recursive || index->tape->nodes[0].valueType == J_OBJ ) {
+        keyNode = findKeySlot( index, recursive ? cNO_NODE : 0, key, keyLength, hash );
+        if ( search->unescapeKey ) keyNode = findUnescapedKey( index, recursive, key, keyLength, keyNode );
+    }
+
+    // 线性查找在结果结束之前遇到超过maxDepth的object或array时出错，找不到时会遇到所有的节点
+    if ( recursive ) {
+        size_t maxDepth = search->maxDepth == 0 ? cSEARCH_DEPTH_DEFAULT : search->maxDepth;
+        size_t end      = keyNode == cNO_NODE ? index->tape->nodeCount : index->tape->nodes[keyNode + 1].next;
+        if ( maxDepth < index->levelCount && index->levelStarts[maxDepth] < end ) {
+            search->valueType        = J_PARSE_ERROR;
+            search->keyFoundInObject = false;
+            return tapeError( J_PARSE_ERROR, span );
+        }
+    }
+
+    size_t      node = keyNode == cNO_NODE ? cNO_NODE : keyNode + 1;
+    ValueSpan   result;
+    const UBYTE *value = tapeNodeResult( index->tape, node, &result );
+
+    search->valueType        = result.valueType;
+    search->keyFoundInObject = node != cNO_NODE;
+    if ( span != NULL) *span = result;
+    return value;
+}
+
+const UBYTE *objectIndexCompiledPathSearch( const ObjectIndex *index, const CompiledPath *path, ValueSpan *span ){
+
+    if ( index == NULL) return tapeError( J_PARSE_ERROR, span );
+    if ( path == NULL) return tapeError( J_PATTERN_WRONG_FORMAT, span );
+
+    size_t node = 0;
+    for ( size_t i = 0; i < path->segmentCount && node != cNO_NODE; i++ ) {
+        node = objectIndexChild( index, node, &path->segments[i], path->segments[i].hash );
+    }
+    return tapeNodeResult( index->tape, node, span );
+}
+
+/* 已经找到但是还不能回调的匹配，外层匹配的value结束之前，里面的匹配需要等外层先回调 */
+typedef struct {
+    size_t    pathOffset;          // 路径在MatchWalk.pendingPaths中的位置，以0结尾
+    size_t    pathLength;
+    ValueSpan span;
+    bool      complete;            // value已经结束，span.length有效
+} PendingMatch;
+
+/* 查找所有匹配的key时的状态 */
+typedef struct {
+    const UBYTE     *input;
+    size_t          inputLength;
+    const UBYTE     *key;
+    size_t          keyLength;
+    size_t          maxResults;
+    size_t          maxDepth;
+    size_t          matchCount;    // 已经回调的个数
+    size_t          recordCount;   // 已经找到的个数，包括还在等待的
+    KeyMatchHandler handler;
+    void            *context;
+    bool            stopped;       // 回调要求停止或者已经达到maxResults
+    UBYTE           *path;         // 当前value的路径，格式同marcoPathSearch
+    size_t          pathLength;
+    size_t          pathCapacity;
+    PendingMatch    *pending;      // 按在input中出现的顺序排列
+    size_t          pendingCount;
+    size_t          pendingFirst;  // 第一个还没有回调的
+    size_t          pendingCapacity;
+    UBYTE           *pendingPaths;
+    size_t          pendingPathsLength;
+    size_t          pendingPathsCapacity;
+} MatchWalk;
+
+/* macroKeyValueSearchAll中每一层object或array的状态 */
+typedef struct {
+    bool   isObject;
+    size_t count;                  // 已经结束的成员个数
+    size_t pathLength;             // 这一层的路径长度，每个成员结束后恢复
+    size_t match;                  // 这一层本身是匹配的value时在pending中的下标，否则为cNO_MATCH
+} MatchFrame;
+
+const size_t cNO_MATCH = (size_t) -1;
+
+bool pushMatchPath( MatchWalk *walk, const char *prefix, const UBYTE *text, size_t textLength, const char *suffix ){
+
+    size_t needed = walk->pathLength + strlen( prefix ) + textLength + strlen( suffix ) + 1;
+    if ( !reserveBuffer((void **) &walk->path, &walk->pathCapacity, needed, 1 )) return false;
+
+    UBYTE *end = walk->path + walk->pathLength;
+    memcpy( end, prefix, strlen( prefix ));
+    memcpy( end + strlen( prefix ), text, textLength );
+    memcpy( end + strlen( prefix ) + textLength, suffix, strlen( suffix ) + 1 );
+    walk->pathLength = needed - 1;
+    return true;
+}
+
+/**
+ * 记录一个从offset开始的匹配，路径为当前的walk->path
+ * @return 在pending中的下标，内存不足返回cNO_MATCH
+ */
+size_t addPendingMatch( MatchWalk *walk, size_t offset ){
+
+    if ( !reserveBuffer((void **) &walk->pending, &walk->pendingCapacity, walk->pendingCount + 1,
+                        sizeof( PendingMatch ))
+         || !reserveBuffer((void **) &walk->pendingPaths, &walk->pendingPathsCapacity,
+                           walk->pendingPathsLength + walk->pathLength + 1, 1 ))
+        return cNO_MATCH;
+
+    PendingMatch match = { walk->pendingPathsLength, walk->pathLength, { offset, 0, J_NOT_FOUND }, false };
+    memcpy( walk->pendingPaths + walk->pendingPathsLength, walk->path, walk->pathLength + 1 );
+    walk->pendingPathsLength += walk->pathLength + 1;
+    walk->pending[walk->pendingCount] = match;
+    walk->recordCount++;
+    return walk->pendingCount++;
+}
+
+/* 匹配的value结束，按顺序回调前面所有已经结束的匹配 */
+void completeMatch( MatchWalk *walk, size_t match, size_t end, ValueType valueType ){
+
+    PendingMatch *pending = &walk->pending[match];
+    pending->span.length    = end - pending->span.offset;
+    pending->span.valueType = valueType;
+    pending->complete       = true;
+
+    while ( walk->pendingFirst < walk->pendingCount && walk->pending[walk->pendingFirst].complete ) {
+        PendingMatch *first = &walk->pending[walk->pendingFirst++];
+        walk->matchCount++;
+        if ( !walk->handler( walk->context, walk->pendingPaths + first->pathOffset, first->pathLength, &first->span )
+             || walk->matchCount == walk->maxResults ) {
+            walk->stopped = true;
+            return;
+        }
+    }
+
+    // 全部回调之后清空
+    if ( walk->pendingFirst == walk->pendingCount ) {
+        walk->pendingFirst       = 0;
+        walk->pendingCount       = 0;
+        walk->pendingPathsLength = 0;
+    }
+}
+
+/**
+ * object中的下一个key或者array中的下一个元素，更新路径，i移动到value的起始位置
+ * @param matched 返回key是否匹配
+ */
+bool startMatchMember( MatchWalk *walk, MatchFrame *frame, size_t *i, bool *matched ){
+
+    const UBYTE *input       = walk->input;
+    size_t      inputLength  = walk->inputLength;
+    size_t      j            = *i;
+
+    if ( frame->isObject ) {
+        size_t keyLength = parseString( input + j, inputLength - j );
+        if ( keyLength == (size_t) PARSE_ERROR) return false;
+
+        *matched = keyLength - 2 == walk->keyLength && memcmp( input + j + 1, walk->key, walk->keyLength ) == 0;
+        if ( !pushMatchPath( walk, ".", input + j + 1, keyLength - 2, "" )) return false;
+
+        j += keyLength;
+        while ( j < inputLength && isWhiteSpace( input[j] )) j++;
+        if ( j >= inputLength || input[j] != ':' ) return false;
+        j++;
+    } else {
+        char index[32];
+        sprintf( index, "%zu", frame->count );
+        if ( !pushMatchPath( walk, "[", (const UBYTE *) index, strlen( index ), "]" )) return false;
+        *matched = false;
+    }
+
+    while ( j < inputLength && isWhiteSpace( input[j] )) j++;
+    *i = j;
+    return true;
+}
+
+/**
+ * 按在input中出现的顺序查找所有匹配的key，匹配的value中也继续查找
+ * 用显式的栈代替递归，匹配的value只扫描一次：里面的匹配先记录下来，等value结束、外层回调之后再按顺序回调
+ * @param i 根节点在input中的位置，之前没有空白
+ * @return 格式错误或者内存不足返回false，停止时walk->stopped为true
+ */
+bool walkMatches( MatchWalk *walk, size_t i ){
+
+    MatchFrame  stackFrames[cSEARCH_FRAMES_ON_STACK];
+    MatchFrame  *frames     = stackFrames;
+    size_t      capacity    = cSEARCH_FRAMES_ON_STACK;
+    size_t      depth       = 0;
+    bool        matched     = false;     // input[i]是匹配的key的value
+    bool        ok          = false;
+    const UBYTE *input      = walk->input;
+    size_t      inputLength = walk->inputLength;
+
+    while ( !walk->stopped ) {
+
+        // 达到maxResults之后不再记录新的匹配，只等待已经记录的value结束
+        size_t match = cNO_MATCH;
+        if ( matched && walk->recordCount < walk->maxResults ) {
+            match = addPendingMatch( walk, i );
+            if ( match == cNO_MATCH ) break;
+        }
+
+        UBYTE c = i < inputLength ? input[i] : cENDING;
+        if (( c == '{' || c == '[' ) && depth < walk->maxDepth ) {
+            if ( depth == capacity ) {
+                // 超过栈上的层数时才在堆上分配
+                MatchFrame *bigger = frames == stackFrames ? NULL : frames;
+                if ( !reserveBuffer((void **) &bigger, &capacity, depth + 1, sizeof( MatchFrame ))) break;
+                if ( frames == stackFrames ) memcpy( bigger, stackFrames, sizeof( stackFrames ));
+                frames = bigger;
+            }
+
+            MatchFrame frame = { c == '{', 0, walk->pathLength, match };
+            frames[depth++] = frame;
+            i++;
+            while ( i < inputLength && isWhiteSpace( input[i] )) i++;
+
+            // 非空的object或array，进入第一个成员
+            if ( i >= inputLength || input[i] != ( c == '{' ? '}' : ']' )) {
+                if ( !startMatchMember( walk, &frames[depth - 1], &i, &matched )) break;
+                continue;
+            }
+            i++;
+            depth--;
+            if ( match != cNO_MATCH ) completeMatch( walk, match, i, c == '{' ? J_OBJ : J_ARRAY );
+        } else {
+            // 超过深度的子树以及基本类型直接跳过
+            SearchState skip = { .valueType = J_NOT_FOUND, .options = S_NORMAL };
+            size_t      length, lengthWithBlanks;
+            ValueType   valueType;
+            if ( parseValue( input + i, inputLength - i, &length, &lengthWithBlanks, &skip, &valueType )
+                 == PARSE_ERROR)
+                break;
+            i += length;
+            if ( match != cNO_MATCH ) completeMatch( walk, match, i, valueType );
+        }
+        matched = false;
+
+        // 一个value刚刚结束，移动到下一个成员，或者结束所在的object和array
+        bool nextMember = false;
+        while ( depth > 0 && !walk->stopped ) {
+            MatchFrame *frame = &frames[depth - 1];
+            walk->pathLength = frame->pathLength;
+            walk->path[walk->pathLength] = cENDING;
+            frame->count++;
+
+            while ( i < inputLength && isWhiteSpace( input[i] )) i++;
+            if ( i < inputLength && input[i] == ',' ) {
+                i++;
+                while ( i < inputLength && isWhiteSpace( input[i] )) i++;
+                nextMember = true;
+                break;
+            }
+            if ( i >= inputLength || input[i] != ( frame->isObject ? '}' : ']' )) break;
+
+            i++;
+            depth--;
+            if ( frame->match != cNO_MATCH ) completeMatch( walk, frame->match, i, frame->isObject ? J_OBJ : J_ARRAY );
+        }
+
+        if ( nextMember ) {
+            if ( !startMatchMember( walk, &frames[depth - 1], &i, &matched )) break;
+            continue;
+        }
+        if ( depth == 0 ) ok = true;
+
+        // 根节点结束，或者格式错误
+        break;
+    }
+
+    if ( frames != stackFrames ) free( frames );
+    return ok || walk->stopped;
+}
+
+bool macroKeyValueSearchAll( const UBYTE *input, size_t inputLength, const UBYTE *key, size_t maxResults,
+                             size_t maxDepth, KeyMatchHandler handler, void *context, size_t *matchCount ){
+
+    if ( matchCount != NULL) *matchCount = 0;
+    if ( input == NULL || key == NULL || handler == NULL) return false;
+
+    MatchWalk walk;
+    memset( &walk, 0, sizeof( walk ));
+    walk.input       = input;
+    walk.inputLength = inputLength;
+    walk.key         = key;
+    walk.keyLength   = strlen((const char *) key );
+    walk.maxResults  = maxResults == 0 ? SIZE_MAX : maxResults;
+    walk.maxDepth    = maxDepth == 0 ? cSEARCH_DEPTH_DEFAULT : maxDepth;
+    walk.handler     = handler;
+    walk.context     = context;
+    if ( !pushMatchPath( &walk, "", (const UBYTE *) "", 0, "" )) return false;
+
+    size_t i = 0;
+    while ( i < inputLength && isWhiteSpace( input[i] )) i++;
+
+    bool ok = walkMatches( &walk, i );
+
+    free( walk.path );
+    free( walk.pending );
+    free( walk.pendingPaths );
+    if ( matchCount != NULL) *matchCount = walk.matchCount;
+    return ok;
+}
+
+/* 创建后不再修改，可以在多个线程中同时使用 */
+struct Query {
+    CompiledPath  *path;           // NULL: 按key查找
+    SearchOptions options;
+    QueryFlags    flags;
+    size_t        keyLength;
+    UBYTE         key[];           // 以0结尾的key的拷贝
+};
+
+Query *createKeyQuery( const UBYTE *key, SearchOptions options, QueryFlags flags ){
+
+    if ( key == NULL) return PATTERN_WRONG_FORMAT;
+
+    size_t keyLength = strlen((const char *) key );
+    Query  *query    = (Query *) malloc( sizeof( Query ) + keyLength + 1 );
+    CHECK_NULL( query )
+
+    query->path      = NULL;
+    query->options   = options;
+    query->flags     = flags;
+    query->keyLength = keyLength;
+    memcpy( query->key, key, keyLength + 1 );
+    return query;
+}
+
+Query *createPathQuery( const UBYTE *pattern, QueryFlags flags ){
+
+    CompiledPath *path = compilePath( pattern );
+    if ( path == NULL) return PATTERN_WRONG_FORMAT;
+
+    Query *query = (Query *) malloc( sizeof( Query ) + 1 );
+    if ( query == NULL) {
+        freeCompiledPath( path );
+        return NULL;
+    }
+
+    query->path      = path;
+    query->options   = S_NORMAL;
+    query->flags     = flags;
+    query->keyLength = 0;
+    query->key[0]    = cENDING;
+    return query;
+}
+
+void freeQuery( Query *query ){
+
+    if ( query == NULL) return;
+    freeCompiledPath( query->path );
+    free( query );
+}
+
+const UBYTE *queryValueSpan( const Query *query, const UBYTE *input, size_t inputLength, ValueSpan *span ){
+
+    ValueSpan result = { 0, 0, J_PARSE_ERROR };
+
+    if ( query == NULL) {
+        result.valueType = J_PATTERN_WRONG_FORMAT;
+    } else if ( input != NULL && ( !( query->flags & Q_STRICT ) || validateJson( input, inputLength, NULL))) {
+
+        // 所有的状态都在栈上，query只读
+        if ( query->path != NULL) return compiledPathSearchSpan( query->path, input, inputLength, span );
+
+        SearchState state       = { .pattern = query->key, .patternLength = query->keyLength,
+                                    .valueType = J_NOT_FOUND, .options = query->options,
+                                    .unescapeKey = ( query->flags & Q_UNESCAPE_KEY ) != 0 };
+        const UBYTE *valueBegin = searchKeyState( input, inputLength, &state, span );
+        if ( valueBegin != NULL) return valueBegin;
+        result.valueType = state.valueType;
+    }
+
+    if ( span != NULL) *span = result;
+    return NULL;
+}
+
+void *queryValueInArena( Arena *arena, const Query *query, const UBYTE *input, size_t inputLength,
+                         ValueType *valueType ){
+
+    ValueSpan   span;
+    const UBYTE *valueBegin = queryValueSpan( query, input, inputLength, &span );
+    if ( valueType != NULL) *valueType = span.valueType;
+    if ( valueBegin == NULL) return NULL;
+
+    return getCheckedValueBySpan( arena, input, &span, valueType );
+}
+
+void *queryValue( const Query *query, const UBYTE *input, size_t inputLength, ValueType *valueType ){
+
+    return queryValueInArena( NULL, query, input, inputLength, valueType );
+}
+
+bool initCursor( JsonCursor *cursor, const UBYTE *input, size_t inputLength ){
+
+    if ( cursor == NULL) return false;
+
+    size_t i = 0;
+    while ( input != NULL && i < inputLength && isWhiteSpace( input[i] )) i++;
+
+    cursor->input        = input;
+    cursor->inputLength  = inputLength;
+    cursor->position     = i;
+    cursor->depth        = 0;
+    cursor->pendingValue = input != NULL && i < inputLength;
+    cursor->failed       = !cursor->pendingValue;
+    return !cursor->failed;
+}
+
+bool failCursor( JsonCursor *cursor ){
+    cursor->failed       = true;
+    cursor->pendingValue = false;
+    return false;
+}
+
+ValueType peekCursorType( const JsonCursor *cursor ){
+
+    if ( cursor == NULL || cursor->failed ) return J_PARSE_ERROR;
+    if ( !cursor->pendingValue ) return J_NOT_FOUND;
+
+    // 只看第一个字节，不解析
+    switch ( cVALUE_CLASS[cursor->input[cursor->position]] ) {
+        case C_OBJECT: return J_OBJ;
+        case C_ARRAY: return J_ARRAY;
+        case C_STRING: return J_STRING;
+        case C_TRUE: return J_TRUE;
+        case C_FALSE: return J_FALSE;
+        case C_NULL: return J_NULL;
+        case C_NUMBER: {
+            int    type;
+            size_t length = parseNumber( cursor->input + cursor->position, cursor->inputLength - cursor->position,
+                                         &type );
+            if ( length == (size_t) PARSE_ERROR) return J_PARSE_ERROR;
+            return type == J_INT ? J_INT : J_FLOAT;
+        }
+        default: return J_PARSE_ERROR;
+    }
+}
+
+bool readCursorValue( JsonCursor *cursor, ValueSpan *span ){
+
+    if ( cursor == NULL || cursor->failed || !cursor->pendingValue ) return false;
+
+    const UBYTE *input      = cursor->input + cursor->position;
+    size_t      rest        = cursor->inputLength - cursor->position;
+    ValueClass  valueClass  = (ValueClass) cVALUE_CLASS[input[0]];
+    ValueType   valueType;
+    size_t      length;
+
+    if ( valueClass == C_OBJECT || valueClass == C_ARRAY ) {
+        length    = scanValue( input, rest );
+        valueType = valueClass == C_OBJECT ? J_OBJ : J_ARRAY;
+    } else {
+        length = parseScalar( input, rest, valueClass, &valueType );
+    }
+    if ( length == (size_t) PARSE_ERROR) return failCursor( cursor );
+
+    if ( span != NULL) {
+        span->offset    = cursor->position;
+        span->length    = length;
+        span->valueType = valueType;
+    }
+    cursor->position += length;
+    cursor->pendingValue = false;
+    return true;
+}
+
+bool skipCursorValue( JsonCursor *cursor ){
+    return readCursorValue( cursor, NULL );
+}
+
+bool enterCursor( JsonCursor *cursor, CursorScope *scope ){
+
+    if ( cursor == NULL || scope == NULL || cursor->failed || !cursor->pendingValue ) return false;
+
+    UBYTE c = cursor->input[cursor->position];
+    if ( c != '{' && c != '[' ) return false;
+
+    cursor->position++;
+    cursor->depth++;
+    cursor->pendingValue = false;
+
+    scope->depth    = cursor->depth;
+    scope->isObject = c == '{';
+    scope->first    = true;
+    scope->finished = false;
+    return true;
+}
+
+/**
+ * 跳过没有读完的下层object和array，回到depth层
+ * 只区分字符串和括号，不检查其中的语法，已经进入的层只计数，不检查括号的种类
+ */
+bool skipCursorTo( JsonCursor *cursor, size_t depth ){
+
+    if ( cursor->pendingValue && !skipCursorValue( cursor )) return false;
+
+    const UBYTE *input = cursor->input;
+    size_t      i      = cursor->position;
+
+    while ( cursor->depth > depth ) {
+        if ( i >= cursor->inputLength ) return failCursor( cursor );
+
+        // 没有进入的string、object和array整个跳过，scanValue会检查括号的种类
+        UBYTE c = input[i];
+        if ( c == '"' || c == '{' || c == '[' ) {
+            size_t length = scanValue( input + i, cursor->inputLength - i );
+            if ( length == (size_t) PARSE_ERROR) return failCursor( cursor );
+            i += length;
+            continue;
+        }
+        if ( c == '}' || c == ']' ) cursor->depth--;
+        i++;
+    }
+
+    cursor->position = i;
+    return true;
+}
+
+/**
+ * 移动到scope中的下一个成员，之前没有读完的value和下层直接跳过
+ * @return 有下一个成员时返回true，cursor指向成员的value
+ */
+bool nextCursorMember( JsonCursor *cursor, CursorScope *scope, StringView *key ){
+
+    if ( cursor == NULL || scope == NULL || cursor->failed || scope->finished ) return false;
+    if ( cursor->depth < scope->depth ) return failCursor( cursor );
+    if (( cursor->depth > scope->depth || cursor->pendingValue ) && !skipCursorTo( cursor, scope->depth ))
+        return false;
+
+    const UBYTE *input = cursor->input;
+    size_t      length = cursor->inputLength;
+    size_t      i      = cursor->position;
+
+    while ( i < length && isWhiteSpace( input[i] )) i++;
+    if ( i >= length ) return failCursor( cursor );
+
+    if ( input[i] == ( scope->isObject ? '}' : ']' )) {
+        cursor->position = i + 1;
+        cursor->depth--;
+        scope->finished = true;
+        return false;
+    }
+
+    if ( !scope->first ) {
+        if ( input[i] != ',' ) return failCursor( cursor );
+        i++;
+        while ( i < length && isWhiteSpace( input[i] )) i++;
+    }
+    scope->first = false;
+
+    if ( scope->isObject ) {
+        size_t keyLength = parseString( input + i, length - i );
+        if ( keyLength == (size_t) PARSE_ERROR) return failCursor( cursor );
+        if ( key != NULL) {
+            key->data   = input + i + 1;
+            key->length = keyLength - 2;
+        }
+
+        i += keyLength;
+        while ( i < length && isWhiteSpace( input[i] )) i++;
+        if ( i >= length || input[i] != ':' ) return failCursor( cursor );
+        i++;
+        while ( i < length && isWhiteSpace( input[i] )) i++;
+    }
+    if ( i >= length ) return failCursor( cursor );
+
+    cursor->position     = i;
+    cursor->pendingValue = true;
+    return true;
+}
+
+bool nextCursorField( JsonCursor *cursor, CursorScope *scope, StringView *key ){
+
+    if ( scope != NULL && !scope->isObject ) return cursor != NULL && failCursor( cursor );
+    return nextCursorMember( cursor, scope, key );
+}
+
+bool nextCursorElement( JsonCursor *cursor, CursorScope *scope ){
+
+    if ( scope != NULL && scope->isObject ) return cursor != NULL && failCursor( cursor );
+    return nextCursorMember( cursor, scope, NULL);
+}
+
+bool initWriter( JsonWriter *writer, void *buffer, size_t capacity ){
+
+    if ( writer == NULL) return false;
+
+    writer->ownsBuffer = buffer == NULL;
+    writer->length     = 0;
+    writer->needComma  = false;
+    writer->failed     = false;
+
+    if ( buffer == NULL) {
+        capacity = capacity == 0 ? 256 : capacity;
+        buffer   = malloc( capacity );
+        if ( buffer == NULL) capacity = 0;
+    }
+    writer->buffer   = (UBYTE *) buffer;
+    writer->capacity = capacity;
+    writer->failed   = buffer == NULL;
+    return !writer->failed;
+}
+
+void releaseWriter( JsonWriter *writer ){
+
+    if ( writer == NULL) return;
+
+    if ( writer->ownsBuffer ) free( writer->buffer );
+    writer->buffer   = NULL;
+    writer->capacity = 0;
+    writer->length   = 0;
+}
+
+/* 保证还能写入extra个字节，调用方提供的buffer不扩容 */
+bool reserveWriter( JsonWriter *writer, size_t extra ){
+
+    if ( writer->failed ) return false;
+    if ( extra <= writer->capacity - writer->length ) return true;
+    if ( !writer->ownsBuffer ) {
+        writer->failed = true;
+        return false;
+    }
+
+    size_t capacity = writer->capacity * 2;
+    while ( capacity - writer->length < extra ) capacity *= 2;
+
+    UBYTE *bigger = (UBYTE *) realloc( writer->buffer, capacity );
+    if ( bigger == NULL) {
+        writer->failed = true;
+        return false;
+    }
+    writer->buffer   = bigger;
+    writer->capacity = capacity;
+    return true;
+}
+
+bool appendWriter( JsonWriter *writer, const void *data, size_t length ){
+
+    if ( !reserveWriter( writer, length )) return false;
+    memcpy( writer->buffer + writer->length, data, length );
+    writer->length += length;
+    return true;
+}
+
+/* 同一层中第二个开始的成员前面加',' */
+bool beginWriterValue( JsonWriter *writer, size_t extra ){
+
+    if ( writer == NULL || !reserveWriter( writer, extra + 1 )) return false;
+    if ( writer->needComma ) writer->buffer[writer->length++] = ',';
+    writer->needComma = true;
+    return true;
+}
+
+bool writeContainerStart( JsonWriter *writer, UBYTE open ){
+
+    if ( !beginWriterValue( writer, 1 )) return false;
+    writer->buffer[writer->length++] = open;
+    writer->needComma = false;
+    return true;
+}
+
+bool writeContainerEnd( JsonWriter *writer, UBYTE close ){
+
+    if ( writer == NULL || !reserveWriter( writer, 1 )) return false;
+    writer->buffer[writer->length++] = close;
+    writer->needComma = true;
+    return true;
+}
+
+bool writeObjectStart( JsonWriter *writer ){
+    return writeContainerStart( writer, '{' );
+}
+
+bool writeObjectEnd( JsonWriter *writer ){
+    return writeContainerEnd( writer, '}' );
+}
+
+bool writeArrayStart( JsonWriter *writer ){
+    return writeContainerStart( writer, '[' );
+}
+
+bool writeArrayEnd( JsonWriter *writer ){
+    return writeContainerEnd( writer, ']' );
+}
+
+/**
+ * 写入带双引号的字符串，不需要转义的部分用findStringSpecial整段找到后直接拷贝
+ */
+bool appendEscapedString( JsonWriter *writer, const UBYTE *text, size_t length ){
+
+    static const char cHEX[] = "0123456789abcdef";
+
+    if ( !appendWriter( writer, "\"", 1 )) return false;
+
+    size_t i = 0;
+    while ( true ) {
+        size_t run = findStringSpecial( text + i, length - i );
+        if ( !appendWriter( writer, text + i, run )) return false;
+        i += run;
+        if ( i == length ) break;
+
+        UBYTE c = text[i++];
+        char  escaped[6] = { '\\', (char) c, 0, 0, 0, 0 };
+        size_t escapedLength = 2;
+        switch ( c ) {
+            case '"':
+            case '\\': break;
+            case '\b': escaped[1] = 'b'; break;
+            case '\f': escaped[1] = 'f'; break;
+            case '\n': escaped[1] = 'n'; break;
+            case '\r': escaped[1] = 'r'; break;
+            case '\t': escaped[1] = 't'; break;
+            default:
+                // 其余的控制字符
+                escaped[1]    = 'u';
+                escaped[2]    = '0';
+                escaped[3]    = '0';
+                escaped[4]    = cHEX[c >> 4];
+                escaped[5]    = cHEX[c & 0xF];
+                escapedLength = 6;
+                break;
+        }
+        if ( !appendWriter( writer, escaped, escapedLength )) return false;
+    }
+
+    return appendWriter( writer, "\"", 1 );
+}
+
+bool writeKey( JsonWriter *writer, const UBYTE *key, size_t keyLength ){
+
+    if ( key == NULL || !beginWriterValue( writer, keyLength + 3 )) return false;
+    if ( !appendEscapedString( writer, key, keyLength ) || !appendWriter( writer, ":", 1 )) return false;
+
+    // key后面紧跟value，不需要','
+    writer->needComma = false;
+    return true;
+}
+
+bool writeString( JsonWriter *writer, const UBYTE *text, size_t length ){
+
+    if ( text == NULL || !beginWriterValue( writer, length + 2 )) return false;
+    return appendEscapedString( writer, text, length );
+}
+
+/**
+ * 把value按十进制写入output的末尾，每次处理两位
+ * @return 写入的长度，最多20个字节
+ */
+size_t formatUint64( uint64_t value, char *output ){
+
+    static const char cDIGIT_PAIRS[] =
+            "00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+            "40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+            "8081828384858687888990919293949596979899";
+
+    char   digits[20];
+    size_t position = sizeof( digits );
+    while ( value >= 100 ) {
+        unsigned pair = (unsigned) ( value % 100 ) * 2;
+        value /= 100;
+        digits[--position] = cDIGIT_PAIRS[pair + 1];
+        digits[--position] = cDIGIT_PAIRS[pair];
+    }
+    if ( value >= 10 ) {
+        digits[--position] = cDIGIT_PAIRS[value * 2 + 1];
+        digits[--position] = cDIGIT_PAIRS[value * 2];
+    } else {
+        digits[--position] = (char) ( '0' + value );
+    }
+
+    size_t length = sizeof( digits ) - position;
+    memcpy( output, digits + position, length );
+    return length;
+}
+
+bool writeInt64( JsonWriter *writer, int64_t value ){
+
+    char   text[21];
+    size_t length = 0;
+    if ( value < 0 ) text[length++] = '-';
+    length += formatUint64( value < 0 ? 0 - (uint64_t) value : (uint64_t) value, text + length );
+
+    return beginWriterValue( writer, length ) && appendWriter( writer, text, length );
+}
+
+/**
+ * 格式化double，保证strtod后得到相同的值
+ * 小数位不超过cWRITE_FRACTION_MAX的数字先放大成整数再输出，不需要snprintf
+ * @return 写入的长度
+ */
+#define cWRITE_FRACTION_MAX 9
+
+size_t formatDouble( double value, char *output ){
+
+    static const double cPOW10[cWRITE_FRACTION_MAX + 1] = { 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9 };
+    const double cEXACT_MAX = 9007199254740992.0;   // 2^53，以内的整数都可以精确表示
+
+    size_t length   = 0;
+    double absolute = fabs( value );
+    if ( signbit( value )) output[length++] = '-';
+    if ( absolute == 0 ) {
+        output[length++] = '0';
+        return length;
+    }
+
+    // 最少的小数位，放大后的整数除回去与原来的值相同时，这个十进制表示也会被strtod转换回原来的值
+    for ( int fraction = 0; fraction <= cWRITE_FRACTION_MAX; fraction++ ) {
+        double scaled = absolute * cPOW10[fraction];
+        if ( scaled >= cEXACT_MAX ) break;
+
+        double rounded = nearbyint( scaled );
+        if ( rounded / cPOW10[fraction] != absolute ) continue;
+
+        char     digits[20];
+        size_t   digitCount = formatUint64((uint64_t) rounded, digits );
+        if ( (size_t) fraction >= digitCount ) {
+            // 0.05这样整数部分为0的数字
+            output[length++] = '0';
+            output[length++] = '.';
+            for ( size_t i = digitCount; i < (size_t) fraction; i++ ) output[length++] = '0';
+            memcpy( output + length, digits, digitCount );
+            return length + digitCount;
+        }
+
+        size_t integerCount = digitCount - (size_t) fraction;
+        memcpy( output + length, digits, integerCount );
+        length += integerCount;
+        if ( fraction > 0 ) {
+            output[length++] = '.';
+            memcpy( output + length, digits + integerCount, (size_t) fraction );
+            length += (size_t) fraction;
+        }
+        return length;
+    }
+
+    // 很大、很小或者有效位数很多的数字，使用能够还原的最短精度
+    for ( int precision = 15; precision <= 17; precision++ ) {
+        int written = snprintf( output + length, 32, "%.*g", precision, absolute );
+        if ( precision == 17 || strtod( output + length, NULL) == absolute ) return length + (size_t) written;
+    }
+    return length;
+}
+
+bool writeDouble( JsonWriter *writer, double value ){
+
+    // JSON中没有NaN和Infinity
+    if ( isnan( value ) || isinf( value )) return writeNull( writer );
+
+    char   text[40];
+    size_t length = formatDouble( value, text );
+    return beginWriterValue( writer, length ) && appendWriter( writer, text, length );
+}
+
+bool writeBool( JsonWriter *writer, bool value ){
+    return beginWriterValue( writer, 5 ) && appendWriter( writer, value ? "true" : "false", value ? 4 : 5 );
+}
+
+bool writeNull( JsonWriter *writer ){
+    return beginWriterValue( writer, 4 ) && appendWriter( writer, "null", 4 );
+}
+
+bool writeSpan( JsonWriter *writer, const UBYTE *input, const ValueSpan *span ){
+
+    if ( input == NULL || span == NULL || span->valueType == J_NOT_FOUND || span->valueType == J_PARSE_ERROR
+         || span->valueType == J_PATTERN_WRONG_FORMAT )
+        return false;
+
+    return beginWriterValue( writer, span->length ) && appendWriter( writer, input + span->offset, span->length );
+}
+
+/**
+ * 找到路径前count段对应的value，count为0时为根节点
+ * @param valueLength count大于0时返回到input结束为止的长度，之后用游标遍历，遇到value的结尾就停止
+ * @return value的类型，找不到或出错时为J_NOT_FOUND/J_PARSE_ERROR
+ */
+ValueType locatePathPrefix( const CompiledPath *path, size_t count, const UBYTE *input, size_t inputLength,
+                            const UBYTE **value, size_t *valueLength ){
+
+    if ( count > 0 ) {
+        *value       = input;
+        *valueLength = inputLength;
+
+        ValueType valueType = J_PARSE_ERROR;
+        for ( size_t i = 0; i < count; i++ ) {
+            valueType = searchPathSegment( value, valueLength, &path->segments[i], false );
+            if ( valueType == J_PARSE_ERROR || valueType == J_NOT_FOUND ) break;
+        }
+        return valueType;
+    }
+
+    SearchState skip = { .valueType = J_NOT_FOUND, .options = S_NORMAL };
+    size_t      lengthWithBlanks;
+    ValueType   valueType;
+    *value = parseValue( input, inputLength, valueLength, &lengthWithBlanks, &skip, &valueType );
+    return *value == PARSE_ERROR ? J_PARSE_ERROR : valueType;
+}
+
+/* 补丁中的一段 */
+void addPatchPart( PatchResult *result, const UBYTE *data, size_t length ){
+    StringView part = { data, length };
+    result->parts[result->partCount++] = part;
+}
+
+bool failPatch( PatchResult *result, ValueType valueType ){
+    result->partCount = 0;
+    result->valueType = valueType;
+    return false;
+}
+
+bool patchJson( const UBYTE *input, size_t inputLength, const UBYTE *pattern, PatchOperation operation,
+                const UBYTE *value, size_t valueLength, PatchResult *result ){
+
+    if ( result == NULL) return false;
+    result->partCount = 0;
+    if ( input == NULL) return failPatch( result, J_PARSE_ERROR );
+
+    CompiledPath *path = compilePath( pattern );
+    if ( path == NULL || path->segmentCount == 0 || ( operation != PATCH_DELETE && value == NULL)) {
+        freeCompiledPath( path );
+        return failPatch( result, J_PATTERN_WRONG_FORMAT );
+    }
+
+    // 只定位到目标所在的object或array，其余部分不解析
+    const PathSegment *last = &path->segments[path->segmentCount - 1];
+    const UBYTE       *parent;
+    size_t            parentLength;
+    ValueType         parentType = locatePathPrefix( path, path->segmentCount - 1, input, inputLength, &parent,
+                                                     &parentLength );
+    bool              isObject   = last->type == P_KEY;
+    size_t            keyLength  = last->keyLength;
+
+    if ( parentType != ( isObject ? J_OBJ : J_ARRAY )) {
+        freeCompiledPath( path );
+        return failPatch( result, parentType == J_PARSE_ERROR ? J_PARSE_ERROR : J_NOT_FOUND );
+    }
+    // 插入的key原样写入，必须已经是转义后的形式
+    if ( operation == PATCH_INSERT_KEY && ( !isObject || !isEscapedStringContent( last->key, keyLength ))) {
+        freeCompiledPath( path );
+        return failPatch( result, J_PATTERN_WRONG_FORMAT );
+    }
+
+    // 在parent中逐个移动到目标成员，记录它前后的位置
+    JsonCursor  cursor;
+    CursorScope scope        = { 0, false, false, false };
+    StringView  key;
+    ValueSpan   span         = { 0, 0, J_NOT_FOUND };
+    size_t      index        = 0;
+    size_t      previousEnd  = 0;     // 上一个成员value的结尾，0: 没有上一个成员
+    bool        found        = false;
+    size_t      memberStart  = 0;
+
+    initCursor( &cursor, parent, parentLength );
+    enterCursor( &cursor, &scope );
+    while ( isObject ? nextCursorField( &cursor, &scope, &key ) : nextCursorElement( &cursor, &scope )) {
+        memberStart = isObject ? (size_t) ( key.data - 1 - parent ) : cursor.position;
+        found       = isObject ? key.length == last->keyLength && memcmp( key.data, last->key, key.length ) == 0
+                               : index++ == last->index;
+        if ( !readCursorValue( &cursor, &span ) || found ) break;
+        previousEnd = cursor.position;
+    }
+
+    // 插入的key直接指向调用方的pattern，与编译后的拷贝位置相同
+    const UBYTE *newKey     = isObject ? pattern + ( last->key - path->pattern ) : NULL;
+    size_t      base        = (size_t) ( parent - input );
+    freeCompiledPath( path );
+    if ( cursor.failed ) return failPatch( result, J_PARSE_ERROR );
+
+    if ( operation == PATCH_INSERT_KEY ) {
+        // key已经存在时不插入
+        if ( found ) return failPatch( result, span.valueType );
+
+        // 插入到'}'之前
+        size_t close = base + cursor.position - 1;
+        addPatchPart( result, input, close );
+        addPatchPart( result, (const UBYTE *) ( previousEnd == 0 ? "\"" : ",\"" ), previousEnd == 0 ? 1 : 2 );
+        addPatchPart( result, newKey, keyLength );
+        addPatchPart( result, (const UBYTE *) "\":", 2 );
+        addPatchPart( result, value, valueLength );
+        addPatchPart( result, input + close, inputLength - close );
+        result->valueType = J_OBJ;
+        return true;
+    }
+
+    if ( !found ) return failPatch( result, J_NOT_FOUND );
+    result->valueType = span.valueType;
+
+    if ( operation == PATCH_SET ) {
+        addPatchPart( result, input, base + span.offset );
+        addPatchPart( result, value, valueLength );
+        addPatchPart( result, input + base + span.offset + span.length,
+                      inputLength - base - span.offset - span.length );
+        return true;
+    }
+
+    // 删除时连同一个','一起删除: 后面还有成员时删到下一个成员之前，否则从上一个成员的结尾开始删
+    size_t     removeFrom = memberStart, removeTo = cursor.position;
+    StringView nextKey;
+    if ( nextCursorMember( &cursor, &scope, &nextKey )) {
+        removeTo = isObject ? (size_t) ( nextKey.data - 1 - parent ) : cursor.position;
+    } else if ( cursor.failed ) {
+        return failPatch( result, J_PARSE_ERROR );
+    } else if ( previousEnd != 0 ) {
+        removeFrom = previousEnd;
+    }
+
+    addPatchPart( result, input, base + removeFrom );
+    addPatchPart( result, input + base + removeTo, inputLength - base - removeTo );
+    return true;
+}
+
+UBYTE *joinPatch( const PatchResult *result, size_t *length ){
+
+    if ( result == NULL || result->partCount == 0 ) return NULL;
+
+    size_t total = 0;
+    for ( size_t i = 0; i < result->partCount; i++ ) total += result->parts[i].length;
+
+    UBYTE *output = (UBYTE *) malloc( total + 1 );
+    CHECK_NULL( output )
+
+    UBYTE *end = output;
+    for ( size_t i = 0; i < result->partCount; i++ ) {
+        memcpy( end, result->parts[i].data, result->parts[i].length );
+        end += result->parts[i].length;
+    }
+    *end = cENDING;
+
+    if ( length != NULL) *length = total;
+    return output;
+}
@@ -6,9 +6,18 @@
 #define UNTITLED_MAIN_H
 
 #include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
 
 #define UBYTE unsigned char
 
+/* 动态库只导出这里声明的接口，parseKey、parseString等内部函数不导出 */
+#if defined( __GNUC__ ) && !defined( _WIN32 )
+#define JSON_API __attribute__(( visibility( "default" )))
+#else
+#define JSON_API
+#endif
+
 /* Json Object Type */
 typedef enum {
     J_PARSE_ERROR          = -1000,
@@ -33,13 +42,176 @@ typedef enum {
     S_RECURSIVE
 } SearchOptions;
 
+/* unescapeKey: true时先对文档中的key反转义再与pattern比较，"caf\u00e9"可以用"café"找到
+ *              对macroKeyValueSearch系列和objectIndexSearch有效，默认false，直接比较原始字节
+ * strict:      true时先用validateJson检查整个input，不符合RFC 8259时返回J_PARSE_ERROR
+ *              对macroKeyValueSearch、marcoPathSearch系列和objectIndexSearch有效，默认false，只检查查找经过的部分
+ * maxDepth:    S_RECURSIVE查找时最多进入几层object或array，超过时返回J_PARSE_ERROR，0表示使用默认值1024
+ *              查找不递归，嵌套的深度只影响堆上分配的内存，不会使线程的栈溢出
+ */
 typedef struct {
     UBYTE         *pattern;
     ValueType     valueType;
     bool          keyFoundInObject;
     SearchOptions options;
+    bool          unescapeKey;
+    bool          strict;
+    size_t        maxDepth;
 } Search;
 
+/* 查询结果在原始input中的位置，不做任何拷贝
+ * offset:    value在input中的起始偏移
+ * length:    value的长度，string包含左右双引号
+ * valueType: value的类型
+ */
+typedef struct {
+    size_t    offset;
+    size_t    length;
+    ValueType valueType;
+} ValueSpan;
+
+/* NDJSON中一条记录的查询结果
+ * offset, length: 记录在input中的位置，不包含换行符
+ * value:          查询结果，offset为在整个input中的位置
+ */
+typedef struct {
+    size_t    offset;
+    size_t    length;
+    ValueSpan value;
+} NdjsonRecord;
+
+/* 数组元素的迭代器，不分配内存，见initArrayIterator */
+typedef struct {
+    const UBYTE *input;
+    size_t      inputLength;
+    size_t      position;          // 下一个元素开始查找的位置
+    size_t      index;             // 下一个元素的下标
+    bool        finished;
+} ArrayIterator;
+
+/* 数组中所有元素的位置，见buildArrayIndex */
+typedef struct ArrayIndex ArrayIndex;
+
+/* 以hash查找key的对象索引，见buildObjectIndex */
+typedef struct ObjectIndex ObjectIndex;
+
+/**
+ * macroKeyValueSearchAll的回调，每找到一个匹配的key调用一次
+ * @param path 匹配的value的路径，格式同marcoPathSearch，以0结尾，只在回调期间有效
+ * @param span 匹配的value在input中的位置
+ * @return 返回false时停止查找
+ */
+typedef bool (*KeyMatchHandler)( void *context, const UBYTE *path, size_t pathLength, const ValueSpan *span );
+
+/* 映射到内存中的只读文件，见openMappedFile
+ * data:   文件内容，不以0结尾
+ * length: 文件的长度
+ */
+typedef struct {
+    const UBYTE *data;
+    size_t      length;
+} MappedFile;
+
+/* 按需遍历整个文档的游标，只向前移动，不分配内存，见initCursor
+ * pendingValue: position指向一个还没有读取的value
+ * failed:       格式错误或者使用顺序错误，之后的操作都返回false
+ */
+typedef struct {
+    const UBYTE *input;
+    size_t      inputLength;
+    size_t      position;
+    size_t      depth;             // 已经进入的object和array的层数
+    bool        pendingValue;
+    bool        failed;
+} JsonCursor;
+
+/* enterCursor进入的一个object或array */
+typedef struct {
+    size_t depth;
+    bool   isObject;
+    bool   first;                  // 还没有读取过成员
+    bool   finished;               // 已经读到结束符
+} CursorScope;
+
+/* 指向input中的一段字节，不以0结尾 */
+typedef struct {
+    const UBYTE *data;
+    size_t      length;
+} StringView;
+
+/* 编译后的路径，见compilePath */
+typedef struct CompiledPath CompiledPath;
+
+/* createKeyQuery/createPathQuery创建的只读查询，可以在多个线程中同时使用 */
+typedef struct Query Query;
+
+/* 查询选项，可以组合使用 */
+typedef enum {
+    Q_NONE         = 0,
+    Q_UNESCAPE_KEY = 1,            // 同Search.unescapeKey，只对key查询有效
+    Q_STRICT       = 2             // 同Search.strict
+} QueryFlags;
+
+/* 编译后的多个路径，见compilePathSet */
+typedef struct PathSet PathSet;
+
+/* 解析一次后的文档索引，见buildTape */
+typedef struct JsonTape JsonTape;
+
+/* 流式解析器，见createStreamPathParser */
+typedef struct StreamParser StreamParser;
+
+typedef enum {
+    STREAM_NEED_MORE,              // 还没有结果，需要继续feed
+    STREAM_FOUND,                  // 找到目标，见streamParserResult
+    STREAM_NOT_FOUND,              // 文档已经结束，没有找到
+    STREAM_ERROR                   // 格式错误、嵌套过深或者结果超长
+} StreamStatus;
+
+/* 结果使用的arena，见initArena */
+typedef struct ArenaBlock ArenaBlock;
+
+typedef struct {
+    UBYTE      *buffer;
+    size_t     capacity;
+    size_t     used;
+    bool       ownsBuffer;     // buffer是否由initArena分配
+    ArenaBlock *overflow;      // buffer不够用时额外分配的内存，resetArena时释放
+} Arena;
+
+/* 输出JSON的writer，见initWriter
+ * buffer:    输出的内容，不以0结尾
+ * needComma: 当前层已经有成员，下一个成员前需要','
+ * failed:    调用方提供的buffer写满或者内存不足，之后的写入都返回false
+ */
+typedef struct {
+    UBYTE  *buffer;
+    size_t length;
+    size_t capacity;
+    bool   ownsBuffer;             // buffer是否由initWriter分配，写满时可以扩容
+    bool   needComma;
+    bool   failed;
+} JsonWriter;
+
+/* patchJson的操作 */
+typedef enum {
+    PATCH_SET,                     // 替换路径指向的value
+    PATCH_DELETE,                  // 删除路径指向的key或数组元素，连同一个','
+    PATCH_INSERT_KEY               // 在路径的上一层object的最后插入路径最后一段的key
+} PatchOperation;
+
+#define cPATCH_PARTS_MAX 6
+
+/* 打补丁后的文档，按顺序拼接parts即可，每一段指向原来的input、调用方的value或者常量，不拷贝
+ * 可以直接转换成struct iovec用writev输出，或者用joinPatch拼接成一个buffer
+ * valueType: 成功时为被替换或删除的value的类型，PATCH_INSERT_KEY为J_OBJ；失败时见patchJson
+ */
+typedef struct {
+    StringView parts[cPATCH_PARTS_MAX];
+    size_t     partCount;
+    ValueType  valueType;
+} PatchResult;
+
 /** public interface **/
 
 /**
@@ -50,11 +222,77 @@ typedef struct {
  *  [1].data[2]                     -->代表根节点下的数据格式是数组，取数组第2个元素中key名称为data的数据为数组的第3个value
  *  .user[2].anotherKey             -->代表根节点数据格式为对象，其中key为user的数组中第三个元素的key为anotherKey的value
  *
+ * 下标超出数组的长度与key不存在一样，search->valueType为J_NOT_FOUND
+ *
  * @param input
  * @param search
  * @return 查询结果的内容，需要手动释放指针
  */
-void *marcoPathSearch( const UBYTE *input, Search *search );
+JSON_API void *marcoPathSearch( const UBYTE *input, Search *search );
+
+/**
+ * 与marcoPathSearch相同的路径查找，但是每一跳都直接在原始input中进行，不拷贝中间的object或array
+ * 查找结果以span的形式返回，指向原始input，需要的时候再用getValueBySpan拷贝最终结果
+ *
+ * @param input
+ * @param search
+ * @param span   用于返回结果的位置，可以为NULL
+ * @return 结果在input中的起始位置，不需要释放；找不到或者出错返回NULL，具体见search->valueType
+ */
+JSON_API const UBYTE *marcoPathSearchSpan( const UBYTE *input, Search *search, ValueSpan *span );
+
+/**
+ * 将span指向的value按照类型拷贝出来
+ * @param input 与查找时相同的input
+ * @param span
+ * @return 查询结果的内容，需要手动释放指针
+ */
+JSON_API void *getValueBySpan( const UBYTE *input, const ValueSpan *span );
+
+/**
+ * 以上接口要求input以0结尾，并且长度不超过100K
+ * 以下WithLength接口以inputLength界定input的范围，不要求以0结尾，也没有长度限制，可以直接在网络buffer上查找
+ */
+
+/**
+ * 同macroKeyValueSearch
+ * @param input
+ * @param inputLength input的长度
+ * @param search
+ * @return 查询结果的内容, 需要手动释放指针
+ */
+JSON_API void *macroKeyValueSearchWithLength( const UBYTE *input, size_t inputLength, Search *search );
+
+/**
+ * 同macroKeyValueSearchWithLength，但是不拷贝结果，以span的形式返回
+ * @param input
+ * @param inputLength input的长度
+ * @param search
+ * @param span        用于返回结果的位置，可以为NULL
+ * @return 结果在input中的起始位置，不需要释放；找不到或者出错返回NULL，具体见search->valueType
+ */
+JSON_API const UBYTE *macroKeyValueSearchSpan( const UBYTE *input, size_t inputLength, Search *search,
+                                              ValueSpan *span );
+
+/**
+ * 同marcoPathSearch
+ * @param input
+ * @param inputLength input的长度
+ * @param search
+ * @return 查询结果的内容，需要手动释放指针
+ */
+JSON_API void *marcoPathSearchWithLength( const UBYTE *input, size_t inputLength, Search *search );
+
+/**
+ * 同marcoPathSearchSpan
+ * @param input
+ * @param inputLength input的长度
+ * @param search
+ * @param span   用于返回结果的位置，可以为NULL
+ * @return 结果在input中的起始位置，不需要释放；找不到或者出错返回NULL，具体见search->valueType
+ */
+JSON_API const UBYTE *marcoPathSearchSpanWithLength( const UBYTE *input, size_t inputLength, Search *search,
+                                                    ValueSpan *span );
 
 /**
  * 提供Key的search方法，支持当前层和Recursive查找
@@ -62,6 +300,577 @@ void *marcoPathSearch( const UBYTE *input, Search *search );
  * @param search
  * @return 查询结果的内容, 需要手动释放指针
  */
-void *macroKeyValueSearch( const UBYTE *input, Search *search );
+JSON_API void *macroKeyValueSearch( const UBYTE *input, Search *search );
+
+/**
+ * 将路径编译成可以重复使用的查询对象，路径格式同marcoPathSearch
+ * key和下标只在编译时解析一次，之后每次查找都不再分配内存
+ * 编译后的对象不会被修改，可以在多个线程中同时使用
+ *
+ * @param pattern 以0结尾的路径
+ * @return 编译后的路径，需要用freeCompiledPath释放；格式错误返回NULL
+ */
+JSON_API CompiledPath *compilePath( const UBYTE *pattern );
+
+/**
+ * 释放compilePath返回的对象
+ * @param path
+ */
+JSON_API void freeCompiledPath( CompiledPath *path );
+
+/**
+ * 使用编译后的路径查找，不拷贝任何内容
+ * @param path
+ * @param input
+ * @param inputLength input的长度
+ * @param span        用于返回结果的位置以及类型(找不到或出错时为J_NOT_FOUND/J_PARSE_ERROR)，可以为NULL
+ * @return 结果在input中的起始位置，不需要释放；找不到或者出错返回NULL
+ */
+JSON_API const UBYTE *compiledPathSearchSpan( const CompiledPath *path, const UBYTE *input, size_t inputLength,
+                                              ValueSpan *span );
+
+/**
+ * 使用编译后的路径查找，并拷贝结果
+ * @param path
+ * @param input
+ * @param inputLength input的长度
+ * @param valueType   用于返回结果的类型，可以为NULL
+ * @return 查询结果的内容，需要手动释放指针
+ */
+JSON_API void *compiledPathSearch( const CompiledPath *path, const UBYTE *input, size_t inputLength,
+                                  ValueType *valueType );
+
+/**
+ * 将多个路径编译成一棵trie，相同的前缀共用节点，路径格式同marcoPathSearch
+ * 编译后的对象不会被修改，可以在多个线程中同时使用
+ *
+ * @param patterns     以0结尾的路径数组
+ * @param patternCount 路径个数
+ * @return 编译后的路径集合，需要用freePathSet释放；任何一个路径格式错误返回NULL
+ */
+JSON_API PathSet *compilePathSet( const UBYTE **patterns, size_t patternCount );
+
+/**
+ * 释放compilePathSet返回的对象
+ * @param set
+ */
+JSON_API void freePathSet( PathSet *set );
+
+/**
+ * 从左到右只扫描一次input，同时查找集合中的所有路径
+ * 没有路径经过的value直接跳过，所有路径都找到后立即结束
+ * 同一个key出现多次时，以第一次出现的为准
+ *
+ * @param set
+ * @param input
+ * @param inputLength input的长度
+ * @param spans       长度为patternCount的数组，按照编译时的顺序返回每个路径的结果
+ *                    找不到的为J_NOT_FOUND，解析出错时还没有找到的为J_PARSE_ERROR
+ * @return 找到的路径个数
+ */
+JSON_API size_t pathSetSearch( const PathSet *set, const UBYTE *input, size_t inputLength, ValueSpan *spans );
+
+/**
+ * 将整个input解析一次，生成扁平的tape索引，之后的查找不再需要重新解析input
+ * 每个节点记录类型、在input中的位置、长度、子节点个数，以及跳过整个子树后的下一个节点
+ * tape不拷贝input，使用期间input需要保持有效；用显式的栈解析，嵌套的深度不受调用栈的限制
+ *
+ * @param input
+ * @param inputLength input的长度
+ * @return tape，需要用freeTape释放；解析错误返回NULL
+ */
+JSON_API JsonTape *buildTape( const UBYTE *input, size_t inputLength );
+
+/**
+ * 释放buildTape返回的对象
+ * @param tape
+ */
+JSON_API void freeTape( JsonTape *tape );
+
+/**
+ * @param tape
+ * @return 生成tape时的input
+ */
+JSON_API const UBYTE *tapeInput( const JsonTape *tape );
+
+/**
+ * 在tape中按key查找，语义同macroKeyValueSearch
+ * @param tape
+ * @param key     以0结尾的key
+ * @param options S_NORMAL只查找根节点，S_RECURSIVE返回第一个出现的key
+ * @param span    用于返回结果的位置以及类型，可以为NULL
+ * @return 结果在input中的起始位置，不需要释放；找不到或者出错返回NULL
+ */
+JSON_API const UBYTE *tapeKeySearch( const JsonTape *tape, const UBYTE *key, SearchOptions options, ValueSpan *span );
+
+/**
+ * 在tape中按下标查找，语义同parseArrayByIndex
+ * @param tape
+ * @param index 以0为开始的下标
+ * @param span  用于返回结果的位置以及类型，可以为NULL
+ * @return 结果在input中的起始位置，不需要释放；找不到或者出错返回NULL
+ */
+JSON_API const UBYTE *tapeIndexSearch( const JsonTape *tape, size_t index, ValueSpan *span );
+
+/**
+ * 在tape中按路径查找，语义同marcoPathSearch
+ * @param tape
+ * @param pattern 以0结尾的路径
+ * @param span    用于返回结果的位置以及类型，可以为NULL
+ * @return 结果在input中的起始位置，不需要释放；找不到或者出错返回NULL
+ */
+JSON_API const UBYTE *tapePathSearch( const JsonTape *tape, const UBYTE *pattern, ValueSpan *span );
+
+/**
+ * 在tape中按编译后的路径查找
+ * @param tape
+ * @param path
+ * @param span 用于返回结果的位置以及类型，可以为NULL
+ * @return 结果在input中的起始位置，不需要释放；找不到或者出错返回NULL
+ */
+JSON_API const UBYTE *tapeCompiledPathSearch( const JsonTape *tape, const CompiledPath *path, ValueSpan *span );
+
+/**
+ * 初始化arena，之后查询结果都从arena中顺序分配，不需要逐个释放
+ * 处理完一批查询后调用一次resetArena即可回收所有结果
+ *
+ * @param arena
+ * @param buffer   调用方提供的内存；NULL: 由arena分配capacity大小的内存
+ * @param capacity buffer的大小，不够用时arena会额外分配，resetArena时释放
+ * @return false: 分配内存失败
+ */
+JSON_API bool initArena( Arena *arena, void *buffer, size_t capacity );
+
+/**
+ * 从arena中分配内存，按8字节对齐
+ * @param arena NULL: 使用malloc
+ * @param size
+ * @return 分配的内存，不需要单独释放
+ */
+JSON_API void *arenaAlloc( Arena *arena, size_t size );
+
+/**
+ * 回收arena中分配的所有内存，之前返回的结果都不再有效
+ * @param arena
+ */
+JSON_API void resetArena( Arena *arena );
+
+/**
+ * 释放arena自己分配的所有内存
+ * @param arena
+ */
+JSON_API void releaseArena( Arena *arena );
+
+/**
+ * 以下InArena接口同对应的接口，但是结果分配在arena中，不需要手动释放
+ * arena为NULL时与原接口相同
+ */
+JSON_API void *getValueBySpanInArena( Arena *arena, const UBYTE *input, const ValueSpan *span );
+
+JSON_API void *macroKeyValueSearchInArena( Arena *arena, const UBYTE *input, size_t inputLength, Search *search );
+
+JSON_API void *marcoPathSearchInArena( Arena *arena, const UBYTE *input, size_t inputLength, Search *search );
+
+JSON_API void *compiledPathSearchInArena( Arena *arena, const CompiledPath *path, const UBYTE *input,
+                                          size_t inputLength, ValueType *valueType );
+
+/**
+ * 以下类型访问接口直接从span读取数值，写入调用方提供的变量，不分配任何内存
+ * 类型不符或者转换失败时返回false，value不变
+ */
+
+/**
+ * J_INT，直接转换为64位整数，不经过double，超出范围返回false
+ */
+JSON_API bool getInt64BySpan( const UBYTE *input, const ValueSpan *span, int64_t *value );
+
+/**
+ * J_INT或者J_FLOAT
+ */
+JSON_API bool getDoubleBySpan( const UBYTE *input, const ValueSpan *span, double *value );
+
+/**
+ * J_TRUE或者J_FALSE
+ */
+JSON_API bool getBoolBySpan( const UBYTE *input, const ValueSpan *span, bool *value );
+
+/**
+ * J_STRING，返回左右双引号之间的原始字节，不做反转义
+ */
+JSON_API bool getStringViewBySpan( const UBYTE *input, const ValueSpan *span, StringView *view );
+
+/**
+ * 创建流式解析器，输入可以分多次feed，不需要整个文档在内存中
+ * 内存只与嵌套深度和目标value的长度有关，与文档大小无关
+ * @param path 目标路径，解析器使用期间不能释放
+ * @param maxDepth 最大嵌套深度，超过时返回STREAM_ERROR
+ * @param maxValueLength 目标value的最大长度，超过时返回STREAM_ERROR
+ * @return 失败返回NULL，使用完需要调用freeStreamParser
+ */
+JSON_API StreamParser *createStreamPathParser( const CompiledPath *path, size_t maxDepth, size_t maxValueLength );
+
+/**
+ * 同createStreamPathParser，按key查找，options同macroKeyValueSearch
+ * @param key 目标key，解析器使用期间不能释放
+ */
+JSON_API StreamParser *createStreamKeyParser( const UBYTE *key, SearchOptions options, size_t maxDepth,
+                                              size_t maxValueLength );
+
+/**
+ * 处理下一段输入，chunk在返回后就可以释放或者复用
+ * 目标value结束时立即返回STREAM_FOUND，不再处理剩余的输入
+ * @return 返回STREAM_NEED_MORE时继续feed，其他状态之后再feed都返回同样的状态
+ */
+JSON_API StreamStatus feedStreamParser( StreamParser *parser, const UBYTE *chunk, size_t chunkLength );
+
+/**
+ * 输入结束，根节点是数字时在这里结束
+ * @return 文档不完整时返回STREAM_ERROR
+ */
+JSON_API StreamStatus finishStreamParser( StreamParser *parser );
+
+/**
+ * 取得目标value
+ * @param span 返回目标value在整个输入流中的offset，长度和类型
+ * @return 目标value的拷贝，在下次reset或者free之前有效，没有找到时返回NULL
+ */
+JSON_API const UBYTE *streamParserResult( const StreamParser *parser, ValueSpan *span );
+
+/**
+ * 重新开始解析下一个文档，保留已经分配的内存
+ */
+JSON_API void resetStreamParser( StreamParser *parser );
+
+JSON_API void freeStreamParser( StreamParser *parser );
+
+/**
+ * 对NDJSON(每行一个JSON)的每一条记录执行同一个查询
+ * 输入按字节分给多个线程，每个线程从范围内的第一个换行符开始处理
+ * 换行符在字符串中时，合并结果时会从正确的位置重新处理，结果与单线程完全一致
+ * 空行不算记录
+ *
+ * @param path        每条记录上执行的路径
+ * @param input       不需要以0结尾
+ * @param threadCount 线程数，0时使用CPU的个数，输入较小时会自动减少
+ * @param recordCount 返回记录的个数
+ * @return 按输入顺序排列的结果，需要调用free释放，失败返回NULL
+ */
+JSON_API NdjsonRecord *ndjsonPathSearch( const CompiledPath *path, const UBYTE *input, size_t inputLength,
+                                         size_t threadCount, size_t *recordCount );
+
+/**
+ * 同ndjsonPathSearch，按key查找，options同macroKeyValueSearch
+ */
+JSON_API NdjsonRecord *ndjsonKeySearch( const UBYTE *key, SearchOptions options, const UBYTE *input, size_t inputLength,
+                                        size_t threadCount, size_t *recordCount );
+
+/**
+ * 多个线程同时查询一个很大的数组的每一个元素
+ * 第一遍每个线程统计自己那一段的引号和括号，由此推出每一段开始处的字符串和嵌套状态
+ * 第二遍每个线程找到根数组中的逗号，查询起始位置在自己那一段中的元素
+ *
+ * @param path         每个元素上执行的路径，NULL时结果为元素本身
+ * @param input        根节点必须是数组，不需要以0结尾
+ * @param threadCount  线程数，0时使用CPU的个数，输入较小时会自动减少
+ * @param elementCount 返回元素的个数
+ * @return 按数组顺序排列的结果，offset和length为元素的位置，需要调用free释放
+ *         失败返回NULL，包括根数组没有结束、之后还有其他内容或者一个元素中有多个value
+ */
+JSON_API NdjsonRecord *parallelArraySearch( const CompiledPath *path, const UBYTE *input, size_t inputLength,
+                                            size_t threadCount, size_t *elementCount );
+
+/**
+ * 把文件映射到内存，不需要读到heap中，适合很大的文件
+ * 映射使用MADV_SEQUENTIAL，file->data和file->length可以直接用于所有WithLength/Span接口
+ * @return 失败返回false，成功时使用完需要调用closeMappedFile
+ */
+JSON_API bool openMappedFile( const char *fileName, MappedFile *file );
+
+JSON_API void closeMappedFile( MappedFile *file );
+
+/**
+ * 在映射的文件中按key查找，同macroKeyValueSearchSpan
+ * @return 指向映射中的value，在closeMappedFile之前有效
+ */
+JSON_API const UBYTE *mappedFileKeySearch( const MappedFile *file, Search *search, ValueSpan *span );
+
+/**
+ * 在映射的文件中按路径查找，同marcoPathSearchSpanWithLength
+ * @return 指向映射中的value，在closeMappedFile之前有效
+ */
+JSON_API const UBYTE *mappedFilePathSearch( const MappedFile *file, Search *search, ValueSpan *span );
+
+/**
+ * 开始遍历数组，每次nextArrayElement只解析一个元素，遍历整个数组是线性的
+ * @param input 根节点必须是数组，不需要以0结尾，遍历期间需要保持有效
+ * @return 不是数组返回false
+ */
+JSON_API bool initArrayIterator( ArrayIterator *iterator, const UBYTE *input, size_t inputLength );
+
+/**
+ * 取得下一个元素
+ * @param span 返回元素在input中的位置，结束时为J_NOT_FOUND，格式错误时为J_PARSE_ERROR
+ * @return 没有更多的元素或者格式错误返回false
+ */
+JSON_API bool nextArrayElement( ArrayIterator *iterator, ValueSpan *span );
+
+/**
+ * 扫描一次数组，记录每个元素的位置，之后按下标查找都是O(1)
+ * 嵌套的数组可以用input + span.offset和span.length建立索引
+ * @param input 根节点必须是数组，之后只能有空白，不拷贝，使用索引期间需要保持有效
+ * @return 失败返回NULL，使用完需要调用freeArrayIndex
+ */
+JSON_API ArrayIndex *buildArrayIndex( const UBYTE *input, size_t inputLength );
+
+JSON_API void freeArrayIndex( ArrayIndex *index );
+
+/**
+ * 元素的个数
+ */
+JSON_API size_t arrayIndexCount( const ArrayIndex *index );
+
+/**
+ * 建立索引时的input，用于getValueBySpan等接口
+ */
+JSON_API const UBYTE *arrayIndexInput( const ArrayIndex *index );
+
+/**
+ * 按下标查找，语义同parseArrayByIndex
+ * @param span 返回元素在input中的位置，下标超出范围时为J_NOT_FOUND
+ * @return 元素在input中的起始位置，找不到返回NULL
+ */
+JSON_API const UBYTE *arrayIndexSearch( const ArrayIndex *index, size_t position, ValueSpan *span );
+
+/**
+ * 解析一次input，对所有object中的key计算hash，之后在很宽的object中查找key都是O(1)
+ * 同时用validateJson检查一次input，并记录每一层最早出现的object或array，供Search.strict和maxDepth使用
+ * @param input 不拷贝，使用索引期间需要保持有效
+ * @return 失败返回NULL，使用完需要调用freeObjectIndex
+ */
+JSON_API ObjectIndex *buildObjectIndex( const UBYTE *input, size_t inputLength );
+
+JSON_API void freeObjectIndex( ObjectIndex *index );
+
+/**
+ * 建立索引时的input，用于getValueBySpan等接口
+ */
+JSON_API const UBYTE *objectIndexInput( const ObjectIndex *index );
+
+/**
+ * 按key查找，语义同macroKeyValueSearch，S_NORMAL只查找根节点，S_RECURSIVE返回在input中第一次出现的key
+ * unescapeKey时带转义符的key逐个反转义后比较，开销与线性查找相同
+ * @param search 同macroKeyValueSearch，结果类型写入search->valueType
+ * @param span   返回结果在input中的位置，可以为NULL
+ * @return 结果在input中的起始位置，找不到返回NULL
+ */
+JSON_API const UBYTE *objectIndexSearch( const ObjectIndex *index, Search *search, ValueSpan *span );
+
+/**
+ * 按编译后的路径查找，使用compilePath时计算好的key的hash，每一层的key都是O(1)
+ */
+JSON_API const UBYTE *objectIndexCompiledPathSearch( const ObjectIndex *index, const CompiledPath *path,
+                                                     ValueSpan *span );
+
+/**
+ * 递归查找所有名字为key的value，按在input中出现的顺序回调，匹配的value中也继续查找
+ * 只扫描一次input，超过maxDepth的子树直接跳过不查找，用于限制恶意输入的开销
+ * 匹配的object或array结束之后才回调，其中的匹配在它之后回调
+ *
+ * @param maxResults 找到这么多个之后停止，0表示不限制
+ * @param maxDepth   最多进入几层object或array，1表示只查找根object自己的key，0: 1024
+ * @param matchCount 返回找到的个数，可以为NULL
+ * @return 格式错误返回false，错误之前已经结束的结果已经回调过；提前停止时不再检查之后的内容
+ */
+JSON_API bool macroKeyValueSearchAll( const UBYTE *input, size_t inputLength, const UBYTE *key, size_t maxResults,
+                                      size_t maxDepth, KeyMatchHandler handler, void *context, size_t *matchCount );
+
+/**
+ * 对字符串的内容反转义，\uXXXX转换为UTF-8，代理对合并为一个字符，没有转义符的部分整段拷贝
+ * 查询返回的string已经反转义，无法反转义时查询返回NULL，valueType为J_PARSE_ERROR
+ * 只有直接使用span或者StringView时才需要调用
+ *
+ * @param input        字符串的内容，不包含左右双引号
+ * @param output       至少length个字节，反转义后不会变长，可以与input相同
+ * @param outputLength 返回反转义后的长度，结果不以0结尾
+ * @return 转义序列不正确或者代理对不完整时返回false
+ */
+JSON_API bool unescapeString( const UBYTE *input, size_t length, UBYTE *output, size_t *outputLength );
+
+/**
+ * 检查是否是正确的UTF-8，不接受过长编码、代理区(U+D800~U+DFFF)和超过U+10FFFF的字符
+ * 支持AVX2时每次查表检查32个字节
+ */
+JSON_API bool validateUtf8( const UBYTE *input, size_t length );
+
+/**
+ * 严格按照RFC 8259检查整个input: UTF-8编码、数字格式(不接受1.、01、.5)、字符串中的控制字符和转义、
+ * 逗号和括号，最后只允许空白；不递归，嵌套深度不受栈大小限制
+ *
+ * @param errorOffset 返回出错的位置，正确时为inputLength，可以为NULL
+ * @return 符合RFC 8259时返回true
+ */
+JSON_API bool validateJson( const UBYTE *input, size_t inputLength, size_t *errorOffset );
+
+/**
+ * 创建按key查找的查询，语义同macroKeyValueSearch
+ * 与Search不同，查询创建后不会被修改，可以在启动时创建一次，之后在任意多个线程中同时使用，不需要加锁
+ *
+ * @param key     以0结尾，会被拷贝
+ * @param options S_NORMAL只查找根节点，S_RECURSIVE返回在input中第一次出现的key
+ * @return 需要用freeQuery释放；key为NULL或内存不足返回NULL
+ */
+JSON_API Query *createKeyQuery( const UBYTE *key, SearchOptions options, QueryFlags flags );
+
+/**
+ * 创建按路径查找的查询，路径格式同marcoPathSearch，内部使用compilePath
+ * @return 需要用freeQuery释放；格式错误返回NULL
+ */
+JSON_API Query *createPathQuery( const UBYTE *pattern, QueryFlags flags );
+
+/**
+ * 释放createKeyQuery或createPathQuery返回的查询，不能与正在进行的查找同时调用
+ */
+JSON_API void freeQuery( Query *query );
+
+/**
+ * 执行查询，不拷贝任何内容；结果只写入span，query不会被修改
+ * @param span 每次调用各自的结果，找不到或出错时offset和length为0，valueType为J_NOT_FOUND/J_PARSE_ERROR，可以为NULL
+ * @return 结果在input中的起始位置，找不到或者出错返回NULL
+ */
+JSON_API const UBYTE *queryValueSpan( const Query *query, const UBYTE *input, size_t inputLength, ValueSpan *span );
+
+/**
+ * 执行查询并拷贝结果，拷贝的规则同macroKeyValueSearch
+ * @param arena     NULL时使用malloc；arena不是线程安全的，每个线程使用自己的arena
+ * @param valueType 用于返回结果的类型，可以为NULL
+ * @return 查询结果的内容，arena为NULL时需要手动释放
+ */
+JSON_API void *queryValueInArena( Arena *arena, const Query *query, const UBYTE *input, size_t inputLength,
+                                  ValueType *valueType );
+
+/**
+ * 同queryValueInArena，使用malloc分配结果
+ */
+JSON_API void *queryValue( const Query *query, const UBYTE *input, size_t inputLength, ValueType *valueType );
+
+/**
+ * 创建指向根节点的游标。之后用enterCursor进入object或array，用nextCursorField、nextCursorElement逐个移动，
+ * 没有访问的value不解析，没有读完的value和下层在移动时直接跳过，遍历整个文档是线性的
+ *
+ * @param input 不需要以0结尾，遍历期间需要保持有效
+ * @return input为空返回false
+ */
+JSON_API bool initCursor( JsonCursor *cursor, const UBYTE *input, size_t inputLength );
+
+/**
+ * 当前value的类型，只看第一个字节，数字需要区分J_INT和J_FLOAT时才会扫描数字
+ * @return 没有未读取的value时返回J_NOT_FOUND，出错返回J_PARSE_ERROR
+ */
+JSON_API ValueType peekCursorType( const JsonCursor *cursor );
+
+/**
+ * 进入当前的object或array，scope用于之后的nextCursorField或nextCursorElement
+ * @return 当前value不是object或array时返回false，cursor不变
+ */
+JSON_API bool enterCursor( JsonCursor *cursor, CursorScope *scope );
+
+/**
+ * 移动到object的下一个key，cursor指向它的value
+ * @param key 返回key在input中的原始字节，不包含双引号，转义符保持原样，可以为NULL
+ * @return 没有更多的key或者出错返回false，出错时cursor->failed为true
+ */
+JSON_API bool nextCursorField( JsonCursor *cursor, CursorScope *scope, StringView *key );
+
+/**
+ * 移动到array的下一个元素，cursor指向这个元素
+ * @return 没有更多的元素或者出错返回false，出错时cursor->failed为true
+ */
+JSON_API bool nextCursorElement( JsonCursor *cursor, CursorScope *scope );
+
+/**
+ * 读取当前的value并移动到它之后，object和array作为整体返回，可以再用getInt64BySpan等转换
+ * @param span 返回value在input中的位置，可以为NULL
+ * @return 没有未读取的value或者格式错误返回false
+ */
+JSON_API bool readCursorValue( JsonCursor *cursor, ValueSpan *span );
+
+/**
+ * 跳过当前的value，object和array只检查括号和字符串是否配对
+ */
+JSON_API bool skipCursorValue( JsonCursor *cursor );
+
+/**
+ * 初始化writer，之后按顺序调用writeObjectStart、writeKey、writeInt64等写入，','和':'自动添加
+ * 不检查嵌套是否正确，key只能在object中、value前写入，由调用方保证
+ *
+ * @param buffer   调用方提供的内存，写满后不扩容，写入失败；NULL: 由writer分配并按需扩容
+ * @param capacity buffer的大小，buffer为NULL时为初始大小，0表示使用默认值
+ */
+JSON_API bool initWriter( JsonWriter *writer, void *buffer, size_t capacity );
+
+/**
+ * 释放initWriter分配的内存，调用方提供的buffer不释放
+ */
+JSON_API void releaseWriter( JsonWriter *writer );
+
+JSON_API bool writeObjectStart( JsonWriter *writer );
+
+JSON_API bool writeObjectEnd( JsonWriter *writer );
+
+JSON_API bool writeArrayStart( JsonWriter *writer );
+
+JSON_API bool writeArrayEnd( JsonWriter *writer );
+
+/**
+ * 写入object的key，转义规则同writeString
+ * @param key 不需要以0结尾
+ */
+JSON_API bool writeKey( JsonWriter *writer, const UBYTE *key, size_t keyLength );
+
+/**
+ * 写入字符串，转义"、\和控制字符，其余的UTF-8字节原样写入；不需要转义的部分用SIMD查找后整段拷贝
+ * @param text 反转义后的内容，不需要以0结尾
+ */
+JSON_API bool writeString( JsonWriter *writer, const UBYTE *text, size_t length );
+
+JSON_API bool writeInt64( JsonWriter *writer, int64_t value );
+
+/**
+ * 写入能够被strtod还原的最短的十进制，常见的小数不需要snprintf；NaN和Infinity写入null
+ */
+JSON_API bool writeDouble( JsonWriter *writer, double value );
+
+JSON_API bool writeBool( JsonWriter *writer, bool value );
+
+JSON_API bool writeNull( JsonWriter *writer );
+
+/**
+ * 把查询结果原样拷贝到输出中，不重新解析也不重新转义
+ * @param input 查询时使用的input
+ * @param span  macroKeyValueSearchSpan、readCursorValue等返回的位置，找不到或出错时返回false
+ */
+JSON_API bool writeSpan( JsonWriter *writer, const UBYTE *input, const ValueSpan *span );
+
+/**
+ * 修改路径指向的value，结果是原来的input中的几段加上新的内容，不重新生成整个文档
+ * 只解析定位目标需要的部分，开销与marcoPathSearch相同
+ *
+ * @param pattern     路径，格式同marcoPathSearch，PATCH_INSERT_KEY时最后一段是要插入的key
+ *                    key与文档中的key一样是转义后的形式，原样写入，包含未转义的双引号、控制字符
+ *                    或者不正确的转义时返回J_PATTERN_WRONG_FORMAT
+ * @param value       新的value，原样写入，需要是正确的JSON，可以用JsonWriter生成；PATCH_DELETE时忽略
+ * @param result      parts指向input、pattern和value，使用期间它们需要保持有效
+ * @return 失败时返回false，result->valueType为J_NOT_FOUND、J_PARSE_ERROR、J_PATTERN_WRONG_FORMAT；
+ *         PATCH_INSERT_KEY时key已经存在也返回false，valueType为已有value的类型
+ */
+JSON_API bool patchJson( const UBYTE *input, size_t inputLength, const UBYTE *pattern, PatchOperation operation,
+                         const UBYTE *value, size_t valueLength, PatchResult *result );
+
+/**
+ * 把补丁的所有部分拼接成一个以0结尾的buffer
+ * @param length 返回拼接后的长度，可以为NULL
+ * @return 需要手动释放指针
+ */
+JSON_API UBYTE *joinPatch( const PatchResult *result, size_t *length );
 
 #endif //UNTITLED_MAIN_H
@@ -0,0 +1,1902 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <math.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "main.h"
+
+/* 以下内部函数没有在main.h中公开，测试时直接链接静态库 */
+void *parseArrayByIndex( const UBYTE *input, int index, Search *search );
+
+int failedCount = 0;
+
+/* 打印失败信息并计数，main返回失败的个数 */
+void printTestFailure( const char *format, ... ){
+
+    va_list arguments;
+    va_start( arguments, format );
+    vprintf( format, arguments );
+    va_end( arguments );
+    failedCount++;
+}
+
+void printTestResult( char *name, char *result, char *expected, ValueType valueType ){
+
+    char buf[2048];
+    switch ( valueType ) {
+        case J_NOT_FOUND:
+            sprintf( buf, "not found..." );
+            break;
+        case J_PATTERN_WRONG_FORMAT:
+            sprintf( buf, "wrong pattern format" );
+            break;
+        case J_FLOAT:
+            sprintf( buf, "number is %.9f", *(double *) result );
+            break;
+        case J_INT:
+            sprintf( buf, "number is %d", *(int *) result );
+            break;
+        case J_PARSE_ERROR:
+            sprintf( buf, "parse error" );
+            break;
+        case J_STRING:
+            sprintf( buf, "string is %s", (char *) result );
+            break;
+        case J_ARRAY:
+            sprintf( buf, "array is %s", (char *) result );
+            break;
+        case J_OBJ:
+            sprintf( buf, "obj is %s", (char *) result );
+            break;
+        case J_TRUE:
+            sprintf( buf, "value is true" );
+            break;
+        case J_FALSE:
+            sprintf( buf, "value is false" );
+            break;
+        default: //case J_NULL:
+            sprintf( buf, "value is null" );
+            break;
+    }
+
+    if ( strcmp( buf, expected ) == 0 ) {
+        printf( "%s, test passed!\n", name );
+    } else {
+        printTestFailure( "%s, test failed, expected: [%s], actual: [%s]\n", name, expected, buf );
+    }
+}
+
+void test( char *name, char *input, char *key, char *expected, bool isRecursive ){
+
+    Search search  = { .pattern = (UBYTE *) key, .valueType = J_NOT_FOUND,
+                       .options = isRecursive ? S_RECURSIVE : S_NORMAL };
+    void   *result = macroKeyValueSearch((UBYTE *) input, &search );
+
+    printTestResult( name, result, expected, search.valueType );
+}
+
+void test2( char *name, char *input, int index, char *expected ){
+
+    Search search  = { .valueType = J_NOT_FOUND, .options = S_NORMAL };
+    void   *result = parseArrayByIndex((UBYTE *) input, index, &search );
+
+    printTestResult( name, result, expected, search.valueType );
+}
+
+void test3( char *name, char *input, char *pattern, char *expected ){
+
+    Search search  = { .pattern = (UBYTE *) pattern, .valueType = J_NOT_FOUND, .options = S_NORMAL };
+    void   *result = marcoPathSearch((UBYTE *) input, &search );
+
+    printTestResult( name, result, expected, search.valueType );
+}
+
+void test4( char *name, char *input, char *pattern, size_t expectedOffset, char *expected ){
+
+    Search    search = { .pattern = (UBYTE *) pattern, .valueType = J_NOT_FOUND, .options = S_NORMAL };
+    ValueSpan span   = { 0, 0, J_NOT_FOUND };
+    const UBYTE *leaf = marcoPathSearchSpan((UBYTE *) input, &search, &span );
+    void        *result = leaf == NULL ? NULL : getValueBySpan((UBYTE *) input, &span );
+
+    if ( leaf != NULL && ( leaf != (UBYTE *) input + expectedOffset || span.offset != expectedOffset )) {
+        printTestFailure( "%s, test failed, expected offset: [%zu], actual: [%zu]\n", name, expectedOffset,
+                          span.offset );
+        return;
+    }
+
+    printTestResult( name, result, expected, search.valueType );
+}
+
+void test5( char *name, char *input, size_t length, char *key, char *expected, bool isRecursive ){
+
+    Search search  = { .pattern = (UBYTE *) key, .valueType = J_NOT_FOUND,
+                       .options = isRecursive ? S_RECURSIVE : S_NORMAL };
+    void   *result = macroKeyValueSearchWithLength((UBYTE *) input, length, &search );
+
+    printTestResult( name, result, expected, search.valueType );
+}
+
+void test6( char *name, char *input, size_t length, char *pattern, char *expected ){
+
+    Search search  = { .pattern = (UBYTE *) pattern, .valueType = J_NOT_FOUND, .options = S_NORMAL };
+    void   *result = marcoPathSearchWithLength((UBYTE *) input, length, &search );
+
+    printTestResult( name, result, expected, search.valueType );
+}
+
+void test7( char *name, char *input, CompiledPath *path, char *expected ){
+
+    ValueType valueType;
+    void      *result = compiledPathSearch( path, (UBYTE *) input, input == NULL ? 0 : strlen( input ), &valueType );
+
+    printTestResult( name, result, expected, valueType );
+}
+
+void test8( char *name, char *input, char **patterns, size_t patternCount, char **expected ){
+
+    PathSet   *set = compilePathSet((const UBYTE **) patterns, patternCount );
+    ValueSpan spans[16];
+    pathSetSearch( set, (UBYTE *) input, strlen( input ), spans );
+
+    for ( size_t i = 0; i < patternCount; i++ ) {
+        char subName[64];
+        sprintf( subName, "%s.%zu", name, i + 1 );
+        printTestResult( subName, getValueBySpan((UBYTE *) input, &spans[i] ), expected[i], spans[i].valueType );
+    }
+    freePathSet( set );
+}
+
+size_t scanValueScalar( const UBYTE *input, size_t inputLength );
+#if defined( __x86_64__ ) || defined( __i386__ )
+size_t scanValueSSE2( const UBYTE *input, size_t inputLength );
+size_t scanValueAVX2( const UBYTE *input, size_t inputLength );
+#endif
+
+/* 所有的scan实现在各种转义和block边界上的结果必须一致 */
+void test9( char *name ){
+
+    UBYTE  buf[256];
+    char   *pieces[] = { "a", "\\\\", "\\\"", "{", "]", "[", "}", "\"", " ", "\\u00e9", "我" };
+    size_t count     = sizeof( pieces ) / sizeof( pieces[0] );
+    unsigned seed    = 12345;
+
+    for ( int round = 0; round < 20000; round++ ) {
+        size_t length = 0;
+        buf[length++] = round % 3 == 0 ? '"' : ( round % 3 == 1 ? '{' : '[' );
+        while ( length < 200 ) {
+            seed = seed * 1103515245 + 12345;
+            char *piece = pieces[( seed >> 16 ) % count];
+            size_t pieceLength = strlen( piece );
+            memcpy( buf + length, piece, pieceLength );
+            length += pieceLength;
+        }
+
+        size_t expected = scanValueScalar( buf, length );
+#if defined( __x86_64__ ) || defined( __i386__ )
+        if ( scanValueSSE2( buf, length ) != expected || ( __builtin_cpu_supports( "avx2" )
+                                                            && scanValueAVX2( buf, length ) != expected )) {
+            printTestFailure( "%s, test failed, kernels differ at round %d\n", name, round );
+            return;
+        }
+#endif
+    }
+    printf( "%s, test passed!\n", name );
+}
+
+void test10( char *name, JsonTape *tape, char *pattern, char *expected ){
+
+    ValueSpan span;
+    tapePathSearch( tape, (UBYTE *) pattern, &span );
+
+    printTestResult( name, getValueBySpan( tape == NULL ? NULL : tapeInput( tape ), &span ), expected, span.valueType );
+}
+
+void test11( char *name, Arena *arena, char *input, char *key, char *expected, bool inBuffer ){
+
+    Search search  = { .pattern = (UBYTE *) key, .valueType = J_NOT_FOUND, .options = S_RECURSIVE };
+    void   *result = macroKeyValueSearchInArena( arena, (UBYTE *) input, strlen( input ), &search );
+
+    bool isInBuffer = result != NULL && (UBYTE *) result >= arena->buffer
+                      && (UBYTE *) result < arena->buffer + arena->capacity;
+    if ( result != NULL && isInBuffer != inBuffer ) {
+        printTestFailure( "%s, test failed, expected in buffer: [%d], actual: [%d]\n", name, inBuffer,
+                          isInBuffer );
+        return;
+    }
+
+    printTestResult( name, result, expected, search.valueType );
+}
+
+void test12( char *name, char *input, char *pattern, char *expected ){
+
+    Search    search = { .pattern = (UBYTE *) pattern, .valueType = J_NOT_FOUND, .options = S_NORMAL };
+    ValueSpan span   = { 0, 0, J_NOT_FOUND };
+    marcoPathSearchSpanWithLength((UBYTE *) input, strlen( input ), &search, &span );
+
+    char       buf[256];
+    int64_t    integer;
+    double     number;
+    bool       boolean;
+    StringView view;
+    if ( getInt64BySpan((UBYTE *) input, &span, &integer )) {
+        sprintf( buf, "int64 is %lld", (long long) integer );
+    } else if ( getDoubleBySpan((UBYTE *) input, &span, &number )) {
+        sprintf( buf, "double is %.9g", number );
+    } else if ( getBoolBySpan((UBYTE *) input, &span, &boolean )) {
+        sprintf( buf, "bool is %s", boolean ? "true" : "false" );
+    } else if ( getStringViewBySpan((UBYTE *) input, &span, &view )) {
+        sprintf( buf, "view is %.*s", (int) view.length, (const char *) view.data );
+    } else {
+        sprintf( buf, "no value" );
+    }
+
+    if ( strcmp( buf, expected ) == 0 ) {
+        printf( "%s, test passed!\n", name );
+    } else {
+        printTestFailure( "%s, test failed, expected: [%s], actual: [%s]\n", name, expected, buf );
+    }
+}
+
+bool convertNumber( const UBYTE *input, size_t length, double *number );
+
+/* 数字转换的结果必须和strtod完全一致 */
+void test13( char *name ){
+
+    char     *edges[] = { "0", "-0", "0.1", "2.2250738585072014e-308", "2.2250738585072011e-308", "4.9e-324",
+                          "1.7976931348623157e308", "1.7976931348623159e308", "1e309", "9007199254740993",
+                          "123456789012345678901234567890", "1e-400", "7.2057594037927933e16", "0.000001234e-2",
+                          "9.999999999999999999999e22", "1E+2", "5e-1" };
+    char     buf[128];
+    unsigned seed    = 2020;
+    size_t   count   = sizeof( edges ) / sizeof( edges[0] );
+
+    for ( size_t round = 0; round < 300000; round++ ) {
+        if ( round < count ) {
+            strcpy( buf, edges[round] );
+        } else {
+            size_t length = 0;
+            seed = seed * 1103515245 + 12345;
+            if ( seed & 0x10000 ) buf[length++] = '-';
+            seed = seed * 1103515245 + 12345;
+            int digits = 1 + (int) (( seed >> 16 ) % 24 );
+            seed = seed * 1103515245 + 12345;
+            int dot    = (int) (( seed >> 16 ) % ( digits + 1 ));
+            for ( int d = 0; d < digits; d++ ) {
+                seed = seed * 1103515245 + 12345;
+                buf[length++] = (char) ( d == 0 ? '1' + ( seed >> 16 ) % 9 : '0' + ( seed >> 16 ) % 10 );
+                if ( d + 1 == dot && d + 1 < digits ) buf[length++] = '.';
+            }
+            seed = seed * 1103515245 + 12345;
+            length += (size_t) sprintf( buf + length, "e%d", (int) (( seed >> 16 ) % 700 ) - 350 );
+            buf[length] = '\0';
+        }
+
+        double expected = strtod( buf, NULL ), actual = 0;
+        if ( !convertNumber((UBYTE *) buf, strlen( buf ), &actual ) || memcmp( &expected, &actual, sizeof( double ))) {
+            printTestFailure( "%s, test failed, [%s] expected: [%.17g], actual: [%.17g]\n", name, buf, expected,
+                              actual );
+            return;
+        }
+    }
+    printf( "%s, test passed!\n", name );
+}
+
+/* 每一种chunk大小的结果必须一致，expected为value的原始文本 */
+void test14( char *name, StreamParser *parser, char *input, char *expected ){
+
+    size_t inputLength = strlen( input );
+    char   actual[256];
+
+    for ( size_t chunkLength = 1; chunkLength <= inputLength; chunkLength++ ) {
+        resetStreamParser( parser );
+
+        StreamStatus status = STREAM_NEED_MORE;
+        for ( size_t i = 0; i < inputLength && status == STREAM_NEED_MORE; i += chunkLength ) {
+            status = feedStreamParser( parser, (UBYTE *) input + i,
+                                       inputLength - i < chunkLength ? inputLength - i : chunkLength );
+        }
+        if ( status == STREAM_NEED_MORE ) status = finishStreamParser( parser );
+
+        ValueSpan   span;
+        const UBYTE *value = streamParserResult( parser, &span );
+        if ( status == STREAM_FOUND ) {
+            if ( span.offset + span.length > inputLength || memcmp( input + span.offset, value, span.length )) {
+                printTestFailure( "%s, test failed, wrong offset: [%zu]\n", name, span.offset );
+                return;
+            }
+            sprintf( actual, "%.*s", (int) span.length, (const char *) value );
+        } else {
+            sprintf( actual, "%s", status == STREAM_NOT_FOUND ? "not found" : "parse error" );
+        }
+
+        if ( strcmp( actual, expected ) != 0 ) {
+            printTestFailure( "%s, test failed, chunk: [%zu], expected: [%s], actual: [%s]\n", name, chunkLength,
+                              expected, actual );
+            return;
+        }
+    }
+    printf( "%s, test passed!\n", name );
+}
+
+/* 多线程的结果必须与单线程完全一致 */
+void test15( char *name, char *input, size_t inputLength, CompiledPath *path, size_t threadCount,
+             size_t expectedCount ){
+
+    size_t       expected, actual;
+    NdjsonRecord *single   = ndjsonPathSearch( path, (UBYTE *) input, inputLength, 1, &expected );
+    NdjsonRecord *parallel = ndjsonPathSearch( path, (UBYTE *) input, inputLength, threadCount, &actual );
+
+    bool same = single != NULL && parallel != NULL && expected == expectedCount && actual == expectedCount;
+    for ( size_t i = 0; same && i < expected; i++ ) {
+        same = single[i].offset == parallel[i].offset && single[i].length == parallel[i].length
+               && single[i].value.offset == parallel[i].value.offset
+               && single[i].value.length == parallel[i].value.length
+               && single[i].value.valueType == parallel[i].value.valueType;
+    }
+    if ( !same ) {
+        printTestFailure( "%s, test failed, expected records: [%zu], single: [%zu], parallel: [%zu]\n", name,
+                          expectedCount, single == NULL ? 0 : expected, parallel == NULL ? 0 : actual );
+    } else {
+        printf( "%s, test passed!\n", name );
+    }
+    free( single );
+    free( parallel );
+}
+
+void test16( char *name, MappedFile *file, char *pattern, char *expected ){
+
+    Search    search = { .pattern = (UBYTE *) pattern, .valueType = J_NOT_FOUND, .options = S_NORMAL };
+    ValueSpan span   = { 0, 0, J_NOT_FOUND };
+    mappedFilePathSearch( file, &search, &span );
+
+    printTestResult( name, getValueBySpan( file->data, &span ), expected, search.valueType );
+}
+
+/* 多线程的结果必须与单线程一致，抽样与按下标查找的结果比较 */
+void test17( char *name, char *input, size_t inputLength, char *pattern, size_t threadCount, size_t expectedCount ){
+
+    CompiledPath *path     = compilePath((UBYTE *) pattern );
+    size_t       expected  = 0, actual = 0;
+    NdjsonRecord *single   = parallelArraySearch( path, (UBYTE *) input, inputLength, 1, &expected );
+    NdjsonRecord *parallel = parallelArraySearch( path, (UBYTE *) input, inputLength, threadCount, &actual );
+
+    bool same = single != NULL && parallel != NULL && expected == expectedCount && actual == expectedCount;
+    for ( size_t i = 0; same && i < expected; i++ ) {
+        same = single[i].offset == parallel[i].offset && single[i].length == parallel[i].length
+               && single[i].value.offset == parallel[i].value.offset
+               && single[i].value.length == parallel[i].value.length
+               && single[i].value.valueType == parallel[i].value.valueType;
+
+        if ( same && i % 997 == 0 ) {
+            char      indexPattern[64];
+            ValueSpan span   = { 0, 0, J_NOT_FOUND };
+            sprintf( indexPattern, "[%zu]%s", i, pattern );
+            Search    search = { .pattern = (UBYTE *) indexPattern, .valueType = J_NOT_FOUND, .options = S_NORMAL };
+            marcoPathSearchSpanWithLength((UBYTE *) input, inputLength, &search, &span );
+            same = span.offset == parallel[i].value.offset && span.length == parallel[i].value.length;
+        }
+    }
+    if ( !same ) {
+        printTestFailure( "%s, test failed, expected elements: [%zu], single: [%zu], parallel: [%zu]\n", name,
+                          expectedCount, single == NULL ? 0 : expected, parallel == NULL ? 0 : actual );
+    } else {
+        printf( "%s, test passed!\n", name );
+    }
+    free( single );
+    free( parallel );
+    freeCompiledPath( path );
+}
+
+/* 索引、迭代器和按下标查找的结果必须一致 */
+void test18( char *name, char *input, size_t expectedCount ){
+
+    size_t     inputLength = strlen( input );
+    ArrayIndex *index      = buildArrayIndex((UBYTE *) input, inputLength );
+
+    if ( index == NULL || arrayIndexCount( index ) != expectedCount ) {
+        printTestFailure( "%s, test failed, expected elements: [%zu], actual: [%zu]\n", name, expectedCount,
+                          arrayIndexCount( index ));
+        freeArrayIndex( index );
+        return;
+    }
+
+    ArrayIterator iterator;
+    ValueSpan     element, indexed, searched;
+    initArrayIterator( &iterator, (UBYTE *) input, inputLength );
+    for ( size_t i = 0; i <= expectedCount; i++ ) {
+        char pattern[32];
+        sprintf( pattern, "[%zu]", i );
+        Search search = { .pattern = (UBYTE *) pattern, .valueType = J_NOT_FOUND, .options = S_NORMAL };
+        marcoPathSearchSpanWithLength((UBYTE *) input, inputLength, &search, &searched );
+        arrayIndexSearch( index, i, &indexed );
+        bool hasNext = nextArrayElement( &iterator, &element );
+
+        if ( hasNext != ( i < expectedCount ) || indexed.valueType != search.valueType
+             || element.valueType != indexed.valueType
+             || ( i < expectedCount && ( indexed.offset != searched.offset || indexed.length != searched.length
+                                         || element.offset != indexed.offset || element.length != indexed.length ))) {
+            printTestFailure( "%s, test failed, element [%zu] differs\n", name, i );
+            freeArrayIndex( index );
+            return;
+        }
+    }
+    printf( "%s, test passed!\n", name );
+    freeArrayIndex( index );
+}
+
+/* 索引的结果必须与macroKeyValueSearch一致 */
+void test19( char *name, ObjectIndex *index, char *key, bool isRecursive, char *expected ){
+
+    Search    search = { .pattern = (UBYTE *) key, .valueType = J_NOT_FOUND,
+                         .options = isRecursive ? S_RECURSIVE : S_NORMAL };
+    ValueSpan span   = { 0, 0, J_NOT_FOUND };
+    objectIndexSearch( index, &search, &span );
+
+    Search linear  = { .pattern = (UBYTE *) key, .valueType = J_NOT_FOUND, .options = search.options };
+    void   *value  = macroKeyValueSearchWithLength( objectIndexInput( index ),
+                                                    strlen((const char *) objectIndexInput( index )), &linear );
+    free( value );
+    if ( linear.valueType != search.valueType ) {
+        printTestFailure( "%s, test failed, linear search: [%d], index: [%d]\n", name, linear.valueType,
+                          search.valueType );
+        return;
+    }
+
+    printTestResult( name, getValueBySpan( objectIndexInput( index ), &span ), expected, span.valueType );
+}
+
+void test20( char *name, ObjectIndex *index, char *pattern, char *expected ){
+
+    CompiledPath *path = compilePath((UBYTE *) pattern );
+    ValueSpan    span  = { 0, 0, J_NOT_FOUND };
+    objectIndexCompiledPathSearch( index, path, &span );
+    freeCompiledPath( path );
+
+    printTestResult( name, getValueBySpan( objectIndexInput( index ), &span ), expected, span.valueType );
+}
+
+/* 把所有匹配记录成"path=value;"，stopAfter个之后让回调返回false */
+typedef struct {
+    const char *input;
+    char       text[1024];
+    size_t     length;
+    size_t     stopAfter;
+} MatchLog;
+
+bool logMatch( void *context, const UBYTE *path, size_t pathLength, const ValueSpan *span ){
+
+    MatchLog *log = context;
+    log->length += (size_t) snprintf( log->text + log->length, sizeof( log->text ) - log->length, "%.*s=%.*s;",
+                                      (int) pathLength, path, (int) span->length, log->input + span->offset );
+    return --log->stopAfter > 0;
+}
+
+void test21( char *name, char *input, char *key, size_t maxResults, size_t maxDepth, size_t stopAfter,
+             bool expectedOk, size_t expectedCount, char *expected ){
+
+    MatchLog log = { input, "", 0, stopAfter };
+    size_t   count;
+    bool     ok  = macroKeyValueSearchAll((UBYTE *) input, strlen( input ), (UBYTE *) key, maxResults, maxDepth,
+                                          logMatch, &log, &count );
+
+    if ( ok == expectedOk && strcmp( log.text, expected ) == 0 && count == expectedCount ) {
+        printf( "%s, test passed!\n", name );
+    } else {
+        printTestFailure( "%s, test failed! expected %d %s, actual %d %s\n", name, expectedOk, expected, ok, log.text );
+    }
+}
+
+void test22( char *name, char *input, bool expectedOk, char *expected ){
+
+    UBYTE  output[256];
+    size_t outputLength = 0;
+    bool   ok           = unescapeString((UBYTE *) input, strlen( input ), output, &outputLength );
+
+    if ( ok == expectedOk && ( !ok || ( outputLength == strlen( expected )
+                                        && memcmp( output, expected, outputLength ) == 0 ))) {
+        printf( "%s, test passed!\n", name );
+    } else {
+        printTestFailure( "%s, test failed! expected %d [%s], actual %d [%.*s]\n", name, expectedOk, expected, ok,
+                          (int) outputLength, output );
+    }
+}
+
+void test23( char *name, char *input, char *key, char *expected, bool isRecursive ){
+
+    Search search  = { .pattern = (UBYTE *) key, .valueType = J_NOT_FOUND,
+                       .options = isRecursive ? S_RECURSIVE : S_NORMAL, .unescapeKey = true };
+    void   *result = macroKeyValueSearch((UBYTE *) input, &search );
+
+    printTestResult( name, result, expected, search.valueType );
+}
+
+void test24( char *name, char *input, bool expectedValid, size_t expectedOffset ){
+
+    size_t errorOffset;
+    bool   valid = validateJson((UBYTE *) input, strlen( input ), &errorOffset );
+
+    if ( valid == expectedValid && errorOffset == expectedOffset ) {
+        printf( "%s, test passed!\n", name );
+    } else {
+        printTestFailure( "%s, test failed, expected: [%d at %zu], actual: [%d at %zu]\n", name, expectedValid,
+                          expectedOffset, valid, errorOffset );
+    }
+}
+
+size_t findUtf8ErrorScalar( const UBYTE *input, size_t length );
+#if defined( __x86_64__ ) || defined( __i386__ )
+bool validateUtf8AVX2( const UBYTE *input, size_t length );
+#endif
+
+/* 随机拼接正确和错误的UTF-8片段，查表实现和逐字节实现的结果必须一致 */
+void test25( char *name ){
+
+    UBYTE  buf[256];
+    char   *pieces[] = { "a", "0123456789", "\xc3\xa9", "\xe4\xb8\xad", "\xf0\x9f\x98\x80", "\xf4\x8f\xbf\xbf",
+                         "\xc3", "\xe4\xb8", "\x80", "\xc0\xaf", "\xed\xa0\x80", "\xf4\x90\x80\x80", "\xff",
+                         "\xe0\x80\x80", "\xf0\x80\x80\x80" };
+    size_t count     = sizeof( pieces ) / sizeof( pieces[0] );
+    unsigned seed    = 54321;
+    int    invalid   = 0;
+
+    for ( int round = 0; round < 20000; round++ ) {
+        size_t length = 0, limit = ( round % 200 ) + 1;
+        while ( length < limit ) {
+            seed = seed * 1103515245 + 12345;
+            // 大部分片段是正确的，错误片段只有很小的概率出现
+            size_t index = ( seed >> 16 ) % 64 < 60 ? ( seed >> 16 ) % 6 : ( seed >> 16 ) % count;
+            size_t pieceLength = strlen( pieces[index] );
+            memcpy( buf + length, pieces[index], pieceLength );
+            length += pieceLength;
+        }
+
+        bool expected = findUtf8ErrorScalar( buf, length ) == length;
+        invalid += !expected;
+        if ( validateUtf8( buf, length ) != expected
+#if defined( __x86_64__ ) || defined( __i386__ )
+             || ( __builtin_cpu_supports( "avx2" ) && validateUtf8AVX2( buf, length ) != expected )
+#endif
+                ) {
+            printTestFailure( "%s, test failed, kernels differ at round %d\n", name, round );
+            return;
+        }
+    }
+
+    if ( invalid == 0 || invalid == 20000 ) printTestFailure( "%s, test failed, inputs are not mixed\n", name );
+    else printf( "%s, test passed!\n", name );
+}
+
+void test26( char *name, char *input, char *key, char *expected ){
+
+    Search search  = { .pattern = (UBYTE *) key, .valueType = J_NOT_FOUND, .options = S_RECURSIVE, .strict = true };
+    void   *result = macroKeyValueSearch((UBYTE *) input, &search );
+
+    printTestResult( name, result, expected, search.valueType );
+}
+
+void test27( char *name, Query *query, char *input, char *expected ){
+
+    ValueType valueType;
+    void      *result = queryValue( query, (UBYTE *) input, strlen( input ), &valueType );
+
+    printTestResult( name, result, expected, valueType );
+}
+
+/* 多个线程共用同一组查询，每个线程的结果必须与单线程的一致 */
+typedef struct {
+    Query      **queries;
+    size_t     queryCount;
+    const char **documents;
+    size_t     documentCount;
+    ValueSpan  *expected;           // documentCount * queryCount
+    int        mismatches;
+} QueryWorker;
+
+void *runQueryWorker( void *argument ){
+
+    QueryWorker *worker = argument;
+    for ( int round = 0; round < 200; round++ ) {
+        for ( size_t d = 0; d < worker->documentCount; d++ ) {
+            for ( size_t q = 0; q < worker->queryCount; q++ ) {
+                ValueSpan span;
+                queryValueSpan( worker->queries[q], (UBYTE *) worker->documents[d], strlen( worker->documents[d] ),
+                                &span );
+                const ValueSpan *expected = &worker->expected[d * worker->queryCount + q];
+                if ( span.offset != expected->offset || span.length != expected->length
+                     || span.valueType != expected->valueType )
+                    worker->mismatches++;
+            }
+        }
+    }
+    return NULL;
+}
+
+void test28( char *name, Query **queries, size_t queryCount, const char **documents, size_t documentCount ){
+
+    ValueSpan   *expected = malloc( sizeof( ValueSpan ) * queryCount * documentCount );
+    QueryWorker workers[32];
+    pthread_t   threads[32];
+
+    for ( size_t d = 0; d < documentCount; d++ ) {
+        for ( size_t q = 0; q < queryCount; q++ ) {
+            queryValueSpan( queries[q], (UBYTE *) documents[d], strlen( documents[d] ),
+                            &expected[d * queryCount + q] );
+        }
+    }
+
+    int mismatches = 0;
+    for ( int i = 0; i < 32; i++ ) {
+        QueryWorker worker = { queries, queryCount, documents, documentCount, expected, 0 };
+        workers[i] = worker;
+        pthread_create( &threads[i], NULL, runQueryWorker, &workers[i] );
+    }
+    for ( int i = 0; i < 32; i++ ) {
+        pthread_join( threads[i], NULL );
+        mismatches += workers[i].mismatches;
+    }
+    free( expected );
+
+    if ( mismatches == 0 ) printf( "%s, test passed!\n", name );
+    else printTestFailure( "%s, test failed, %d results differ between threads\n", name, mismatches );
+}
+
+void test29( char *name, char *input, char *key, size_t maxDepth, char *expected ){
+
+    Search search  = { .pattern = (UBYTE *) key, .valueType = J_NOT_FOUND,
+                       .options = S_RECURSIVE, .maxDepth = maxDepth };
+    void   *result = macroKeyValueSearchWithLength((UBYTE *) input, strlen( input ), &search );
+
+    printTestResult( name, result, expected, search.valueType );
+}
+
+/* 在栈很小的线程中查找很深的嵌套 */
+typedef struct {
+    char      *input;
+    ValueType valueType;
+} DeepSearch;
+
+void *runDeepSearch( void *argument ){
+
+    DeepSearch *deep   = argument;
+    Search     search  = { .pattern = (UBYTE *) "leaf", .valueType = J_NOT_FOUND,
+                           .options = S_RECURSIVE, .maxDepth = 1000000 };
+    void       *result = macroKeyValueSearchWithLength((UBYTE *) deep->input, strlen( deep->input ), &search );
+    deep->valueType = search.valueType;
+    free( result );
+    return NULL;
+}
+
+void test30( char *name, size_t depth ){
+
+    char   *input = malloc( depth * 6 + 32 );
+    size_t length = 0;
+    for ( size_t i = 0; i < depth; i++ ) {
+        memcpy( input + length, i % 2 ? "[" : "{\"a\":", i % 2 ? 1 : 5 );
+        length += i % 2 ? 1 : 5;
+    }
+    length += (size_t) sprintf( input + length, "{\"leaf\":7}" );
+    for ( size_t i = depth; i-- > 0; ) input[length++] = i % 2 ? ']' : '}';
+    input[length] = '\0';
+
+    DeepSearch     deep = { input, J_NOT_FOUND };
+    pthread_t      thread;
+    pthread_attr_t attributes;
+    pthread_attr_init( &attributes );
+    pthread_attr_setstacksize( &attributes, 64 * 1024 );
+    pthread_create( &thread, &attributes, runDeepSearch, &deep );
+    pthread_join( thread, NULL );
+    pthread_attr_destroy( &attributes );
+    free( input );
+
+    if ( deep.valueType == J_INT ) printf( "%s, test passed!\n", name );
+    else printTestFailure( "%s, test failed, expected: [%d], actual: [%d]\n", name, J_INT, deep.valueType );
+}
+
+/* 用游标把value重新输出成没有空白的JSON，用于检查遍历的顺序 */
+bool dumpCursor( JsonCursor *cursor, char *output, size_t *length ){
+
+    CursorScope scope;
+    StringView  key;
+    ValueSpan   span;
+    ValueType   valueType = peekCursorType( cursor );
+
+    if ( valueType == J_OBJ || valueType == J_ARRAY ) {
+        if ( !enterCursor( cursor, &scope )) return false;
+        output[( *length )++] = valueType == J_OBJ ? '{' : '[';
+        bool first = true;
+        while ( valueType == J_OBJ ? nextCursorField( cursor, &scope, &key ) : nextCursorElement( cursor, &scope )) {
+            if ( !first ) output[( *length )++] = ',';
+            first = false;
+            if ( valueType == J_OBJ ) {
+                *length += (size_t) sprintf( output + *length, "\"%.*s\":", (int) key.length, key.data );
+            }
+            if ( !dumpCursor( cursor, output, length )) return false;
+        }
+        if ( cursor->failed ) return false;
+        output[( *length )++] = valueType == J_OBJ ? '}' : ']';
+        return true;
+    }
+
+    if ( !readCursorValue( cursor, &span )) return false;
+    *length += (size_t) sprintf( output + *length, "%.*s", (int) span.length, cursor->input + span.offset );
+    return true;
+}
+
+void test31( char *name, char *input, char *expected ){
+
+    JsonCursor cursor;
+    char       output[1024];
+    size_t     length = 0;
+    bool       ok     = initCursor( &cursor, (UBYTE *) input, strlen( input )) && dumpCursor( &cursor, output, &length );
+    output[length] = '\0';
+
+    if ( !ok ) sprintf( output, "parse error" );
+    if ( strcmp( output, expected ) == 0 ) {
+        printf( "%s, test passed!\n", name );
+    } else {
+        printTestFailure( "%s, test failed, expected: [%s], actual: [%s]\n", name, expected, output );
+    }
+}
+
+void test32( char *name, JsonWriter *writer, char *expected ){
+
+    char actual[1024];
+    if ( writer->failed ) sprintf( actual, "failed" );
+    else sprintf( actual, "%.*s", (int) writer->length, writer->buffer );
+
+    if ( strcmp( actual, expected ) == 0 ) {
+        printf( "%s, test passed!\n", name );
+    } else {
+        printTestFailure( "%s, test failed, expected: [%s], actual: [%s]\n", name, expected, actual );
+    }
+    releaseWriter( writer );
+}
+
+/* 随机的double写入后再用strtod读回，必须得到相同的值 */
+void test33( char *name ){
+
+    uint64_t seed = 88172645463325252ull;
+    char     text[64];
+    for ( int round = 0; round < 200000; round++ ) {
+        seed ^= seed << 13;
+        seed ^= seed >> 7;
+        seed ^= seed << 17;
+
+        double value;
+        if ( round % 3 == 0 ) {
+            // 常见的几位小数
+            value = (double) ( (int64_t) ( seed % 2000000 ) - 1000000 ) / ( round % 2 ? 100.0 : 1000.0 );
+        } else {
+            memcpy( &value, &seed, sizeof( value ));
+            if ( isnan( value ) || isinf( value )) continue;
+        }
+
+        JsonWriter writer;
+        initWriter( &writer, text, sizeof( text ) - 1 );
+        writeDouble( &writer, value );
+        text[writer.length] = '\0';
+        if ( writer.failed || strtod( text, NULL) != value ) {
+            printTestFailure( "%s, test failed, %.17g was written as %s\n", name, value, text );
+            return;
+        }
+    }
+    printf( "%s, test passed!\n", name );
+}
+
+void test34( char *name, char *input, char *pattern, PatchOperation operation, char *value, char *expected ){
+
+    PatchResult result;
+    char        actual[1024];
+    if ( patchJson((UBYTE *) input, strlen( input ), (UBYTE *) pattern, operation, (UBYTE *) value,
+                   value == NULL ? 0 : strlen( value ), &result )) {
+        UBYTE *output = joinPatch( &result, NULL);
+        sprintf( actual, "%s", (char *) output );
+        free( output );
+    } else {
+        sprintf( actual, "failed %d", result.valueType );
+    }
+
+    if ( strcmp( actual, expected ) == 0 ) {
+        printf( "%s, test passed!\n", name );
+    } else {
+        printTestFailure( "%s, test failed, expected: [%s], actual: [%s]\n", name, expected, actual );
+    }
+}
+
+/* 跳过很深的嵌套数组，mismatched时最里层用}结束 */
+void test35( char *name, size_t depth, bool mismatched, char *expected ){
+
+    char   *input = malloc( depth * 2 + 32 );
+    size_t length = (size_t) sprintf( input, "{\"a\":" );
+    for ( size_t i = 0; i < depth; i++ ) input[length++] = '[';
+    for ( size_t i = 0; i < depth; i++ ) input[length++] = mismatched && i == 0 ? '}' : ']';
+    length += (size_t) sprintf( input + length, ",\"x\":2}" );
+
+    Search search  = { .pattern = (UBYTE *) "x", .valueType = J_NOT_FOUND, .options = S_NORMAL };
+    void   *result = macroKeyValueSearchWithLength((UBYTE *) input, length, &search );
+    printTestResult( name, result, expected, search.valueType );
+    free( result );
+    free( input );
+}
+
+/* 格式错误的数组，不管几个线程都必须失败 */
+void test36( char *name, char *input, size_t inputLength, size_t threadCount ){
+
+    size_t       elementCount = 0;
+    NdjsonRecord *elements    = parallelArraySearch( NULL, (UBYTE *) input, inputLength, threadCount, &elementCount );
+    if ( elements == NULL) {
+        printf( "%s, test passed!\n", name );
+    } else {
+        printTestFailure( "%s, test failed, expected a parse error, actual elements: [%zu]\n", name, elementCount );
+    }
+    free( elements );
+}
+
+bool countMatch( void *context, const UBYTE *path, size_t pathLength, const ValueSpan *span ){
+
+    ( *(size_t *) context )++;
+    return path[pathLength] == '\0' && span->valueType == J_INT;
+}
+
+/* 很深的嵌套数组，最里面是{"k":1} */
+void test37( char *name, size_t depth, size_t maxDepth, size_t expectedCount ){
+
+    char   *input = malloc( depth * 2 + 16 );
+    size_t length = 0;
+    for ( size_t i = 0; i < depth; i++ ) input[length++] = '[';
+    length += (size_t) sprintf( input + length, "{\"k\":1}" );
+    for ( size_t i = 0; i < depth; i++ ) input[length++] = ']';
+
+    size_t called = 0, count = 0;
+    bool   ok     = macroKeyValueSearchAll((UBYTE *) input, length, (UBYTE *) "k", 0, maxDepth, countMatch, &called,
+                                           &count );
+    if ( ok && count == expectedCount && called == expectedCount ) {
+        printf( "%s, test passed!\n", name );
+    } else {
+        printTestFailure( "%s, test failed, expected: [%zu], actual: [%d %zu]\n", name, expectedCount, ok, count );
+    }
+    free( input );
+}
+
+/* 在很深的数组之后查找，建立tape和对象索引不应该耗尽调用栈 */
+void test38( char *name, size_t depth ){
+
+    char   *input = malloc( depth * 2 + 32 );
+    size_t length = (size_t) sprintf( input, "{\"a\":" );
+    for ( size_t i = 0; i < depth; i++ ) input[length++] = '[';
+    length += (size_t) sprintf( input + length, "{\"k\":7}" );
+    for ( size_t i = 0; i < depth; i++ ) input[length++] = ']';
+    length += (size_t) sprintf( input + length, ",\"x\":2}" );
+
+    char      actual[64];
+    JsonTape  *tape = buildTape((UBYTE *) input, length );
+    ValueSpan tail  = { 0, 0, J_NOT_FOUND }, leaf = { 0, 0, J_NOT_FOUND }, indexed = { 0, 0, J_NOT_FOUND };
+    if ( tape != NULL) {
+        tapeKeySearch( tape, (UBYTE *) "x", S_NORMAL, &tail );
+        tapeKeySearch( tape, (UBYTE *) "k", S_RECURSIVE, &leaf );
+        freeTape( tape );
+    }
+    ObjectIndex *index = buildObjectIndex((UBYTE *) input, length );
+    if ( index != NULL) {
+        Search search = { .pattern = (UBYTE *) "x", .valueType = J_NOT_FOUND, .options = S_NORMAL };
+        objectIndexSearch( index, &search, &indexed );
+        freeObjectIndex( index );
+    }
+    sprintf( actual, "%.*s %.*s %.*s", (int) tail.length, input + tail.offset, (int) leaf.length,
+             input + leaf.offset, (int) indexed.length, input + indexed.offset );
+    free( input );
+
+    if ( strcmp( actual, "2 7 2" ) == 0 ) printf( "%s, test passed!\n", name );
+    else printTestFailure( "%s, test failed, expected: [2 7 2], actual: [%s]\n", name, actual );
+}
+
+/* 对象索引与线性查找使用同样的Search，结果必须一致 */
+void test39( char *name, char *input, Search search, char *expected ){
+
+    ObjectIndex *index  = buildObjectIndex((UBYTE *) input, strlen( input ));
+    Search      linear  = search;
+    ValueSpan   span    = { 0, 0, J_NOT_FOUND };
+    objectIndexSearch( index, &search, &span );
+    freeObjectIndex( index );
+
+    void *value = macroKeyValueSearch((UBYTE *) input, &linear );
+    free( value );
+    if ( linear.valueType != search.valueType ) {
+        printTestFailure( "%s, test failed, linear search: [%d], index: [%d]\n", name, linear.valueType,
+                          search.valueType );
+        return;
+    }
+
+    printTestResult( name, getValueBySpan((UBYTE *) input, &span ), expected, span.valueType );
+}
+
+int main(){
+
+    test( "1", "{\"x\":\"1\"}", "x", "string is 1", true );
+    test( "2", "    {   \"x22\"   :  123  }", "x22", "number is 123", true );
+    test( "3", "    {   \"x22\"   :  12890000  }", "x222", "not found...", true );
+    test( "4", "    {   \"x22\"   :  [ 12.99, 0.989, 99.9, \"\",{} ]  }", "x22",
+          "array is [ 12.99, 0.989, 99.9, \"\",{} ]", true );
+    test( "5", "    {  \"1\": true,  \"x22\"   :  [ 12, 99, 99, \"\",{} ]  }", "1", "value is true", true );
+    test( "6", "    {  \"1\": true,  \"x22\"   :  [ 12, 99, 99, \"\",{} ],\"3\": null  }", "3", "value is null", true );
+    test( "7", "    {  \"1\": true,  \"x22\"   :  [ 12, 99, 99, \"\",{} ],\"3\": { "
+               "\"user\":{},"
+               "\"data\":\"x12345\""
+               "}", "data", "string is x12345", true );
+    test( "8", "    {  \"1\": true,  \"x22\"   :  [ 12, 99, 99, \"\", { \"data\" : \"59\" } ],\"3\": null  }", "data",
+          "string is 59", true );
+    test( "9", "    {  \"我0\": true,  \"x22\"   :  [ 12, 99, 99, \"\", { \"data\" : 59.980 } ],\"3\": null  }", "我0",
+          "value is true", true );
+    test( "10", "    {  \"0\": \"1233\",  \"x22\"   :  [ 12, 99, 99, \"\", { \"data\" : 59 } ],\"3\": \"我的\"  }", "3",
+          "string is 我的", true );
+    test( "11", "    {  \"0\": \"12{33\",  \"x2}2\"   :  [ 12, 99, 99, \"\", { \"data\" : 59 } ],\"3\": {}  }", "3",
+          "obj is {}", true );
+    test( "12", "    {     }   ", "1", "not found...", true );
+    test( "13", " {   \"x\":  12}", "", "not found...", true );
+    test( "14", " {   \"x\":  12}", "xx", "not found...", true );
+    test( "15", " {   \"xxx\":  12}", "xx", "not found...", true );
+    test( "16", " {   ", "xx", "parse error", true );
+
+    test( "17", "    {  \"0\": \"12{33\",  \"x2}2\"   :  [ 12, 99, 99, \"\", { \"data\" : 59 } ],\"3\": {}  }", "data",
+          "not found...", false );
+    test( "18", "    {  \"0\": \"12{33\",  \"x2}2\"   :  [ 12, 99, 99, \"\", { \"data\" : 59 } ],\"3\": {}  }", "3",
+          "obj is {}", false );
+
+
+    test2( "19", "{\"user\":\"1234\"}", 0, "parse error" );
+    test2( "20", "{\"user\":\"1234\"}", 1, "parse error" );
+    test2( "21", "   [  \"user\"   ,    0.1234   ]    ", 1, "number is 0.123400000" );
+    test2( "22", "   [  \"user\"   ,    \"1234\"   }    ", 1, "string is 1234" );
+    test2( "23", "   [  \"user\"   ]   \"1234\"   }    ", 1, "parse error" );
+    test2( "24", "   [  0   ]   99      ", 0, "number is 0" );
+
+    char  *json = "{\n"
+                  "  \"code\": 1000,\n"
+                  "  \"msg\": null,\n"
+                  "  \"data\": {\n"
+                  "    \"user\": {\n"
+                  "      \"userId\": 100001,\n"
+                  "      \"address\": \"安徽 黄山\",\n"
+                  "      \"age\": 20,\n"
+                  "      \"avatar\": \"http://www.qiniu.com/img/we.png\",\n"
+                  "      \"avatarList\": [\n"
+                  "               {\n"
+                  "                    \"avatarId\": \"JIHJSKJHKHH987JG\",\n"
+                  "                    \"url\": \"http://www.qiniu.com/img/we.png\",\n"
+                  "                    \"status\": 1\n"
+                  "                },\n"
+                  "                 {\n"
+                  "                    \"avatarId\": \"JIHJSKJHKHH987JG\",\n"
+                  "                    \"url\": \"http://www.qiniu.com/img/we.png\",\n"
+                  "                    \"status\": 100\n"
+                  "                }\n"
+                  "      ],\n"
+                  "      \"nick\": \"ss9df11\",\n"
+                  "      \"callRatio\": 90,\n"
+                  "      \"price\": 0,\n"
+                  "      \"selfIntro\": \"我是一只小小小小鸟\",\n"
+                  "       \"selfAudioIntro\" : \"http://wwwww\",\n"
+                  "       \"second\": 34,\n"
+                  "      \"setting\": 0,\n"
+                  "      \"account\": 0,\n"
+                  "      \"followCount\":10,\n"
+                  "      \"fansCount\":2,\n"
+                  "      \"talkTime\":456,\n"
+                  "      \"tags\":\"发放,温柔,儿童\",\n"
+                  "      \"gifts\": [\n"
+                  "       {\n"
+                  "         \"name\":\"草莓\",\n"
+                  "         \"image\":\"http://ww.qiniu.com/img/gift1.png\",\n"
+                  "         \"price\":400,\n"
+                  "         \"amount\":\"4\",\n"
+                  "       },\n"
+                  "       {\n"
+                  "         \"name\":\"香蕉\",\n"
+                  "         \"image\":\"http://ww.qiniu.com/img/gift2.png\",\n"
+                  "         \"price\":1400,\n"
+                  "         \"amount\":\"40\"\n"
+                  "       }],\n"
+                  "       \"loginDuration\" : \"1\",\n"
+                  "       \"recentVisitors\":[\n"
+                  "       {\n"
+                  "          \"userId\" : 123456,\n"
+                  "          \"nick\" : \"昵称昵称\",\n"
+                  "          \"avatar\" : \"http://staticnova.ruoogle.com/avatar/user24566.png\"\n"
+                  "       },\n"
+                  "       {\n"
+                  "          \"userId\" : 123457,\n"
+                  "          \"nicks\" : \"东方不败\",\n"
+                  "          \"avatar\" : \"http://staticnova.ruoogle.com/avatar/user24567.png\"\n"
+                  "       }\n"
+                  "       ]\n"
+                  "    }\n"
+                  "  }\n"
+                  "}";
+    test( "25", json, "nicks", "string is 东方不败", true );
+
+    test3( "26", json, ".data.user.userId", "number is 100001" );
+    test3( "27", json, ".data]39[", "wrong pattern format" );
+    test3( "28", json, "[.9.9]", "wrong pattern format" );
+    test3( "29", json, "[.9.]", "wrong pattern format" );
+    test3( "30", json, ".data.user.avatarList[1].status", "number is 100" );
+
+    json = "[ [ 1, 2 ,3  ]  ,[  2  ,  3,   4  ],[3,4,  [  4 , 5 , 4   ]  ]  ]";
+
+    // array
+    test2( "31", json, 2, "array is [3,4,  [  4 , 5 , 4   ]  ]" );
+    test3( "32", json, "[2][2][1]", "number is 5" );
+
+    // number
+    test( "33", "{\"data\":939485858585858585845}", "data", "number is -2147483648", true );
+    test( "34", "{\"data\":-12233.3434899}", "data", "number is -12233.343489900", true );
+    test( "35", "{\"data\":-12233.34567}", "data", "number is -12233.345670000", true );
+    test( "36", "{\"data\":-0}", "data", "number is 0", true );
+
+    // parse error
+    test( "37", "{\"data\":-0.8ab3,\"user\":\"myname\"}", "user", "parse error", false );
+    test2( "38", "[2.a, 4444,838]", 2, "parse error" );
+    test2( "39", "[2.a 4444,838]", 2, "parse error" );
+
+    json = "{\n"
+           "    \"l1\": {\n"
+           "        \"l1_1\": [\n"
+           "            \"l1_1_1\",\n"
+           "            \"l1_1_2\"\n"
+           "        ],\n"
+           "        \"l1_2\": {\n"
+           "            \"l1_2_1\": 121\n"
+           "        }\n"
+           "    },\n"
+           "    \"l2\": {\n"
+           "        \"l2_1\": null,\n"
+           "        \"l2_2\": true,\n"
+           "        \"l2_3\": }\n"
+           "    }\n"
+           "}";
+    test( "40", json, "l2_3", "parse error", true );
+
+    json = "{\n"
+           "    \"l1\": {\n"
+           "        \"l1_1\": [\n"
+           "            \"l1_1_1\",\n"
+           "            \"l1_1_2\"\n"
+           "        ],\n"
+           "        \"l1_2\": {\n"
+           "            \"l1_2_1\": 121\n"
+           "        }\n"
+           "    },\n"
+           "    \"l2\": {\n"
+           "        \"l2_1\": null,\n"
+           "        \"l2_2\": true,\n"
+           "        \"l2_3\": {\"dafadfa\":          ,\"3383\"}\n"
+           "    }\n"
+           "}";
+    test( "41", json, "l2_3", "parse error", true );
+
+    json = "{\n"
+           "    \"l1\": {\n"
+           "        \"l1_1\": [\n"
+           "            \"l1_1_1\",\n"
+           "            \"l1_1_2\"\n"
+           "        ],\n"
+           "        \"l1_2\": {\n"
+           "            \"l1_2_1\": 121\n"
+           "        }\n"
+           "    },\n"
+           "    \"l2\": {\n"
+           "        \"l2_1\": null,\n"
+           "        \"l2_2\": true,\n"
+           "        \"l2_3\": {}\n"
+           "    }\n"
+           "}";
+    test( "42", json, "l2_2", "value is true", true );
+    test3( "43", json, ".l1.l1_1[1]", "string is l1_1_2" );
+
+    test2( "44", "[8548588]", 0, "number is 8548588" );
+    test2( "45", "[\"d9d9d\" \"ddd\"]", 1, "parse error" );
+    test2( "46", "[\"d9d9d\", 0x999, \"ddd\"]", 2, "parse error" );
+    test2( "47", "[\"d9d9d\", 0x999, \"ddd\"}", 2, "parse error" );
+    test2( "48", "[\"d9d9d\", 0x999, \"ddd\",", 2, "parse error" );
+    test2( "49", "[\"d9d9d\", 0x999, \"ddd\"", 2, "parse error" );
+    test2( "50", "{\"d9d9d\", \"0x999\", \"ddd\"}", 2, "parse error" );
+
+    test( "51", "{\"user\"::\"ddd\"}", "ddd", "parse error", true );
+    test( "52", "{\"user\":[],\"user\":{},\"9\":null}", "user", "array is []", true );
+    test( "53", "{\"user\":{},\"user\":{},\"9\":null}", "", "not found...", true );
+    test( "54", "{\"user\":{},\"user2\":[],\"9\":null}", "9", "value is null", true );
+    test3( "55", "{\"user\":{},\"user2\":[[[]],{},{},[]],\"9\":null}", ".user2[3]", "array is []" );
+    test3( "56", "{\"user\":{},\"user2\":[[[]],{},{},[]],\"9\":null}", ".user2[0][0]", "array is []" );
+    test3( "57", "{\"user\":{},\"user2\":[[[1]],{},{},[]],\"9\":null}", ".user2[0][0][0]", "number is 1" );
+    test3( "58", "{\"user\":{},\"user2\":[[[1]],{},{},[[1],[],[\"111\"]]],\"9\":null}", ".user2[3][0][0]",
+           "number is 1" );
+    test( "59", "{\"user\":{},\"user2\":[[[{\"data\":[]}]],{},{},[[1],[],[\"111\"]]],\"9\":null}", "data", "array is []",
+          true );
+
+    test3( "60", "{}", ".user", "not found..." );
+    test3( "61", "{\"data\":{\"user\":{}}}", ".data.user.temp", "not found..." );
+    test3( "62", "", ".", "wrong pattern format" );
+    test3( "63", "{}", ".0", "not found..." );
+    test( "64", "", "", "parse error", true );
+    test2( "65", "", 0, "parse error" );
+    test( "66", "{\"\":null}", "", "value is null", true );
+    test2( "67", "", 0, "parse error" );
+
+    // NULL testing
+    test( "68", NULL, "", "parse error", false );
+    test( "69", NULL, "", "parse error", true );
+    test2( "70", NULL, 0, "parse error" );
+    test2( "71", "[1,2,2,2,2,]", -2, "wrong pattern format" );
+    test2( "72", "[1,2,2,2,2]", -2, "wrong pattern format" );
+    test2( "73", "[1,2,2,2,2]", 5, "not found..." );
+    test( "74", "[1,2,2,2,2]", NULL, "wrong pattern format", false );
+    test( "75", "[1,2,2,2,2]", NULL, "wrong pattern format", false );
+    test3( "76", "[111,222]", NULL, "wrong pattern format" );
+
+    json = "{\n"
+           "\t\"some\":{\n"
+           "\t\t\"data\":\n"
+           "\t\t[\n"
+           "\t\t\t{\n"
+           "\t\t\t\t\"something\":\"ag\",\n"
+           "\t\t\t\t\"haha\":\"another\",\n"
+           "\t\t\t\t\"num\":65536\n"
+           "\t\t\t}\n"
+           "\t\t\t[\n"
+           "\t\t\t\ttrue,\n"
+           "\t\t\t\tfalse,\n"
+           "\t\t\t\tnull,\n"
+           "\t\t\t\t65535,\n"
+           "\t\t\t\t{\"again\":1122}\n"
+           "\t\t\t],\n"
+           "\t\t\t12234532,\n"
+           "\t\t\t{\n"
+           "\t\t\t  \"empty\":{},\n"
+           "\t\t\t  \"null\":null,\n"
+           "\t\t\t  \"false\":false,\n"
+           "\t\t\t  \"true\":true\n"
+           "\t\t\t  \"eArray\":[]\n"
+           "\t\t\t}\n"
+           "\t\t]\n"
+           "\t}\n"
+           "}";
+    test("77",json,"empty","parse error",true);
+
+    // span path search, offset in the original input
+    json = "{\"data\":{\"user\":[{\"age\":1},{\"age\":20,\"tags\":[\"a\",\"b\"]}]}}";
+    test4( "78", json, ".data.user[1].age", 34, "number is 20" );
+    test4( "79", json, ".data.user[1].tags", 44, "array is [\"a\",\"b\"]" );
+    test4( "80", json, ".data.user[1].tags[1]", 49, "string is b" );
+    test4( "81", json, ".data.user[1].name", 0, "not found..." );
+    test4( "82", json, ".data.user[x]", 0, "wrong pattern format" );
+    test4( "83", json, ".data.users", 0, "not found..." );
+
+    // length delimited input, no '\0' ending required
+    test5( "84", "{\"a\":1,\"b\":22}garbage", 15, "b", "number is 22", false );
+    test5( "85", "{\"a\":1,\"b\":22}", 10, "b", "parse error", false );
+    test5( "86", "[{\"a\":{\"b\":[7]}}]", 18, "b", "array is [7]", true );
+    test5( "87", "{\"a\":1}", 0, "a", "parse error", false );
+    test6( "88", "{\"a\":[1,{\"b\":-0.5}]}####", 20, ".a[1].b", "number is -0.500000000" );
+    test6( "89", "{\"a\":[1,{\"b\":-0.5}]}", 12, ".a[1].b", "parse error" );
+
+    // larger than cSOURCE_LENGTH_MAX
+    size_t bigLength = 1024 * 1024;
+    char   *big      = (char *) malloc( bigLength );
+    memset( big, ' ', bigLength );
+    big[0] = '{';
+    memcpy( big + bigLength - 12, "\"last\":true}", 12 );
+    test5( "90", big, bigLength, "last", "value is true", false );
+    big[bigLength - 1] = '\0';
+    test( "91", big, "last", "parse error", false );
+    free( big );
+
+    // compiled path
+    CompiledPath *path = compilePath((UBYTE *) ".data.user[1].age" );
+    test7( "92", "{\"data\":{\"user\":[{\"age\":1},{\"age\":20}]}}", path, "number is 20" );
+    test7( "93", "{\"data\":{\"user\":[{\"age\":1},{\"age\":\"old\"}]}}", path, "string is old" );
+    test7( "94", "{\"data\":{\"user\":[{\"age\":1},{\"name\":1}]}}", path, "not found..." );
+    test7( "95", "{\"data\":{\"user\":[{\"age\":1},{\"age\":}]}}", path, "parse error" );
+    freeCompiledPath( path );
+    test7( "96", "{}", compilePath((UBYTE *) ".data]39[" ), "wrong pattern format" );
+    test7( "97", "{}", compilePath((UBYTE *) "[]" ), "wrong pattern format" );
+    path = compilePath((UBYTE *) "[2][2][1]" );
+    test7( "98", "[ [ 1, 2 ,3  ]  ,[  2  ,  3,   4  ],[3,4,  [  4 , 5 , 4   ]  ]  ]", path, "number is 5" );
+    freeCompiledPath( path );
+
+    // multiple paths in one pass
+    json = "{\"id\":7,\"skip\":{\"id\":8,\"x\":[1,2,{}]},\"data\":{\"user\":[{\"age\":1},{\"age\":20}],"
+           "\"name\":\"tom\"},\"tail\":[true,null]}";
+    char *patterns99[] = { ".data.user[1].age", ".id", ".data.name", ".tail[1]", ".data.user", ".nothing", ".id" };
+    char *expected99[] = { "number is 20", "number is 7", "string is tom", "value is null",
+                           "array is [{\"age\":1},{\"age\":20}]", "not found...", "number is 7" };
+    test8( "99", json, patterns99, 7, expected99 );
+
+    char *patterns100[] = { ".a", ".b.c" };
+    char *expected100[] = { "number is 1", "parse error" };
+    test8( "100", "{\"a\":1,\"b\":{\"c\" 2}}", patterns100, 2, expected100 );
+
+    char *patterns101[] = { "[0].a", "[2]" };
+    char *expected101[] = { "string is x", "value is false" };
+    test8( "101", " [ {\"a\":\"x\"}, [ ], false ] ", patterns101, 2, expected101 );
+
+    // skip nested values in bulk
+    test9( "102" );
+    test( "103", "{\"a\":{\"s\":\"x\\\\\\\"}]\",\"t\":[[{}],\"]\"]},\"b\":\"0123456789abcdef0123456789abcdef\\\"\"}", "b",
+          "string is 0123456789abcdef0123456789abcdef\"", false );
+    test( "104", "{\"a\":[{\"b\":1},[[\"}\"]]],\"c\":{\"d\":{\"b\":2}},\"b\":3}", "b", "number is 3", false );
+    test( "105", "{\"a\":[{\"b\":1},[[\"}\"]]],\"c\":{\"d\":{\"b\":2}},\"b\":3}", "b", "number is 1", true );
+    test( "106", "{\"a\":[{\"b\":1},[[\"}\"]],\"b\":3}", "b", "parse error", false );
+
+    // tape, parse once and search many times
+    json = "{\"code\":1000,\"data\":{\"user\":[{\"age\":1,\"tags\":[]},{\"age\":20,\"nick\":\"tom\"}],"
+           "\"empty\":{}},\"list\":[ true , null , -1.5 ] , \"nick\":\"top\"}";
+    JsonTape *tape = buildTape((UBYTE *) json, strlen( json ));
+    test10( "107", tape, ".data.user[1].age", "number is 20" );
+    test10( "108", tape, ".data.user[0].tags", "array is []" );
+    test10( "109", tape, ".list[2]", "number is -1.500000000" );
+    test10( "110", tape, ".list[3]", "not found..." );
+    test10( "111", tape, ".data.empty.x", "not found..." );
+    test10( "112", tape, ".data]", "wrong pattern format" );
+    test10( "113", tape, ".code", "number is 1000" );
+
+    ValueSpan span;
+    tapeKeySearch( tape, (UBYTE *) "nick", S_RECURSIVE, &span );
+    printTestResult( "114", getValueBySpan((UBYTE *) json, &span ), "string is tom", span.valueType );
+    tapeKeySearch( tape, (UBYTE *) "nick", S_NORMAL, &span );
+    printTestResult( "115", getValueBySpan((UBYTE *) json, &span ), "string is top", span.valueType );
+    path = compilePath((UBYTE *) ".data.user[0]" );
+    tapeCompiledPathSearch( tape, path, &span );
+    printTestResult( "116", getValueBySpan((UBYTE *) json, &span ), "obj is {\"age\":1,\"tags\":[]}", span.valueType );
+    freeCompiledPath( path );
+    freeTape( tape );
+
+    tape = buildTape((UBYTE *) "[1,2,{\"a\":[3,]}]", 17 );
+    test10( "117", tape, "[0]", "parse error" );
+    tape = buildTape((UBYTE *) " [1, 2 ,[3]] ", 13 );
+    tapeIndexSearch( tape, 2, &span );
+    printTestResult( "118", getValueBySpan( tapeInput( tape ), &span ), "array is [3]", span.valueType );
+    freeTape( tape );
+
+    // results in arena
+    UBYTE arenaBuffer[64];
+    Arena arena;
+    initArena( &arena, arenaBuffer, sizeof( arenaBuffer ));
+    json = "{\"a\":1,\"b\":2.5,\"c\":\"str\",\"d\":null,\"e\":[1,2,3,4,5,6,7,8,9,10,11,12,13,14,15,16,17,18,19,20]}";
+    test11( "119", &arena, json, "a", "number is 1", true );
+    test11( "120", &arena, json, "b", "number is 2.500000000", true );
+    test11( "121", &arena, json, "c", "string is str", true );
+    test11( "122", &arena, json, "d", "value is null", true );
+    test11( "123", &arena, json, "e", "array is [1,2,3,4,5,6,7,8,9,10,11,12,13,14,15,16,17,18,19,20]", false );
+    test11( "124", &arena, json, "x", "not found...", true );
+    resetArena( &arena );
+    if ( arena.used == 0 && arena.overflow == NULL) printf( "125, test passed!\n" );
+    else printTestFailure( "125, test failed, arena not empty after reset\n" );
+    test11( "126", &arena, json, "c", "string is str", true );
+    releaseArena( &arena );
+
+    // typed accessors
+    json = "{\"big\":9223372036854775807,\"min\":-9223372036854775808,\"over\":9223372036854775808,"
+           "\"f\":-0.25,\"t\":true,\"n\":null,\"s\":\"a\\\"b\",\"o\":{}}";
+    test12( "127", json, ".big", "int64 is 9223372036854775807" );
+    test12( "128", json, ".min", "int64 is -9223372036854775808" );
+    test12( "129", json, ".over", "double is 9.22337204e+18" );
+    test12( "130", json, ".f", "double is -0.25" );
+    test12( "131", json, ".t", "bool is true" );
+    test12( "132", json, ".n", "no value" );
+    test12( "133", json, ".s", "view is a\\\"b" );
+    test12( "134", json, ".o", "no value" );
+    test12( "135", json, ".x", "no value" );
+
+    // number engine
+    test13( "136" );
+    test12( "137", "{\"e\":-1.5E+3}", ".e", "double is -1500" );
+    test12( "138", "{\"e\":25e-1 }", ".e", "double is 2.5" );
+    test12( "139", "{\"e\":0e0}", ".e", "double is 0" );
+    test( "140", "{\"e\":1e}", "e", "parse error", false );
+    test( "141", "{\"e\":1.5.3}", "e", "parse error", false );
+    test( "142", "{\"e\":1.5e+}", "e", "parse error", false );
+    test( "143", "{\"e\":12e2}", "e", "number is 1200.000000000", false );
+
+    // streaming parser
+    json = "{\"a\":{\"b\":[10, {\"c\":\"x\\\"}\"}, -2.5e1 ],\"d\":true},\"e\":{\"c\":null}}";
+    CompiledPath *streamPath     = compilePath((UBYTE *) ".a.b[1].c" );
+    StreamParser *streamParser   = createStreamPathParser( streamPath, 8, 64 );
+    test14( "144", streamParser, json, "\"x\\\"}\"" );
+    freeStreamParser( streamParser );
+    freeCompiledPath( streamPath );
+
+    streamPath   = compilePath((UBYTE *) ".a.b[2]" );
+    streamParser = createStreamPathParser( streamPath, 8, 64 );
+    test14( "145", streamParser, json, "-2.5e1" );
+    test14( "146", streamParser, "{\"a\":{\"b\":[1,2]}}", "not found" );
+    test14( "147", streamParser, "{\"a\":{\"b\":[1,2,3x]}}", "parse error" );
+    test14( "148", streamParser, "{\"a\":{\"b\":[1,2,", "parse error" );
+    freeStreamParser( streamParser );
+    freeCompiledPath( streamPath );
+
+    streamPath   = compilePath((UBYTE *) ".a" );
+    streamParser = createStreamPathParser( streamPath, 8, 64 );
+    test14( "149", streamParser, json, "{\"b\":[10, {\"c\":\"x\\\"}\"}, -2.5e1 ],\"d\":true}" );
+    freeStreamParser( streamParser );
+    streamParser = createStreamPathParser( streamPath, 2, 64 );
+    test14( "150", streamParser, json, "parse error" );
+    freeStreamParser( streamParser );
+    streamParser = createStreamPathParser( streamPath, 8, 16 );
+    test14( "151", streamParser, json, "parse error" );
+    freeStreamParser( streamParser );
+    freeCompiledPath( streamPath );
+
+    streamParser = createStreamKeyParser((UBYTE *) "c", S_RECURSIVE, 8, 64 );
+    test14( "152", streamParser, json, "\"x\\\"}\"" );
+    freeStreamParser( streamParser );
+    streamParser = createStreamKeyParser((UBYTE *) "c", S_NORMAL, 8, 64 );
+    test14( "153", streamParser, json, "not found" );
+    test14( "154", streamParser, "12", "not found" );
+    test14( "155", streamParser, "[1,]", "parse error" );
+    test14( "156", streamParser, " { \"b\" : 1 , \"c\" : false } ", "false" );
+    freeStreamParser( streamParser );
+
+    // NDJSON
+    json = "{\"id\":1,\"s\":\"a\\\"\"}\n\n  \r\n{\"s\":\"x\ny\",\"id\":[2]}\r\n{\"id\":}\n{\"x\":{\"id\":4}}";
+    size_t       recordCount;
+    NdjsonRecord *records = ndjsonKeySearch((UBYTE *) "id", S_RECURSIVE, (UBYTE *) json, strlen( json ), 0,
+                                            &recordCount );
+    if ( records != NULL && recordCount == 4 ) {
+        printTestResult( "157", getValueBySpan((UBYTE *) json, &records[0].value ), "number is 1",
+                         records[0].value.valueType );
+        printTestResult( "158", getValueBySpan((UBYTE *) json, &records[1].value ), "array is [2]",
+                         records[1].value.valueType );
+        printTestResult( "159", getValueBySpan((UBYTE *) json, &records[2].value ), "parse error",
+                         records[2].value.valueType );
+        printTestResult( "160", getValueBySpan((UBYTE *) json, &records[3].value ), "number is 4",
+                         records[3].value.valueType );
+    } else {
+        printTestFailure( "157, test failed, expected records: [4]\n" );
+    }
+    free( records );
+
+    size_t ndjsonCapacity = 4 << 20, ndjsonLength = 0, ndjsonCount = 0;
+    char   *ndjson        = malloc( ndjsonCapacity );
+    while ( ndjsonLength < ndjsonCapacity - 4096 ) {
+        if ( ndjsonCount % 50 == 7 ) {
+            // 字符串中的换行符，线程的起始位置可能会推测错
+            ndjsonLength += (size_t) sprintf( ndjson + ndjsonLength, "{\"s\":\"" );
+            for ( int k = 0; k < 200; k++ ) {
+                ndjsonLength += (size_t) sprintf( ndjson + ndjsonLength, "\n{\\\"id\\\":0}" );
+            }
+            ndjsonLength += (size_t) sprintf( ndjson + ndjsonLength, "\",\"id\":%zu}\n", ndjsonCount );
+        } else {
+            ndjsonLength += (size_t) sprintf( ndjson + ndjsonLength, "{\"id\":%zu,\"s\":\"a\\\"b\"}\n%s", ndjsonCount,
+                                              ndjsonCount % 100 == 0 ? "\n" : "" );
+        }
+        ndjsonCount++;
+    }
+    streamPath = compilePath((UBYTE *) ".id" );
+    test15( "161", ndjson, ndjsonLength, streamPath, 4, ndjsonCount );
+    test15( "162", ndjson, ndjsonLength, streamPath, 7, ndjsonCount );
+    test15( "163", ndjson, ndjsonLength, streamPath, 64, ndjsonCount );
+    freeCompiledPath( streamPath );
+    free( ndjson );
+
+    // memory-mapped file
+    char       fileName[] = "/tmp/json_parser_XXXXXX";
+    int        fd         = mkstemp( fileName );
+    MappedFile file;
+    json = "{\"a\":{\"b\":[1,\"two\",{\"c\":3.5}]}}";
+    if ( fd >= 0 && write( fd, json, strlen( json )) == (ssize_t) strlen( json ) && openMappedFile( fileName, &file )) {
+        test16( "164", &file, ".a.b[1]", "string is two" );
+        test16( "165", &file, ".a.b[2].c", "number is 3.500000000" );
+        test16( "166", &file, ".a.x", "not found..." );
+        closeMappedFile( &file );
+    } else {
+        printTestFailure( "164, test failed, cannot map [%s]\n", fileName );
+    }
+    if ( fd >= 0 ) {
+        close( fd );
+        unlink( fileName );
+    }
+    if ( !openMappedFile( "/nonexistent/file.json", &file )) printf( "167, test passed!\n" );
+    else printTestFailure( "167, test failed, mapped a missing file\n" );
+
+    // parallel array search
+    json = " [ 1 , {\"a\":\"]\\\\\\\"[\"}, [2,[3]] ,\"x,y\" ] ";
+    size_t       elementCount;
+    NdjsonRecord *elements = parallelArraySearch( NULL, (UBYTE *) json, strlen( json ), 0, &elementCount );
+    if ( elements != NULL && elementCount == 4 ) {
+        printTestResult( "168", getValueBySpan((UBYTE *) json, &elements[0].value ), "number is 1",
+                         elements[0].value.valueType );
+        printTestResult( "169", getValueBySpan((UBYTE *) json, &elements[1].value ),
+                         "obj is {\"a\":\"]\\\\\\\"[\"}", elements[1].value.valueType );
+        printTestResult( "170", getValueBySpan((UBYTE *) json, &elements[2].value ), "array is [2,[3]]",
+                         elements[2].value.valueType );
+        printTestResult( "171", getValueBySpan((UBYTE *) json, &elements[3].value ), "string is x,y",
+                         elements[3].value.valueType );
+    } else {
+        printTestFailure( "168, test failed, expected elements: [4]\n" );
+    }
+    free( elements );
+
+    elements = parallelArraySearch( NULL, (UBYTE *) "[ ]", 3, 0, &elementCount );
+    if ( elements != NULL && elementCount == 0 ) printf( "172, test passed!\n" );
+    else printTestFailure( "172, test failed, expected elements: [0]\n" );
+    free( elements );
+    if ( parallelArraySearch( NULL, (UBYTE *) "{}", 2, 0, &elementCount ) == NULL) printf( "173, test passed!\n" );
+    else printTestFailure( "173, test failed, object is not an array\n" );
+    elements = parallelArraySearch( NULL, (UBYTE *) "[1,]", 4, 0, &elementCount );
+    if ( elements != NULL && elementCount == 2 && elements[1].value.valueType == J_PARSE_ERROR )
+        printf( "174, test passed!\n" );
+    else printTestFailure( "174, test failed, expected a parse error in the second element\n" );
+    free( elements );
+
+    size_t arrayCapacity = 4 << 20, arrayLength = 0, arrayCount = 0;
+    char   *array        = malloc( arrayCapacity );
+    array[arrayLength++] = '[';
+    while ( arrayLength < arrayCapacity - 4096 ) {
+        // 字符串中的括号、逗号和转义符，分段的位置可能在字符串中或者转义符之后
+        arrayLength += (size_t) sprintf( array + arrayLength, "%s{\"s\":\"],[{\\\"", arrayCount == 0 ? "" : ",\n " );
+        memset( array + arrayLength, '\\', arrayCount % 20 * 2 );
+        arrayLength += arrayCount % 20 * 2;
+        arrayLength += (size_t) sprintf( array + arrayLength, "\",\"id\":%zu,\"a\":[[%zu]]}", arrayCount, arrayCount );
+        arrayCount++;
+    }
+    array[arrayLength++] = ']';
+    test17( "175", array, arrayLength, ".id", 4, arrayCount );
+    test17( "176", array, arrayLength, ".a[0]", 7, arrayCount );
+    test17( "177", array, arrayLength, ".s", 64, arrayCount );
+    free( array );
+
+    // array index and iterator
+    test18( "178", " [ 1, \"a,]\" , {\"b\":[2,3]}, [[]], -0.5e3,true ,null ] ", 7 );
+    test18( "179", "[]", 0 );
+    test18( "180", "[ {} ]", 1 );
+    if ( buildArrayIndex((UBYTE *) "[1,2", 4 ) == NULL && buildArrayIndex((UBYTE *) "[1 2]", 5 ) == NULL
+         && buildArrayIndex((UBYTE *) "{}", 2 ) == NULL && buildArrayIndex((UBYTE *) "[1,]", 4 ) == NULL) {
+        printf( "181, test passed!\n" );
+    } else {
+        printTestFailure( "181, test failed, built an index for a malformed array\n" );
+    }
+
+    size_t wideLength = 0;
+    char   *wide      = malloc( 1 << 20 );
+    wide[wideLength++] = '[';
+    for ( int i = 0; i < 20000; i++ ) wideLength += (size_t) sprintf( wide + wideLength, "%s[%d]", i ? "," : "", i );
+    wide[wideLength++] = ']';
+    wide[wideLength]   = '\0';
+    ArrayIndex *wideIndex = buildArrayIndex((UBYTE *) wide, wideLength );
+    ValueSpan  wideSpan;
+    arrayIndexSearch( wideIndex, 19999, &wideSpan );
+    printTestResult( "182", getValueBySpan( arrayIndexInput( wideIndex ), &wideSpan ), "array is [19999]",
+                     wideSpan.valueType );
+    arrayIndexSearch( wideIndex, 20000, &wideSpan );
+    printTestResult( "183", getValueBySpan( arrayIndexInput( wideIndex ), &wideSpan ), "not found...",
+                     wideSpan.valueType );
+    freeArrayIndex( wideIndex );
+    free( wide );
+
+    // hashed object index
+    json = "{\"a\":{\"k\":1,\"b\":[{\"k\":2},{\"x\":{\"k\":3}}]},\"k\":4,\"k\":5,\"s\\\"q\":6,\"e\":{}}";
+    ObjectIndex *objectIndex = buildObjectIndex((UBYTE *) json, strlen( json ));
+    test19( "184", objectIndex, "k", false, "number is 4" );
+    test19( "185", objectIndex, "k", true, "number is 1" );
+    test19( "186", objectIndex, "x", true, "obj is {\"k\":3}" );
+    test19( "187", objectIndex, "x", false, "not found..." );
+    test19( "188", objectIndex, "s\\\"q", false, "number is 6" );
+    test19( "189", objectIndex, "", true, "not found..." );
+    test20( "190", objectIndex, ".a.b[1].x.k", "number is 3" );
+    test20( "191", objectIndex, ".a.b.k", "not found..." );
+    test20( "192", objectIndex, ".e.k", "not found..." );
+    test20( "193", objectIndex, ".a.k", "number is 1" );
+    freeObjectIndex( objectIndex );
+    if ( buildObjectIndex((UBYTE *) "{\"a\":1,}", 8 ) == NULL) printf( "194, test passed!\n" );
+    else printTestFailure( "194, test failed, built an index for a malformed object\n" );
+
+    size_t featureLength = 0;
+    char   *features     = malloc( 1 << 20 );
+    features[featureLength++] = '{';
+    for ( int i = 0; i < 20000; i++ ) {
+        featureLength += (size_t) sprintf( features + featureLength, "%s\"f%d\":{\"w\":%d}", i ? "," : "", i, i );
+    }
+    features[featureLength++] = '}';
+    features[featureLength]   = '\0';
+    objectIndex = buildObjectIndex((UBYTE *) features, featureLength );
+    test19( "195", objectIndex, "f19999", false, "obj is {\"w\":19999}" );
+    test19( "196", objectIndex, "w", true, "number is 0" );
+    test20( "197", objectIndex, ".f12345.w", "number is 12345" );
+    test20( "198", objectIndex, ".f20000.w", "not found..." );
+    freeObjectIndex( objectIndex );
+    free( features );
+
+    char *matches = "{\"id\":1,\"a\":{\"id\":{\"id\":2}},\"list\":[{\"id\":3},[{\"id\":\"4\"}]],\"x\":{\"y\":{\"id\":5}}}";
+    test21( "199", matches, "id", 0, 100, 100, true, 6,
+            ".id=1;.a.id={\"id\":2};.a.id.id=2;.list[0].id=3;.list[1][0].id=\"4\";.x.y.id=5;" );
+    test21( "200", matches, "id", 3, 100, 100, true, 3, ".id=1;.a.id={\"id\":2};.a.id.id=2;" );
+    test21( "201", matches, "id", 0, 100, 2, true, 2, ".id=1;.a.id={\"id\":2};" );
+    test21( "202", matches, "id", 0, 1, 100, true, 1, ".id=1;" );
+    test21( "203", matches, "id", 0, 3, 100, true, 5,
+            ".id=1;.a.id={\"id\":2};.a.id.id=2;.list[0].id=3;.x.y.id=5;" );
+    test21( "204", matches, "id", 0, 0, 100, true, 6,
+            ".id=1;.a.id={\"id\":2};.a.id.id=2;.list[0].id=3;.list[1][0].id=\"4\";.x.y.id=5;" );
+    test21( "205", matches, "none", 0, 100, 100, true, 0, "" );
+    test21( "206", "[{\"id\":1},{\"id\":}]", "id", 0, 100, 100, false, 1, "[0].id=1;" );
+    test21( "207", "[{\"id\":1},{\"id\":}]", "id", 1, 100, 100, true, 1, "[0].id=1;" );
+    test21( "208", " { \"a\" : [ 1 , { \"k\" : true } ] , \"k\" : [ ] } ", "k", 0, 100, 100, true, 2,
+            ".a[1].k=true;.k=[ ];" );
+
+    test22( "209", "plain text", true, "plain text" );
+    test22( "210", "a\\\"b\\\\c\\/d\\b\\f\\n\\r\\t", true, "a\"b\\c/d\b\f\n\r\t" );
+    test22( "211", "caf\\u00e9 \\u4e2d \\u0041", true, "caf\xc3\xa9 \xe4\xb8\xad A" );
+    test22( "212", "\\ud83d\\ude00!", true, "\xf0\x9f\x98\x80!" );
+    test22( "213", "0123456789abcdef0123456789abcdef0123456789\\n0123456789abcdef0123456789abcdef", true,
+            "0123456789abcdef0123456789abcdef0123456789\n0123456789abcdef0123456789abcdef" );
+    test22( "214", "\\ud83d", false, "" );
+    test22( "215", "\\ud83dx\\ude00", false, "" );
+    test22( "216", "\\ude00", false, "" );
+    test22( "217", "\\x41", false, "" );
+    test22( "218", "\\u00g1", false, "" );
+    test22( "219", "tail\\", false, "" );
+    test( "220", "{\"s\":\"line\\nnext \\u00e9\"}", "s", "string is line\nnext \xc3\xa9", false );
+    test( "221", "{\"caf\\u00e9\":1}", "caf\xc3\xa9", "not found...", false );
+    test23( "222", "{\"caf\\u00e9\":1}", "caf\xc3\xa9", "number is 1", false );
+    test23( "223", "{\"a\":{\"q\\\"k\":2}}", "q\"k", "number is 2", true );
+    test23( "224", "{\"\\ud83d\\ude00\":3,\"x\":4}", "\xf0\x9f\x98\x80", "number is 3", false );
+    test23( "225", "{\"ab\\n\":1,\"ab\":5}", "ab", "number is 5", false );
+    test23( "226", "{\"plain\":6}", "plain", "number is 6", false );
+
+    test24( "227", "{\"a\":[1,-0.5,2e10,1E-2,true,false,null,\"x\\u00e9\\n\"],\"b\":{}} ", true, 60 );
+    test24( "228", "[1.]", false, 1 );
+    test24( "229", "[01]", false, 2 );
+    test24( "230", "[.5]", false, 1 );
+    test24( "231", "[+1]", false, 1 );
+    test24( "232", "[1e]", false, 1 );
+    test24( "233", "[\"a\tb\"]", false, 3 );
+    test24( "234", "[\"\\x\"]", false, 2 );
+    test24( "235", "{\"a\":1,}", false, 7 );
+    test24( "236", "[1,]", false, 3 );
+    test24( "237", "{\"a\" 1}", false, 5 );
+    test24( "238", "[1] x", false, 4 );
+    test24( "239", "[tru]", false, 1 );
+    test24( "240", "[\"\xc3\xa9\xc3\"]", false, 4 );
+    test24( "241", "[\"\xed\xa0\x80\"]", false, 2 );
+    test24( "242", "", false, 0 );
+    test24( "243", "[[[[]]]]", true, 8 );
+    test24( "244", "[[[[]]]", false, 7 );
+    test25( "245" );
+    test26( "246", "{\"a\":1,\"b\":1.}", "a", "parse error" );
+    test( "247", "{\"a\":1,\"b\":1.}", "a", "number is 1", true );
+    test26( "248", "{\"a\":{\"b\":\"\xe4\xb8\xad\"}}", "b", "string is \xe4\xb8\xad" );
+
+    size_t nestedLength = 200000;
+    char   *nested      = malloc( nestedLength * 2 + 1 );
+    memset( nested, '[', nestedLength );
+    memset( nested + nestedLength, ']', nestedLength );
+    nested[nestedLength * 2] = '\0';
+    test24( "249", nested, true, nestedLength * 2 );
+    free( nested );
+
+    char  *queryDocument = "{\"id\":1,\"user\":{\"name\":\"Tom\",\"caf\\u00e9\":[1,{\"id\":2}]},\"bad\":1.}";
+    Query *queries[]     = { createKeyQuery((UBYTE *) "id", S_NORMAL, Q_NONE ),
+                             createKeyQuery((UBYTE *) "name", S_RECURSIVE, Q_NONE ),
+                             createKeyQuery((UBYTE *) "name", S_NORMAL, Q_NONE ),
+                             createKeyQuery((UBYTE *) "caf\xc3\xa9", S_RECURSIVE, Q_UNESCAPE_KEY ),
+                             createPathQuery((UBYTE *) ".user.caf\\u00e9[1].id", Q_NONE ),
+                             createKeyQuery((UBYTE *) "id", S_RECURSIVE, Q_STRICT ),
+                             createPathQuery((UBYTE *) ".user.name", Q_STRICT ) };
+    size_t queryCount    = sizeof( queries ) / sizeof( queries[0] );
+    test27( "250", queries[0], queryDocument, "number is 1" );
+    test27( "251", queries[1], queryDocument, "string is Tom" );
+    test27( "252", queries[2], queryDocument, "not found..." );
+    test27( "253", queries[3], queryDocument, "array is [1,{\"id\":2}]" );
+    test27( "254", queries[4], queryDocument, "number is 2" );
+    test27( "255", queries[5], queryDocument, "parse error" );
+    test27( "256", queries[6], queryDocument, "parse error" );
+    test27( "257", queries[6], "{\"user\":{\"name\":\"Ann\"}}", "string is Ann" );
+    test27( "258", queries[0], "{\"id\":", "parse error" );
+    if ( createPathQuery((UBYTE *) "user", Q_NONE ) == NULL && createKeyQuery( NULL, S_NORMAL, Q_NONE ) == NULL)
+        printf( "259, test passed!\n" );
+    else printTestFailure( "259, test failed, created a query from a wrong pattern\n" );
+
+    const char *queryDocuments[] = { queryDocument, "{\"user\":{\"name\":\"Ann\"},\"id\":[1,2,3]}", "[1,2]",
+                                     "{\"a\":{\"b\":{\"id\":\"deep\"}},\"name\":null}", "{\"id\"" };
+    test28( "260", queries, queryCount, queryDocuments, sizeof( queryDocuments ) / sizeof( queryDocuments[0] ));
+    for ( size_t i = 0; i < queryCount; i++ ) freeQuery( queries[i] );
+
+    test29( "261", "{\"a\":{\"b\":[{\"c\":1}]}}", "c", 4, "number is 1" );
+    test29( "262", "{\"a\":{\"b\":[{\"c\":1}]}}", "c", 3, "parse error" );
+    test29( "263", "{\"c\":0,\"a\":{\"b\":[{\"c\":1}]}}", "c", 1, "number is 0" );
+    test29( "264", "{\"a\":{\"b\":[[[[[]]]]],\"c\":2}}", "c", 0, "number is 2" );
+    test29( "265", "{\"a\":[1, 2,]  ,\"c\":{\"d\":[]}}", "c", 0, "obj is {\"d\":[]}" );
+    test29( "266", "{\"a\":[1 2],\"c\":3}", "c", 0, "parse error" );
+    test29( "267", "[[{\"x\":1}],{\"x\":2}]", "x", 0, "number is 1" );
+    test29( "268", "[[{\"y\":1}],{\"x\":{\"z\":[1,{}]}}] trailing", "x", 0, "obj is {\"z\":[1,{}]}" );
+    test29( "269", "[[{\"y\":1}],{\"x\":{\"z\":[1,{]}}]", "x", 0, "parse error" );
+
+    size_t deepLength = 3000;
+    char   *deepInput = malloc( deepLength * 6 + 16 );
+    size_t deepUsed   = 0;
+    for ( size_t i = 0; i < deepLength; i++ ) deepUsed += (size_t) sprintf( deepInput + deepUsed, "{\"a\":" );
+    deepUsed += (size_t) sprintf( deepInput + deepUsed, "1" );
+    for ( size_t i = 0; i < deepLength; i++ ) deepInput[deepUsed++] = '}';
+    deepInput[deepUsed] = '\0';
+    test29( "270", deepInput, "b", 0, "parse error" );
+    test29( "271", deepInput, "b", 5000, "not found..." );
+    free( deepInput );
+    test30( "272", 200000 );
+
+    test31( "273", " { \"a\" : [ 1 , -2.5e3 , \"x\\\"]\" ] , \"b\" : { } , \"c\" : [ ] , \"d\" : null } ",
+            "{\"a\":[1,-2.5e3,\"x\\\"]\"],\"b\":{},\"c\":[],\"d\":null}" );
+    test31( "274", "[[[true]],{\"k\":{\"k\":false}}]", "[[[true]],{\"k\":{\"k\":false}}]" );
+    test31( "275", "42", "42" );
+    test31( "276", "{\"a\":1 \"b\":2}", "parse error" );
+    test31( "277", "[1,2", "parse error" );
+    test31( "278", "{\"a\":tru}", "parse error" );
+
+    {
+        // 只读取需要的字段，其余的value和没有读完的下层直接跳过
+        char        *records = "[{\"id\":1,\"tags\":[\"x\",{\"deep\":[1,2]}],\"name\":\"a\"},"
+                               "{\"skip\":{\"o\":\"}]\"},\"id\":2},{\"id\":3,\"more\":[[[]]]}]";
+        JsonCursor  cursor;
+        CursorScope array, record, tags;
+        StringView  key;
+        ValueSpan   span;
+        int64_t     id, sum = 0;
+        initCursor( &cursor, (UBYTE *) records, strlen( records ));
+        enterCursor( &cursor, &array );
+        while ( nextCursorElement( &cursor, &array )) {
+            enterCursor( &cursor, &record );
+            while ( nextCursorField( &cursor, &record, &key )) {
+                if ( key.length == 2 && memcmp( key.data, "id", 2 ) == 0 ) {
+                    readCursorValue( &cursor, &span );
+                    getInt64BySpan((UBYTE *) records, &span, &id );
+                    sum += id;
+                } else if ( key.length == 4 && memcmp( key.data, "tags", 4 ) == 0 ) {
+                    // 进入后只读第一个元素就离开
+                    enterCursor( &cursor, &tags );
+                    nextCursorElement( &cursor, &tags );
+                    if ( peekCursorType( &cursor ) != J_STRING ) sum += 100;
+                    break;
+                }
+            }
+        }
+        if ( !cursor.failed && sum == 6 && cursor.depth == 0 ) printf( "279, test passed!\n" );
+        else printTestFailure( "279, test failed, sum: %lld, failed: %d\n", (long long) sum, cursor.failed );
+
+        initCursor( &cursor, (UBYTE *) records, strlen( records ));
+        if ( !nextCursorField( &cursor, &array, &key ) && cursor.failed ) printf( "280, test passed!\n" );
+        else printTestFailure( "280, test failed, moved in a closed scope\n" );
+
+        initCursor( &cursor, (UBYTE *) "\"s\"", 3 );
+        if ( !enterCursor( &cursor, &array ) && peekCursorType( &cursor ) == J_STRING && skipCursorValue( &cursor )
+             && peekCursorType( &cursor ) == J_NOT_FOUND )
+            printf( "281, test passed!\n" );
+        else printTestFailure( "281, test failed, entered a string\n" );
+    }
+
+    {
+        JsonWriter writer;
+        initWriter( &writer, NULL, 4 );
+        writeObjectStart( &writer );
+        writeKey( &writer, (UBYTE *) "id", 2 );
+        writeInt64( &writer, -9223372036854775807LL - 1 );
+        writeKey( &writer, (UBYTE *) "list", 4 );
+        writeArrayStart( &writer );
+        writeDouble( &writer, 12.34 );
+        writeDouble( &writer, 0.05 );
+        writeDouble( &writer, -0.0 );
+        writeDouble( &writer, 1e300 );
+        writeDouble( &writer, 0.1 + 0.2 );
+        writeDouble( &writer, NAN );
+        writeArrayStart( &writer );
+        writeArrayEnd( &writer );
+        writeObjectStart( &writer );
+        writeObjectEnd( &writer );
+        writeBool( &writer, true );
+        writeArrayEnd( &writer );
+        writeKey( &writer, (UBYTE *) "s", 1 );
+        writeString( &writer, (UBYTE *) "q\"b\\n\n\x01\xe4\xb8\xad", 10 );
+        writeObjectEnd( &writer );
+        test32( "282", &writer, "{\"id\":-9223372036854775808,\"list\":[12.34,0.05,-0,1e+300,0.30000000000000004,null,"
+                                "[],{},true],\"s\":\"q\\\"b\\\\n\\n\\u0001\xe4\xb8\xad\"}" );
+
+        char      *source = "{\"user\":{\"name\":\"T\\u00e9\",\"tags\":[1, 2]},\"id\":7}";
+        Search    search  = { .pattern = (UBYTE *) "user", .valueType = J_NOT_FOUND, .options = S_NORMAL };
+        ValueSpan span;
+        macroKeyValueSearchSpan((UBYTE *) source, strlen( source ), &search, &span );
+        initWriter( &writer, NULL, 0 );
+        writeArrayStart( &writer );
+        writeSpan( &writer, (UBYTE *) source, &span );
+        writeInt64( &writer, 0 );
+        writeArrayEnd( &writer );
+        test32( "283", &writer, "[{\"name\":\"T\\u00e9\",\"tags\":[1, 2]},0]" );
+
+        char buffer[8];
+        initWriter( &writer, buffer, sizeof( buffer ));
+        writeArrayStart( &writer );
+        writeString( &writer, (UBYTE *) "too long", 8 );
+        writeArrayEnd( &writer );
+        test32( "284", &writer, "failed" );
+
+        // 超过一个SIMD block的字符串，转义符在block的边界附近
+        char longText[100], expected[256];
+        memset( longText, 'a', sizeof( longText ));
+        longText[31] = '"';
+        longText[32] = '\n';
+        longText[95] = '\\';
+        sprintf( expected, "\"%.31s\\\"\\n%.62s\\\\%.4s\"", longText, longText + 33, longText + 96 );
+        initWriter( &writer, NULL, 0 );
+        writeString( &writer, (UBYTE *) longText, sizeof( longText ));
+        test32( "285", &writer, expected );
+    }
+    test33( "286" );
+
+    char *patchSource = "{\"user\":{\"name\":\"Tom\", \"tags\":[1, 2, 3]},\"id\":7}";
+    test34( "287", patchSource, ".user.name", PATCH_SET, "\"Ann\"",
+            "{\"user\":{\"name\":\"Ann\", \"tags\":[1, 2, 3]},\"id\":7}" );
+    test34( "288", patchSource, ".user.tags[1]", PATCH_SET, "{\"x\":null}",
+            "{\"user\":{\"name\":\"Tom\", \"tags\":[1, {\"x\":null}, 3]},\"id\":7}" );
+    test34( "289", patchSource, ".user.name", PATCH_DELETE, NULL, "{\"user\":{\"tags\":[1, 2, 3]},\"id\":7}" );
+    test34( "290", patchSource, ".id", PATCH_DELETE, NULL, "{\"user\":{\"name\":\"Tom\", \"tags\":[1, 2, 3]}}" );
+    test34( "291", patchSource, ".user.tags[0]", PATCH_DELETE, NULL,
+            "{\"user\":{\"name\":\"Tom\", \"tags\":[2, 3]},\"id\":7}" );
+    test34( "292", patchSource, ".user.tags[2]", PATCH_DELETE, NULL,
+            "{\"user\":{\"name\":\"Tom\", \"tags\":[1, 2]},\"id\":7}" );
+    test34( "293", "{\"a\":[ 5 ]}", ".a[0]", PATCH_DELETE, NULL, "{\"a\":[  ]}" );
+    test34( "294", patchSource, ".user.email", PATCH_INSERT_KEY, "\"t@x.com\"",
+            "{\"user\":{\"name\":\"Tom\", \"tags\":[1, 2, 3],\"email\":\"t@x.com\"},\"id\":7}" );
+    test34( "295", "{\"a\":{}}", ".a.b", PATCH_INSERT_KEY, "1", "{\"a\":{\"b\":1}}" );
+    test34( "296", patchSource, ".user.name", PATCH_INSERT_KEY, "1", "failed 10" );
+    test34( "297", patchSource, ".user.age", PATCH_SET, "1", "failed 0" );
+    test34( "298", patchSource, ".user.tags[3]", PATCH_DELETE, NULL, "failed 0" );
+    test34( "299", patchSource, ".user.tags[0]", PATCH_INSERT_KEY, "1", "failed -1001" );
+    test34( "300", patchSource, "user", PATCH_SET, "1", "failed -1001" );
+    test34( "301", "{\"a\":{\"b\":1,}", ".a.c", PATCH_SET, "1", "failed -1000" );
+    test34( "302", "[{\"k\":1},{\"k\":2}]", "[1].k", PATCH_SET, "true", "[{\"k\":1},{\"k\":true}]" );
+
+    test( "303", "{\"a\":{\"b\":1],\"x\":2}", "x", "parse error", false );
+    test( "304", "{\"a\":[1}, \"x\":2}", "x", "parse error", false );
+    test( "305", "{\"a\":[[{\"b\":[]}],{}], \"x\":2}", "x", "number is 2", false );
+    test2( "306", "[{\"a\":1],2]", 1, "parse error" );
+    test35( "307", 5000, false, "number is 2" );
+    test35( "308", 5000, true, "parse error" );
+
+    JsonCursor  mismatchedCursor;
+    CursorScope mismatchedScope;
+    initCursor( &mismatchedCursor, (UBYTE *) "[[1,{\"a\":[2}],3]", 17 );
+    bool mismatchedOk = enterCursor( &mismatchedCursor, &mismatchedScope )
+                        && nextCursorElement( &mismatchedCursor, &mismatchedScope )
+                        && nextCursorElement( &mismatchedCursor, &mismatchedScope );
+    printTestResult( "309", NULL, "value is false", mismatchedOk ? J_TRUE : J_FALSE );
+
+    char *hopSource = "{\"a\":{\"b\":[1,{\"c\":[2,3]},4],\"d\":5}}";
+    test3( "310", hopSource, ".a.b", "array is [1,{\"c\":[2,3]},4]" );
+    test3( "311", hopSource, ".a.b[1]", "obj is {\"c\":[2,3]}" );
+    test3( "312", hopSource, ".a.b[1].c", "array is [2,3]" );
+    test3( "313", hopSource, ".a.b[1].d", "not found..." );
+    test6( "314", hopSource, 26, ".a.b[1].c", "array is [2,3]" );
+    test6( "315", hopSource, 22, ".a.b[1].c", "parse error" );
+
+    streamParser = createStreamKeyParser((UBYTE *) "c", S_RECURSIVE, 8, 64 );
+    test14( "316", streamParser, "{\"c\":{\"c\":1}}", "{\"c\":1}" );
+    test( "317", "{\"c\":{\"c\":1}}", "c", "obj is {\"c\":1}", true );
+    test14( "318", streamParser, "[{\"c\":[{\"c\":{\"c\":2}}]},{\"c\":3}]", "[{\"c\":{\"c\":2}}]" );
+    freeStreamParser( streamParser );
+
+    test36( "319", "[1,2", 4, 1 );
+    test36( "320", "[1,2,{\"a\":3", 11, 1 );
+    test36( "321", "[1 2]", 5, 1 );
+    test36( "322", "[1,2] x", 7, 1 );
+    test36( "323", "[1,2]]", 6, 1 );
+    test36( "324", "[1}", 3, 1 );
+    test36( "325", "[ \"a\" \"b\" ]", 11, 1 );
+    test36( "326", "[{\"a\":1}{\"b\":2}]", 15, 1 );
+    test36( "327", "[1,\"a", 6, 1 );
+    elements = parallelArraySearch( NULL, (UBYTE *) " [ [2] , \"x\"\t] \n", 16, 0, &elementCount );
+    if ( elements != NULL && elementCount == 2 ) printf( "328, test passed!\n" );
+    else printTestFailure( "328, test failed, expected elements: [2]\n" );
+    free( elements );
+
+    size_t truncatedLength = 0;
+    char   *truncated      = malloc( 1 << 20 );
+    truncated[truncatedLength++] = '[';
+    for ( size_t i = 0; truncatedLength < ( 1 << 20 ) - 64; i++ ) {
+        truncatedLength += (size_t) sprintf( truncated + truncatedLength, "%s{\"id\":%zu}", i == 0 ? "" : ",", i );
+    }
+    test36( "329", truncated, truncatedLength, 4 );
+    truncated[truncatedLength] = ']';
+    memcpy( truncated + truncatedLength + 1, " {}", 3 );
+    test36( "330", truncated, truncatedLength + 4, 4 );
+    // 把中间的一个元素换成两个value
+    char *middle = strchr( truncated + truncatedLength / 2, ',' ) + 1;
+    memset( middle, ' ', (size_t) ( strchr( middle, ',' ) - middle ));
+    memcpy( middle, "1 2", 3 );
+    test36( "331", truncated, truncatedLength + 1, 4 );
+    free( truncated );
+
+    if ( buildArrayIndex((UBYTE *) "[1,2]garbage", 12 ) == NULL && buildArrayIndex((UBYTE *) "[]x", 3 ) == NULL)
+        printf( "332, test passed!\n" );
+    else printTestFailure( "332, test failed, built an index for an array followed by garbage\n" );
+    test2( "333", "[1,2]garbage", 5, "parse error" );
+    ArrayIndex *paddedIndex = buildArrayIndex((UBYTE *) " [1,2] \n", 8 );
+    if ( paddedIndex != NULL && arrayIndexCount( paddedIndex ) == 2 ) printf( "334, test passed!\n" );
+    else printTestFailure( "334, test failed, expected elements: [2]\n" );
+    freeArrayIndex( paddedIndex );
+
+    char *selfNested = "{\"k\":{\"k\":{\"k\":1}},\"j\":[{\"k\":[]}]}";
+    test21( "335", selfNested, "k", 0, 0, 100, true, 4,
+            ".k={\"k\":{\"k\":1}};.k.k={\"k\":1};.k.k.k=1;.j[0].k=[];" );
+    test21( "336", selfNested, "k", 2, 0, 100, true, 2, ".k={\"k\":{\"k\":1}};.k.k={\"k\":1};" );
+    test21( "337", selfNested, "k", 0, 0, 1, true, 1, ".k={\"k\":{\"k\":1}};" );
+    test21( "338", "{\"a\":1,\"k\":{\"k\":1,}}", "k", 0, 0, 100, false, 0, "" );
+    test37( "339", 1000000, SIZE_MAX, 1 );
+    test37( "340", 1000000, 0, 0 );
+    test37( "341", 1023, 0, 1 );
+
+    // 无法反转义的string报告parse error，而不是J_STRING加上NULL
+    test( "342", "{\"s\":\"\\ud800\"}", "s", "parse error", false );
+    test( "343", "{\"s\":\"a\\qb\"}", "s", "parse error", true );
+    test3( "344", "{\"a\":[\"\\ud800x\"]}", ".a[0]", "parse error" );
+    test2( "345", "[1,\"\\q\"]", 1, "parse error" );
+    Query *escapeQuery = createKeyQuery((UBYTE *) "s", S_NORMAL, Q_NONE );
+    test27( "346", escapeQuery, "{\"s\":\"\\ud800\"}", "parse error" );
+    freeQuery( escapeQuery );
+
+    // 插入的key原样写入，需要转义却没有转义时拒绝
+    test34( "347", "[{\"a\":1}]", "[0].a\"b", PATCH_INSERT_KEY, "1", "failed -1001" );
+    test34( "348", "[{\"a\":1}]", "[0].a\\qb", PATCH_INSERT_KEY, "1", "failed -1001" );
+    test34( "349", "[{\"a\":1}]", "[0].a\\\"b", PATCH_INSERT_KEY, "1", "[{\"a\":1,\"a\\\"b\":1}]" );
+    test34( "350", "{}", ".caf\\u00e9", PATCH_INSERT_KEY, "2", "{\"caf\\u00e9\":2}" );
+
+    // 下标超出数组的长度时找不到，数组之后还有其他内容时是parse error
+    test2( "351", " [1,2] \n", 2, "not found..." );
+    test2( "352", "[]", 0, "not found..." );
+    test2( "353", "[1,2] 3", 2, "parse error" );
+    test3( "354", "{\"a\":[1,2],\"b\":3}", ".a[2]", "not found..." );
+    test3( "355", "{\"a\":[[1],{\"c\":1}]}", ".a[2].c", "not found..." );
+    test3( "356", "[[1,2],[3]]", "[1][1]", "not found..." );
+    test3( "357", "{\"a\":[1,2}", ".a[5]", "parse error" );
+    test38( "358", 2000000 );
+    test38( "359", 64 );
+
+    // 长度为0的数字不能转换成功
+    ValueSpan emptyFloat = { 0, 0, J_FLOAT }, emptyInt = { 0, 0, J_INT };
+    double    emptyNumber;
+    int64_t   emptyInteger;
+    if ( !getDoubleBySpan((UBYTE *) "1", &emptyFloat, &emptyNumber ) &&
+         !getInt64BySpan((UBYTE *) "1", &emptyInt, &emptyInteger ) &&
+         getValueBySpan((UBYTE *) "1", &emptyFloat ) == NULL)
+        printf( "360, test passed!\n" );
+    else printTestFailure( "360, test failed, converted a zero-length number\n" );
+
+    // 对象索引支持unescapeKey、strict和maxDepth
+    char *escapedKeys = "{\"a\":{\"caf\\u00e9\":3},\"caf\\u00e9\":1,\"caf\xc3\xa9\":2,\"a\\\\b\":4}";
+    test39( "361", escapedKeys, (Search) { .pattern = (UBYTE *) "caf\xc3\xa9", .valueType = J_NOT_FOUND,
+                                           .options = S_NORMAL, .unescapeKey = true }, "number is 1" );
+    test39( "362", escapedKeys, (Search) { .pattern = (UBYTE *) "caf\xc3\xa9", .valueType = J_NOT_FOUND,
+                                           .options = S_NORMAL }, "number is 2" );
+    test39( "363", escapedKeys, (Search) { .pattern = (UBYTE *) "caf\xc3\xa9", .valueType = J_NOT_FOUND,
+                                           .options = S_RECURSIVE, .unescapeKey = true }, "number is 3" );
+    test39( "364", escapedKeys, (Search) { .pattern = (UBYTE *) "a\\\\b", .valueType = J_NOT_FOUND,
+                                           .options = S_NORMAL, .unescapeKey = true }, "not found..." );
+    test39( "365", escapedKeys, (Search) { .pattern = (UBYTE *) "a\\b", .valueType = J_NOT_FOUND,
+                                           .options = S_RECURSIVE, .unescapeKey = true }, "number is 4" );
+    test39( "366", "{\"a\":1,\"b\":1.}", (Search) { .pattern = (UBYTE *) "a", .valueType = J_NOT_FOUND,
+                                                      .options = S_NORMAL, .strict = true }, "parse error" );
+    test39( "367", "{\"a\":1,\"b\":1.}", (Search) { .pattern = (UBYTE *) "a", .valueType = J_NOT_FOUND,
+                                                      .options = S_NORMAL }, "number is 1" );
+    test39( "368", "{\"a\":[[[1]]],\"k\":2}", (Search) { .pattern = (UBYTE *) "k", .valueType = J_NOT_FOUND,
+                                                           .options = S_RECURSIVE, .maxDepth = 2 }, "parse error" );
+    test39( "369", "{\"a\":[[[1]]],\"k\":2}", (Search) { .pattern = (UBYTE *) "k", .valueType = J_NOT_FOUND,
+                                                           .options = S_RECURSIVE, .maxDepth = 4 }, "number is 2" );
+    test39( "370", "{\"k\":[[[1]]],\"a\":[[2]]}", (Search) { .pattern = (UBYTE *) "k", .valueType = J_NOT_FOUND,
+                                                               .options = S_RECURSIVE, .maxDepth = 3 },
+            "parse error" );
+    test39( "371", "{\"k\":[[[1]]],\"a\":[[[[2]]]]}", (Search) { .pattern = (UBYTE *) "k", .valueType = J_NOT_FOUND,
+                                                                   .options = S_RECURSIVE, .maxDepth = 4 },
+            "array is [[[1]]]" );
+    test39( "372", "{\"a\":[[1]]}", (Search) { .pattern = (UBYTE *) "z", .valueType = J_NOT_FOUND,
+                                               .options = S_RECURSIVE, .maxDepth = 2 }, "parse error" );
+    test39( "373", "{\"a\":[[1]]}", (Search) { .pattern = (UBYTE *) "z", .valueType = J_NOT_FOUND,
+                                               .options = S_RECURSIVE, .maxDepth = 3 }, "not found..." );
+
+    return failedCount;
+}